@@ -25,6 +25,49 @@ def dither_565(im):
 	return Image.merge('RGB', bands)
 
 
+def hash_565(pixel):
+	return ((pixel >> 11) * 3 + ((pixel >> 5) & 0x3f) * 5 + (pixel & 0x1f) * 7) % 64
+
+
+def encode_q565(width, height, pixels):
+	"""
+	Compresses RGB565 pixels to format decoded by lib/st7789_image.c
+	"""
+	out = bytearray(b'q565')
+	out += struct.pack('<HH', width, height)
+	index = [0] * 64
+	previous = 0
+	run = 0
+	for position, pixel in enumerate(pixels):
+		if pixel == previous:
+			run += 1
+			if run == 62 or position == len(pixels) - 1:
+				out.append(0xc0 | (run - 1))
+				run = 0
+			continue
+		if run:
+			out.append(0xc0 | (run - 1))
+			run = 0
+		pixel_hash = hash_565(pixel)
+		if index[pixel_hash] == pixel:
+			out.append(pixel_hash)
+		else:
+			index[pixel_hash] = pixel
+			dr = (((pixel >> 11) - (previous >> 11) + 16) & 0x1f) - 16
+			dg = ((((pixel >> 5) & 0x3f) - ((previous >> 5) & 0x3f) + 32) & 0x3f) - 32
+			db = (((pixel & 0x1f) - (previous & 0x1f) + 16) & 0x1f) - 16
+			if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+				out.append(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2))
+			elif -8 <= dr - dg <= 7 and -8 <= db - dg <= 7:
+				out.append(0x80 | (dg + 32))
+				out.append(((dr - dg + 8) << 4) | (db - dg + 8))
+			else:
+				out.append(0xfe)
+				out += struct.pack('<H', pixel)
+		previous = pixel
+	return bytes(out)
+
+
 def main():
 	with open(sys.argv[1], 'rb') as image_fp:
 		im = Image.open(image_fp)
@@ -32,16 +75,12 @@ def main():
 
 	im.thumbnail(OUTPUT_SIZE, Image.ANTIALIAS)
 
-	with open(sys.argv[1] + '.dat', 'wb') as image_fp:
-		packed_pixel = struct.Struct("<H")
-		pixels = list(im.getdata())
-		for pixel in pixels:
-			r, g, b = pixel
-			r = r >> 3
-			g = g >> 2
-			b = b >> 3
-			pixel = (r << 11) + (g << 5) + (b)
-			image_fp.write(packed_pixel.pack(pixel))
+	pixels = []
+	for r, g, b in im.getdata():
+		pixels.append(((r >> 3) << 11) + ((g >> 2) << 5) + (b >> 3))
+
+	with open(sys.argv[1] + '.q565', 'wb') as image_fp:
+		image_fp.write(encode_q565(im.size[0], im.size[1], pixels))
 
 
 
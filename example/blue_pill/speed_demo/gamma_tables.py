@@ -0,0 +1,199 @@
+# -*- coding: utf-8 -*-
+"""
+Turns measured panel response into st7789_Gamma tables (lib/st7789_gamma.h)
+
+usage: gamma_tables.py [--gamma G] [--curve G] [--white R,G,B] [--analog FILE] [--name NAME] measurements.csv
+       gamma_tables.py --synthetic R,G,B
+
+Measurements are CSV lines "level,red,green,blue": luminance of full screen
+patch of single channel at 8 bit input level, levels 0 and 255 are required.
+They are taken with analog curve --curve (GAMSET) and digital gamma off.
+"""
+import argparse
+import csv
+import math
+import sys
+
+
+LUT_SIZE = 64
+CURVE_SIZE = 14
+
+# GAMSET parameter of predefined curves
+CURVES = {
+	2.2: 'ST7789_GAMMA_CURVE_2_2',
+	1.8: 'ST7789_GAMMA_CURVE_1_8',
+	2.5: 'ST7789_GAMMA_CURVE_2_5',
+	1.0: 'ST7789_GAMMA_CURVE_1_0',
+}
+
+# PVGAMCTRL / NVGAMCTRL of st7789_Gamma_1_3_LCD
+POSITIVE = [0xd0, 0x08, 0x11, 0x08, 0x0c, 0x15, 0x39, 0x33, 0x50, 0x36, 0x13, 0x14, 0x29, 0x2d]
+NEGATIVE = [0xd0, 0x08, 0x10, 0x08, 0x06, 0x06, 0x39, 0x44, 0x51, 0x0b, 0x16, 0x14, 0x2f, 0x31]
+
+
+class Response(object):
+	"""
+	Normalized monotonic response of one channel, input and output 0..1
+	"""
+	def __init__(self, points):
+		points = sorted(points)
+		if points[0][0] != 0 or points[-1][0] != 255:
+			raise ValueError("Levels 0 and 255 have to be measured")
+		black = points[0][1]
+		white = points[-1][1]
+		if white <= black:
+			raise ValueError("Channel does not get brighter")
+		self.points = []
+		peak = 0.0
+		for level, value in points:
+			peak = max(peak, (value - black) / (white - black))
+			self.points.append((level / 255.0, min(peak, 1.0)))
+		self.luminance = white - black
+
+	def __call__(self, x):
+		for (x0, y0), (x1, y1) in zip(self.points, self.points[1:]):
+			if x <= x1:
+				if x1 == x0:
+					return y1
+				return y0 + (y1 - y0) * (x - x0) / (x1 - x0)
+		return self.points[-1][1]
+
+	def exponent(self):
+		"""
+		Least squares fit of log(y) = gamma * log(x) over mid tones
+		"""
+		samples = [(math.log(x), math.log(y)) for x, y in self.points if 0.1 <= x <= 0.9 and y > 0]
+		if not samples:
+			raise ValueError("No mid tone measurements")
+		return sum(lx * ly for lx, ly in samples) / sum(lx * lx for lx, _ in samples)
+
+
+def read_measurements(path):
+	channels = ([], [], [])
+	with open(path) as measurements_fp:
+		for row in csv.reader(measurements_fp):
+			if not row or row[0].strip().startswith('#') or not row[0].strip().isdigit():
+				continue
+			level = int(row[0])
+			for channel in range(3):
+				channels[channel].append((level, float(row[channel + 1])))
+	return [Response(points) for points in channels]
+
+
+def choose_curve(green_exponent, measured_curve, target):
+	"""
+	Predefined curve which moves green closest to target, exponent of panel
+	is assumed to scale with nominal exponent of curve
+	"""
+	return min(CURVES, key=lambda curve: abs(green_exponent * curve / measured_curve - target))
+
+
+def build_lut(response, reference, gain, scale):
+	"""
+	Output level for each 6 bit input level which makes channel follow green
+	(reference) under new curve, gain below 1 dims channel for white balance
+	"""
+	lut = []
+	previous = 0
+	for level in range(LUT_SIZE):
+		x = level / float(LUT_SIZE - 1)
+		target = reference(x ** scale) * gain
+		best = min(range(LUT_SIZE), key=lambda out: abs(response((out / float(LUT_SIZE - 1)) ** scale) - target))
+		previous = max(previous, best)
+		lut.append(previous)
+	return lut
+
+
+def read_analog(path):
+	"""
+	Two lines of 14 hex bytes (PVGAMCTRL, NVGAMCTRL)
+	"""
+	with open(path) as analog_fp:
+		lines = [line.split() for line in analog_fp if line.strip() and not line.startswith('#')]
+	curves = [[int(value, 16) for value in line] for line in lines[:2]]
+	if len(curves) != 2 or any(len(curve) != CURVE_SIZE for curve in curves):
+		raise ValueError("Analog file needs 2 lines of %d bytes" % CURVE_SIZE)
+	return curves
+
+
+def format_bytes(values, per_line, hexadecimal):
+	items = [('0x%02x' % value) if hexadecimal else ('%2d' % value) for value in values]
+	if len(items) <= per_line:
+		return '{' + ', '.join(items) + '}'
+	lines = [', '.join(items[i:i + per_line]) for i in range(0, len(items), per_line)]
+	return '{\n\t\t' + ',\n\t\t'.join(lines) + ',\n\t}'
+
+
+def format_gamma(name, source, exponents, curve, positive, negative, red, blue):
+	lines = [
+		'// Generated by gamma_tables.py from %s, measured exponents R %.2f G %.2f B %.2f' % ((source,) + tuple(exponents)),
+		'static const st7789_Gamma %s = {' % name,
+		'\t%s,' % CURVES[curve],
+		'\t%s,' % format_bytes(positive, CURVE_SIZE, True),
+		'\t%s,' % format_bytes(negative, CURVE_SIZE, True),
+		'\ttrue,',
+		'\t%s,' % format_bytes(red, 16, False),
+		'\t%s,' % format_bytes(blue, 16, False),
+		'};',
+	]
+	return '\n'.join(lines) + '\n'
+
+
+def synthetic(exponents):
+	"""
+	Measurement of ideal panel with given channel exponents
+	"""
+	out = ['# level,red,green,blue']
+	for level in list(range(0, 256, 16)) + [255]:
+		x = level / 255.0
+		out.append('%d,%s' % (level, ','.join('%.5f' % (0.2 + 100.0 * x ** exponent) for exponent in exponents)))
+	return '\n'.join(out) + '\n'
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Panel colour calibration tables")
+	parser.add_argument('--gamma', type=float, default=2.2, help="target exponent")
+	parser.add_argument('--curve', type=float, default=2.2, choices=sorted(CURVES), help="GAMSET curve of measurement")
+	parser.add_argument('--white', help="luminance ratio R,G,B of white point, default keeps measured one")
+	parser.add_argument('--analog', help="PVGAMCTRL / NVGAMCTRL bytes, default st7789_Gamma_1_3_LCD")
+	parser.add_argument('--name', default='panelGamma')
+	parser.add_argument('--synthetic', help="print measurement of ideal panel with R,G,B exponents")
+	parser.add_argument('measurements', nargs='?')
+	args = parser.parse_args()
+
+	if args.synthetic:
+		sys.stdout.write(synthetic([float(value) for value in args.synthetic.split(',')]))
+		return
+	if not args.measurements:
+		parser.error("measurements are required")
+
+	red, green, blue = read_measurements(args.measurements)
+	exponents = [red.exponent(), green.exponent(), blue.exponent()]
+	curve = choose_curve(exponents[1], args.curve, args.gamma)
+	scale = curve / args.curve
+
+	# Green has no digital table, red and blue can only be dimmed to it
+	gains = [1.0, 1.0]
+	white = [float(value) for value in args.white.split(',')] if args.white else None
+	for index, (response, weight) in enumerate(((red, white[0]), (blue, white[2])) if white else ()):
+		gain = (green.luminance * weight / white[1]) / response.luminance
+		if gain > 1.0:
+			sys.stderr.write("Channel can't reach white point, gain %.2f limited to 1\n" % gain)
+			gain = 1.0
+		gains[index] = gain
+
+	positive, negative = read_analog(args.analog) if args.analog else (POSITIVE, NEGATIVE)
+	sys.stdout.write(format_gamma(
+		args.name,
+		args.measurements,
+		exponents,
+		curve,
+		positive,
+		negative,
+		build_lut(red, green, gains[0], scale),
+		build_lut(blue, green, gains[1], scale)
+	))
+
+
+if __name__ == "__main__":
+	main()
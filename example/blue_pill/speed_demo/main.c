@@ -2,23 +2,83 @@
 #include <stdbool.h>
 #include <svc.h>
 #include <stdlib.h>
+#include <string.h>
 #include <st7789.h>
+#include <st7789_queue.h>
+#include <st7789_display_list.h>
+#include <st7789_vsync.h>
+#include <st7789_image.h>
+#include <st7789_pixels.h>
+#include <st7789_render.h>
+#include <st7789_stats.h>
+#include <st7789_bridge.h>
+#include <st7789_readback.h>
+#include <st7789_gamma.h>
 
+#include "mandelbrot.h"
 
-typedef int64_t float_t;
-#define FLOAT_BITS 20
-#define FLOAT_FACT ((float_t)1 << FLOAT_BITS)
-#define MANDELBROT_MAXITER 1024
 
-typedef int float_fast_t;
-#define FLOAT_FAST_BITS 13
-#define FLOAT_FAST_FACT ((float_t)1 << FLOAT_FAST_BITS)
+#define MANDELBROT_MAXITER 1024
 #define MANDELBROT_MAXITER_FAST 64
+#define MANDELBROT_TILE_WIDTH 24
+#define MANDELBROT_TILE_HEIGHT 20
+#define MANDELBROT_TILE_DEPTH (RENDER_BUFFER_SIZE / (MANDELBROT_TILE_WIDTH * MANDELBROT_TILE_HEIGHT))
 
 
-#define PIXEL_BUFFER_LINES 20
+#define PIXEL_BUFFER_LINES 8
 #define PIXEL_BUFFER_SIZE (ST7789_LCD_WIDTH * PIXEL_BUFFER_LINES)
 
+#define PIXEL_FORMAT_FRAMES 32
+
+#define RENDER_BAND_LINES 1
+#define RENDER_DEPTH 4
+#define RENDER_BUFFER_SIZE (ST7789_LCD_WIDTH * RENDER_BAND_LINES * RENDER_DEPTH)
+
+#define DISPLAY_LIST_BAND_HEIGHT 2
+#define DISPLAY_LIST_ITEMS 32
+#define DISPLAY_LIST_BARS 8
+
+#if 2 * ST7789_LCD_WIDTH * DISPLAY_LIST_BAND_HEIGHT > RENDER_BUFFER_SIZE
+#error "Display list bands do not fit to render buffers"
+#endif
+
+#define REMOTE_LINES 1
+#define REMOTE_SLOTS 3
+#define REMOTE_SLOT_SIZE ST7789_BRIDGE_SLOT_SIZE(ST7789_LCD_WIDTH * REMOTE_LINES)
+#define REMOTE_IDLE_MS 1000
+
+#if REMOTE_SLOTS * REMOTE_SLOT_SIZE > ST7789_BRIDGE_MAX_RING
+#error "Remote display ring does not fit to RX DMA transfer"
+#endif
+#if REMOTE_SLOTS * REMOTE_SLOT_SIZE > RENDER_BUFFER_SIZE * 2
+#error "Remote display ring does not fit to render buffers"
+#endif
+
+#define VECTOR_COUNT (16 + 43)
+
+
+typedef void (*vector_t)(void);
+static vector_t vectors[VECTOR_COUNT] __attribute__((aligned(256)));
+
+// Panel on SPI1, D/CX on PA8, RST on PA9, TE on PA0
+static const st7789_Config displayConfig = {ST7789_SPI1_DMA, GPIOA, GPIO_ODR_ODR8, GPIOA, GPIO_ODR_ODR9, ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0};
+static st7789_Device display;
+static st7789_Queue displayQueue;
+static st7789_Vsync displayVsync;
+#ifdef ST7789_STATS
+static st7789_Stats displayStats;
+#endif
+
+// Band ring of st7789_RenderWindow shared by demos, also slots of remote
+// display ring
+static uint16_t renderBuffers[RENDER_BUFFER_SIZE];
+
+// Zoom state kept between frames of demoMandelbrot
+static mandelbrotEngine mandelbrotState;
+
+// Remote display on USART2 (TX PA2, RX PA3), RX DMA1 channel 6
+static st7789_Bridge remoteBridge;
+
 
 void setupPrescaler(int pllmul) {
 	// enable high speed external oscillator
@@ -59,6 +119,25 @@ void setupTimer(void) {
 }
 
 
+void displayDMAInterrupt(void) {
+	st7789_DMAInterruptHandler(&display);
+}
+
+
+void displayTEInterrupt(void) {
+	st7789_TEInterruptHandler(&display);
+}
+
+
+void setupInterrupts(void) {
+	// Program runs from RAM, vector table is relocated to RAM too
+	vectors[16 + DMA1_Channel3_IRQn] = displayDMAInterrupt;
+	vectors[16 + EXTI0_IRQn] = displayTEInterrupt;
+	SCB->VTOR = (uint32_t)&vectors;
+	__enable_irq();
+}
+
+
 void svcLogTime() {
 	static char buf[12];
 	itoa(TIM1->CNT / 10, buf, 10);
@@ -99,24 +178,24 @@ void st7789_GPIOInit(void) {
 	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
 
 	// Enable SPI
-	ST7789_SPI->SR = 0;
+	SPI1->SR = 0;
 	// Reverse polarity?
-	ST7789_SPI->CR1 = \
+	SPI1->CR1 = \
 		SPI_CR1_SSM | \
 		SPI_CR1_SSI | \
 		SPI_CR1_MSTR | \
 		SPI_CR1_CPOL | \
 		SPI_CR1_BIDIMODE | \
 		SPI_CR1_BIDIOE;
-	ST7789_SPI->CR1 |= SPI_CR1_SPE;
+	SPI1->CR1 |= SPI_CR1_SPE;
 	
 	// DC and RST signals
 	// Maximum output speed
-	ST7789_DC_PORT->CRH |= GPIO_CRH_MODE8;
-	ST7789_RST_PORT->CRH |= GPIO_CRH_MODE9;
+	GPIOA->CRH |= GPIO_CRH_MODE8;
+	GPIOA->CRH |= GPIO_CRH_MODE9;
 	// Output push pull
-	ST7789_DC_PORT->CRH &= ~(GPIO_CRH_CNF8);
-	ST7789_RST_PORT->CRH &= ~(GPIO_CRH_CNF9);
+	GPIOA->CRH &= ~(GPIO_CRH_CNF8);
+	GPIOA->CRH &= ~(GPIO_CRH_CNF9);
 
 	// SPI pins
 	// Maximum output speed on PA5/PA7
@@ -125,72 +204,106 @@ void st7789_GPIOInit(void) {
 	// Alternate mode on PA5/PA7
 	GPIOA->CRL = (GPIOA->CRL & ~(GPIO_CRL_CNF5)) | (GPIO_CRL_CNF5_1);
 	GPIOA->CRL = (GPIOA->CRL & ~(GPIO_CRL_CNF7)) | (GPIO_CRL_CNF7_1);
+
+	// TE on PB0 (floating input after reset) routed to EXTI0
+	RCC->APB2ENR |= RCC_APB2ENR_IOPBEN | RCC_APB2ENR_AFIOEN;
+	AFIO->EXTICR[0] = (AFIO->EXTICR[0] & ~(AFIO_EXTICR1_EXTI0)) | AFIO_EXTICR1_EXTI0_PB;
+}
+
+
+// 2 Mbaud 8N1 from 64 MHz APB1
+void setupUart(void) {
+	RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+	RCC->APB2ENR |= RCC_APB2ENR_IOPAEN;
+	// TX on PA2 alternate push pull, RX on PA3 stays floating input
+	GPIOA->CRL = (GPIOA->CRL & ~(GPIO_CRL_CNF2 | GPIO_CRL_MODE2)) | GPIO_CRL_CNF2_1 | GPIO_CRL_MODE2;
+	USART2->BRR = 32;
+	USART2->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
 }
 
 
 void demoCycleColors(void) {
 	for (uint8_t color = 0; color < 248; color += 8) {
-		st7789_Clear(st7789_RGBToColor(color, color, color));
+		st7789_Clear(&display, st7789_RGBToColor(color, color, color));
 	}
 	for (uint8_t color = 248; color > 0; color -= 8) {
-		st7789_Clear(st7789_RGBToColor(255, color, color));
+		st7789_Clear(&display, st7789_RGBToColor(255, color, color));
 	}
 	for (uint8_t color = 0; color < 248; color += 8) {
-		st7789_Clear(st7789_RGBToColor(255, color, 0));
+		st7789_Clear(&display, st7789_RGBToColor(255, color, 0));
 	}
 	for (uint8_t color = 248; color > 0; color -= 8) {
-		st7789_Clear(st7789_RGBToColor(color, 255, 0));
+		st7789_Clear(&display, st7789_RGBToColor(color, 255, 0));
 	}
 	for (uint8_t color = 0; color < 248; color += 8) {
-		st7789_Clear(st7789_RGBToColor(0, 255, color));
+		st7789_Clear(&display, st7789_RGBToColor(0, 255, color));
 	}
 	for (uint8_t color = 248; color > 0; color -= 8) {
-		st7789_Clear(st7789_RGBToColor(0, color, 255));
+		st7789_Clear(&display, st7789_RGBToColor(0, color, 255));
 	}
 	for (uint8_t color = 248; color > 0; color -= 8) {
-		st7789_Clear(st7789_RGBToColor(0, 0, color));
+		st7789_Clear(&display, st7789_RGBToColor(0, 0, color));
 	}
 }
 
 
-void demoCheckboardDisplay(uint16_t checkboardSize, uint16_t startX, uint16_t startY) {
-	st7789_StartMemoryWrite();
-	bool xPolarity = (startX / checkboardSize) & 1;
-	bool yPolarity = (startY / checkboardSize) & 1;
-	bool initialXPolarity = (startX / checkboardSize) & 1;
-	startX = startX % checkboardSize;
-	startY = startY % checkboardSize;
-	uint16_t lineBuffer[ST7789_LCD_WIDTH * 2];
-	uint16_t *buf = (uint16_t *)(&lineBuffer);
-	uint16_t xCounter = startX;
-	uint16_t yCounter = startY;
-
-	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT + 1; ++line) {
-		uint16_t *frontBuffer = ((line & 1 )== 0) ? (buf + ST7789_LCD_WIDTH) : buf;
-		uint16_t *backBuffer = ((line & 1) == 0) ? buf : (buf + ST7789_LCD_WIDTH);
-		xPolarity = initialXPolarity;
-		if (line > 0) {
-			st7789_WriteDMA(frontBuffer, ST7789_LCD_WIDTH * 2);
-		}
-		if (line < ST7789_LCD_HEIGHT) {
-			xCounter = startX;
-			for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
-				backBuffer[column] = (xPolarity ^ yPolarity) ? 0xffff : st7789_RGBToColor(line, column, 255 - line);
-				xCounter++;
-				if (xCounter == checkboardSize) {
-					xPolarity = !xPolarity;
-					xCounter = 0;
-				}
+typedef struct demoCheckboardContext {
+	uint16_t size;
+	uint16_t startX;
+	uint16_t startY;
+} demoCheckboardContext;
+
+
+typedef struct demoMandelbrotContext {
+	mandelbrotEngine *engine;
+	const uint16_t *colormap;
+} demoMandelbrotContext;
+
+
+// Band callback, gradient follows board
+void demoCheckboardRender(void *context, uint16_t *pixels, const st7789_Rect *band) {
+	const demoCheckboardContext *board = (const demoCheckboardContext *)context;
+	bool initialXPolarity = (board->startX / board->size) & 1;
+
+	for (uint16_t line = band->y; line < band->y + band->height; ++line) {
+		uint16_t boardY = board->startY + line;
+		uint8_t boardLine = boardY;
+		bool yPolarity = (boardY / board->size) & 1;
+		bool xPolarity = initialXPolarity;
+		uint16_t xCounter = board->startX % board->size;
+		for (uint16_t column = 0; column < band->width; ++column) {
+			*pixels++ = (xPolarity ^ yPolarity) ? 0xffff : st7789_RGBToColor(boardLine, board->startX + column, 255 - boardLine);
+			xCounter++;
+			if (xCounter == board->size) {
+				xPolarity = !xPolarity;
+				xCounter = 0;
 			}
 		}
-		if (line > 0) {
-			st7789_WaitForDMA();
-		}
-		yCounter++;
-		if (yCounter == checkboardSize) {
-			yPolarity = !yPolarity;
-			yCounter = 0;
-		}
+	}
+}
+
+
+// Renders rows [firstLine, firstLine + lines) of screen
+void demoCheckboardDisplayRows(uint16_t checkboardSize, uint16_t startX, uint16_t startY, uint16_t firstLine, uint16_t lines) {
+	demoCheckboardContext board = {checkboardSize, startX, startY};
+	st7789_Rect window = {0, firstLine, ST7789_LCD_WIDTH, lines};
+	st7789_RenderWindow(&display, &window, RENDER_BAND_LINES, renderBuffers, RENDER_DEPTH, demoCheckboardRender, &board, NULL);
+}
+
+
+void demoCheckboardDisplay(uint16_t checkboardSize, uint16_t startX, uint16_t startY) {
+	demoCheckboardDisplayRows(checkboardSize, startX, startY, 0, ST7789_LCD_HEIGHT);
+}
+
+
+// Vertical movement by hardware scroll, only exposed rows are rendered
+void demoCheckboardScroll(uint16_t checkboardSize, uint16_t startX, uint16_t startY, uint16_t scrolled, uint16_t dy) {
+	st7789_SetScroll(&display, scrolled % ST7789_LCD_HEIGHT);
+	uint16_t line = ST7789_LCD_HEIGHT - dy;
+	while (line < ST7789_LCD_HEIGHT) {
+		uint16_t rows = st7789_ScrollContiguousRows(&display, line, ST7789_LCD_HEIGHT - line);
+		demoCheckboardDisplayRows(checkboardSize, startX, startY, line, rows);
+		line += rows;
 	}
 }
 
@@ -227,33 +340,54 @@ void demoCheckboard(void) {
 		posY += 15 * (100 - i) / 100;
 		demoCheckboardDisplay(size, posX, posY);
 	}
+	st7789_SetScrollArea(&display, 0, 0);
+	uint16_t scrolled = 0;
+	for (size_t i = 0; i < 100; ++i) {
+		uint16_t dy = 1 + i / 10;
+		posY += dy;
+		scrolled += dy;
+		demoCheckboardScroll(size, posX, posY, scrolled, dy);
+	}
+	st7789_SetScroll(&display, 0);
+	demoCheckboardDisplay(size, posX, posY);
 }
 
 
-uint16_t demoMandelbrotCalculateFast(float_fast_t realInit, float_fast_t imagInit, uint16_t maxiter) {
-	float_fast_t realq, imagq, real, imag;
-	uint16_t iter;
+// Escape counts are written to band buffer and mapped to colors in place
+void demoMandelbrotRender(void *context, uint16_t *pixels, const st7789_Rect *band) {
+	const demoMandelbrotContext *frame = (const demoMandelbrotContext *)context;
+	uint16_t maxiter = frame->engine->view.maxiter;
+	mandelbrotRender(frame->engine, band, pixels);
+	for (uint32_t i = 0; i < (uint32_t)band->width * band->height; ++i) {
+		pixels[i] = (pixels[i] == maxiter) ? 0 : frame->colormap[pixels[i]];
+	}
+}
+
 
-	real = realInit;
-	imag = imagInit;
-	for (iter = 0; iter < maxiter; ++iter) {
-		realq = (real * real) >> FLOAT_FAST_BITS;
-		imagq = (imag * imag) >> FLOAT_FAST_BITS;
-		if ((realq + imagq) > (float_fast_t) 4 * FLOAT_FAST_FACT) {
-			break;
+// Screen is rendered as columns of tiles, two tiles fill render buffers and
+// subdivision gets boxes instead of lines
+void demoMandelbrotFrame(const mandelbrotView *view, const uint16_t *colormap, st7789_RenderStats *stats) {
+	demoMandelbrotContext frame = {&mandelbrotState, colormap};
+	mandelbrotBegin(&mandelbrotState, view);
+	if (stats) {
+		stats->dmaStallTicks = 0;
+		stats->computeStallTicks = 0;
+	}
+	for (uint16_t x = 0; x < ST7789_LCD_WIDTH; x += MANDELBROT_TILE_WIDTH) {
+		st7789_Rect window = {x, 0, MANDELBROT_TILE_WIDTH, ST7789_LCD_HEIGHT};
+		st7789_RenderStats column;
+		st7789_RenderWindow(&display, &window, MANDELBROT_TILE_HEIGHT, renderBuffers, MANDELBROT_TILE_DEPTH, demoMandelbrotRender, &frame, &column);
+		if (stats) {
+			stats->dmaStallTicks += column.dmaStallTicks;
+			stats->computeStallTicks += column.computeStallTicks;
 		}
-		imag = ((real * imag) >> (FLOAT_FAST_BITS - 1)) + imagInit;
-		real = realq - imagq + realInit;
 	}
-	return iter;
 }
 
 
-void demoMandelbrotDisplayFast(float_fast_t realmin, float_fast_t imagmin, float_fast_t realmax, float_fast_t imagmax, uint16_t maxiter) {
-	st7789_StartMemoryWrite();
-	uint16_t lineBuffer[ST7789_LCD_WIDTH * 2];
-	uint16_t *buf = (uint16_t *)(&lineBuffer);
+void demoMandelbrotDisplayFast(const mandelbrotView *view) {
 	uint16_t colormap[MANDELBROT_MAXITER_FAST];
+	uint16_t maxiter = view->maxiter;
 	for (size_t i = 0; i < maxiter; ++i) {
 		colormap[i] = st7789_RGBToColor(
 			(maxiter - i - 1) * 256 / maxiter,
@@ -261,177 +395,276 @@ void demoMandelbrotDisplayFast(float_fast_t realmin, float_fast_t imagmin, float
 			0
 		);
 	}
+	demoMandelbrotFrame(view, colormap, NULL);
+}
 
-	float_fast_t stepReal, stepImag, real, imag;
-	uint8_t column, line;
 
-	stepReal = (realmax - realmin) / ST7789_LCD_WIDTH;
-	stepImag = (imagmax - imagmin) / ST7789_LCD_HEIGHT;
+// Prints time spent waiting for DMA and for computation in CPU cycles
+void demoMandelbrotDisplay(const mandelbrotView *view) {
+	uint16_t colormap[MANDELBROT_MAXITER];
+	for (int i = 0; i < MANDELBROT_MAXITER; ++i) {
+		colormap[i] = st7789_RGBToColor(
+			i < 64 ? (MANDELBROT_MAXITER - i - 1) * 256 / MANDELBROT_MAXITER : 0,
+			i < 64 ? (i * 16) * 256 / MANDELBROT_MAXITER : (i < 319 ? 319 - i : 0),
+			(i * 4) * 256 / MANDELBROT_MAXITER
+		);
+	}
 
-	imag = imagmax;
-	for (line = 0; line < ST7789_LCD_HEIGHT; ++line) {
-		uint16_t *frontBuffer = ((line & 1 )== 0) ? (buf + ST7789_LCD_WIDTH) : buf;
-		uint16_t *backBuffer = ((line & 1) == 0) ? buf : (buf + ST7789_LCD_WIDTH);
-		if (line > 0) {
-			st7789_WriteDMA(frontBuffer, ST7789_LCD_WIDTH * 2);
-		}
+	st7789_RenderStats stats;
+	demoMandelbrotFrame(view, colormap, &stats);
+	svcWriteNumber(stats.dmaStallTicks);
+	svcWriteNumber(stats.computeStallTicks);
+}
+
+
+// Halves every channel, read back from panel instead of frame buffer
+void demoShadeBand(void *context, uint16_t *pixels, const st7789_Rect *band) {
+	(void)context;
+	for (uint32_t i = 0; i < (uint32_t)band->width * band->height; ++i) {
+		pixels[i] = (pixels[i] >> 1) & 0x7bef;
+	}
+}
 
-		real = realmin;
-		for (column = 0; column < ST7789_LCD_WIDTH; ++column) {
-			uint16_t color = demoMandelbrotCalculateFast(real, imag, maxiter);
-			if (color == maxiter) {
-				color = 0;
-			}
-			else {
-				color = colormap[color];
-			}
-			backBuffer[column] = color;
-			real += stepReal;
-		}
-		imag -= stepImag;
 
-		if (line > 0) {
-			st7789_WaitForDMA();
+void demoMandelbrot() {
+	mandelbrotView view;
+	mandelbrotInit(&mandelbrotState);
+	for (uint8_t frame = 0; mandelbrotZoom(frame, &view); ++frame) {
+		if (view.fast) {
+			demoMandelbrotDisplayFast(&view);
+		}
+		else {
+			demoMandelbrotDisplay(&view);
 		}
-		if (line == ST7789_LCD_HEIGHT - 1) {
-			st7789_WriteDMA(backBuffer, ST7789_LCD_WIDTH * 2);
-			st7789_WaitForDMA();
+		if (frame < MANDELBROT_STILL_FRAMES) {
+			st7789_WaitNanosecs(20000);
 		}
 	}
+	// Translucent bar over final frame
+	st7789_Rect bar = {0, ST7789_LCD_HEIGHT - 32, ST7789_LCD_WIDTH, 32};
+	st7789_ModifyWindow(&display, &bar, RENDER_BUFFER_SIZE * 2 / 3 / ST7789_LCD_WIDTH, renderBuffers, demoShadeBand, NULL);
+	st7789_WaitNanosecs(4000000);
 }
 
 
-uint16_t demoMandelbrotCalculate(float_t realInit, float_t imagInit) {
-	float_t realq, imagq, real, imag;
-	uint16_t iter;
-
-	real = realInit;
-	imag = imagInit;
-	for (iter = 0; iter < MANDELBROT_MAXITER; ++iter) {
-		realq = (real * real) >> FLOAT_BITS;
-		imagq = (imag * imag) >> FLOAT_BITS;
-		if ((realq + imagq) > (float_t) 4 * FLOAT_FACT) {
-			break;
+void demoPixelFormatFrame(uint16_t frame) {
+	uint16_t buffers[2][ST7789_LCD_WIDTH];
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buffer = buffers[line & 1];
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buffer[column] = st7789_RGBToColor(line + frame, column, 255 - line);
 		}
-		imag = ((real * imag) >> (FLOAT_BITS - 1)) + imagInit;
-		real = realq - imagq + realInit;
+		st7789_WritePixels(&display, buffer, ST7789_LCD_WIDTH);
 	}
-	return iter;
+	st7789_WaitForDMA(&display);
 }
 
 
-void demoMandelbrotDisplay(float_t realmin, float_t imagmin, float_t realmax, float_t imagmax) {
-	st7789_StartMemoryWrite();
-	uint16_t lineBuffer[ST7789_LCD_WIDTH * 2];
-	uint16_t *buf = (uint16_t *)(&lineBuffer);
-	uint16_t colormap[MANDELBROT_MAXITER];
-	for (int i = 0; i < MANDELBROT_MAXITER; ++i) {
-		colormap[i] = st7789_RGBToColor(
-			i < 64 ? (MANDELBROT_MAXITER - i - 1) * 256 / MANDELBROT_MAXITER : 0,
-			i < 64 ? (i * 16) * 256 / MANDELBROT_MAXITER : (i < 319 ? 319 - i : 0),
-			(i * 4) * 256 / MANDELBROT_MAXITER
-		);
+#ifdef ST7789_STATS
+// Worst frame and total of each driver stage in CPU cycles
+void demoStatsDump() {
+	const st7789_Stats *stats = st7789_StatsGet(&display);
+	svcWriteNumber(stats->frameMax);
+	for (int stage = 0; stage < ST7789_STATS_STAGES; ++stage) {
+		svcWrite0(st7789_StatsStageName((st7789_StatsStage)stage));
+		svcWrite0(" ");
+		svcWriteNumber(stats->stages[stage].maxTicks);
+		svcWrite0(" ");
+		svcWriteNumber((int)stats->stages[stage].totalTicks);
 	}
+}
+#endif
+
+
+// Logs time and frames per second of full screen updates in each format,
+// RGB444 packs into render buffers
+void demoPixelFormats() {
+	const st7789_PixelFormat formats[] = {ST7789_PIXEL_FORMAT_RGB565, ST7789_PIXEL_FORMAT_RGB444};
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+		st7789_SetPixelFormat(&display, formats[i], (uint8_t *)renderBuffers, sizeof(renderBuffers));
+		svcLogTimeReset();
+#ifdef ST7789_STATS
+		st7789_StatsReset(&display);
+#endif
+		for (uint16_t frame = 0; frame < PIXEL_FORMAT_FRAMES; ++frame) {
+#ifdef ST7789_STATS
+			st7789_StatsFrameBegin(&display);
+#endif
+			demoPixelFormatFrame(frame * 4);
+#ifdef ST7789_STATS
+			st7789_StatsFrameEnd(&display);
+#endif
+		}
+		uint32_t ticks = TIM1->CNT;
+		svcLogTime();
+		svcWriteNumber(PIXEL_FORMAT_FRAMES * 10000 / ticks);
+#ifdef ST7789_STATS
+		demoStatsDump();
+#endif
+	}
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB565, NULL, 0);
+}
 
-	float_t stepReal, stepImag, real, imag;
-	uint8_t column, line;
 
-	stepReal = (realmax - realmin) / ST7789_LCD_WIDTH;
-	stepImag = (imagmax - imagmin) / ST7789_LCD_HEIGHT;
+// Bar graph rendered from display list, two bands of pixels in render buffers
+void demoDisplayList() {
+	st7789_DisplayItem items[DISPLAY_LIST_ITEMS];
+	st7789_DisplayList list;
+	const uint16_t barWidth = ST7789_LCD_WIDTH / DISPLAY_LIST_BARS;
 
-	imag = imagmax;
-	for (line = 0; line < ST7789_LCD_HEIGHT; ++line) {
-		uint16_t *frontBuffer = ((line & 1 )== 0) ? (buf + ST7789_LCD_WIDTH) : buf;
-		uint16_t *backBuffer = ((line & 1) == 0) ? buf : (buf + ST7789_LCD_WIDTH);
-		if (line > 0) {
-			st7789_WriteDMA(frontBuffer, ST7789_LCD_WIDTH * 2);
+	st7789_DisplayListInit(&list, items, DISPLAY_LIST_ITEMS, renderBuffers, DISPLAY_LIST_BAND_HEIGHT);
+	for (uint16_t frame = 0; frame < 64; ++frame) {
+		st7789_DisplayListClear(&list, st7789_RGBToColor(0, 0, 32));
+		for (uint16_t y = 20; y < ST7789_LCD_HEIGHT; y += 20) {
+			st7789_DisplayListSpan(&list, 0, y, ST7789_LCD_WIDTH, st7789_RGBToColor(48, 48, 96));
 		}
-
-		real = realmin;
-		for (column = 0; column < ST7789_LCD_WIDTH; ++column) {
-			uint16_t color = demoMandelbrotCalculate(real, imag);
-			if (color == MANDELBROT_MAXITER) {
-				color = 0;
-			}
-			else {
-				color = colormap[color];
-			}
-			backBuffer[column] = color;
-			real += stepReal;
+		for (uint16_t bar = 0; bar < DISPLAY_LIST_BARS; ++bar) {
+			uint16_t phase = (frame * 4 + bar * 24) & 0x7f;
+			uint16_t height = 20 + ((phase < 64) ? phase : 127 - phase) * 3;
+			st7789_DisplayListRect(&list, bar * barWidth + 4, ST7789_LCD_HEIGHT - height, barWidth - 8, height, st7789_RGBToColor(bar * 32, 255 - bar * 32, 128));
 		}
-		imag -= stepImag;
+		// Written behind refresh, starting when scan enters first row
+		st7789_VsyncBeginFrame(&display);
+		st7789_VsyncWaitLine(&display, 0);
+		st7789_DisplayListRender(&display, &list, NULL);
+	}
+}
 
-		if (line > 0) {
-			st7789_WaitForDMA();
-		}
-		if (line == ST7789_LCD_HEIGHT - 1) {
-			st7789_WriteDMA(backBuffer, ST7789_LCD_WIDTH * 2);
-			st7789_WaitForDMA();
+
+#define KERNEL_PIXELS 240
+
+
+// Prints cycles per 100 pixels of line buffer kernels
+void demoPixelKernels() {
+	static uint16_t line[KERNEL_PIXELS];
+	static uint16_t source[KERNEL_PIXELS];
+	static uint8_t rgb[KERNEL_PIXELS * 3];
+	static uint8_t alpha[KERNEL_PIXELS];
+	static const char *names[] = {"scalar", "fill", "copy", "blend", "alpha", "rgb888", "swap"};
+	for (size_t i = 0; i < KERNEL_PIXELS; ++i) {
+		source[i] = st7789_RGBToColor(i, 255 - i, i * 2);
+		rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = i;
+		alpha[i] = i;
+	}
+	for (size_t kernel = 0; kernel < sizeof(names) / sizeof(names[0]); ++kernel) {
+		uint32_t start = st7789_Ticks();
+		switch (kernel) {
+			case 0:
+				for (size_t i = 0; i < KERNEL_PIXELS; ++i) {
+					line[i] = source[i];
+				}
+				break;
+			case 1:
+				st7789_PixelFill(line, 0x1234, KERNEL_PIXELS);
+				break;
+			case 2:
+				st7789_PixelCopy(line, source, KERNEL_PIXELS);
+				break;
+			case 3:
+				st7789_PixelBlend(line, source, ST7789_ALPHA_MAX / 2, KERNEL_PIXELS);
+				break;
+			case 4:
+				st7789_PixelBlendAlpha(line, source, alpha, KERNEL_PIXELS);
+				break;
+			case 5:
+				st7789_PixelFromRGB888(line, rgb, KERNEL_PIXELS);
+				break;
+			case 6:
+				st7789_PixelSwap(line, source, KERNEL_PIXELS);
+				break;
 		}
+		uint32_t cycles = st7789_Ticks() - start;
+		svcWrite0(names[kernel]);
+		svcWrite0(" ");
+		svcWriteNumber(cycles * 100 / KERNEL_PIXELS);
 	}
 }
 
 
-void demoMandelbrot() {
-	float realMin = -2.0;
-	float imagMin = -1.35;
-	float realMax = 0.7;
-	float imagMax = 1.35;
-	const float realFinalMin = -0.749;
-	const float imagFinalMin = 0.125;
-	const float realFinalMax = -0.739;
-	const float imagFinalMax = 0.135;
-
-	for (size_t i = 8; i < 16; ++i) {
-		demoMandelbrotDisplayFast(realMin * FLOAT_FAST_FACT, imagMin * FLOAT_FAST_FACT, realMax * FLOAT_FAST_FACT, imagMax * FLOAT_FAST_FACT, i);
-		st7789_WaitNanosecs(20000);
-	}
-	for (size_t i = 0; i < 24; ++i) {
-		realMin = (realMin * 9 + realFinalMin) / 10;
-		realMax = (realMax * 9 + realFinalMax) / 10;
-		imagMin = (imagMin * 9 + imagFinalMin) / 10;
-		imagMax = (imagMax * 9 + imagFinalMax) / 10;
-		demoMandelbrotDisplayFast(realMin * FLOAT_FAST_FACT, imagMin * FLOAT_FAST_FACT, realMax * FLOAT_FAST_FACT, imagMax * FLOAT_FAST_FACT, 16 + i);
-	}
-
-	demoMandelbrotDisplay(realFinalMin * FLOAT_FACT, imagFinalMin * FLOAT_FACT, realFinalMax * FLOAT_FACT, imagFinalMax * FLOAT_FACT);
-	st7789_WaitNanosecs(4000000);
+typedef struct demoPixmapRequest {
+	uint32_t offset;
+	uint32_t size;
+	uint8_t data[ST7789_IMAGE_INPUT_SIZE];
+} demoPixmapRequest;
+
+
+// Compressed image is read over semihosting (semihosting_helper.py)
+uint32_t demoPixmapRead(void *context, uint8_t *buffer, uint32_t size) {
+	uint32_t *offset = (uint32_t *)context;
+	demoPixmapRequest request;
+	request.offset = *offset;
+	request.size = size;
+	svcCall(0xff, &request);
+	memcpy(buffer, request.data, request.size);
+	*offset += request.size;
+	return request.size;
 }
 
 
 void demoPixmap() {
-	uint16_t line = 0;
-	uint16_t batch = 0;
 	uint16_t pixels[PIXEL_BUFFER_SIZE];
+	uint32_t offset = 0;
+	st7789_Image image;
 
-	st7789_Clear(0x0000);
-	st7789_StartMemoryWrite();
-	while (line < ST7789_LCD_HEIGHT) {
-		pixels[0] = batch;
-		pixels[1] = PIXEL_BUFFER_SIZE;
-		svcCall(0xff, &pixels);
-		st7789_WriteDMA(&pixels, PIXEL_BUFFER_SIZE * 2);
-		st7789_WaitForDMA();
-		line = line + PIXEL_BUFFER_LINES;
-		batch += 1;
+	st7789_Clear(&display, 0x0000);
+	if (st7789_ImageOpenStream(&image, demoPixmapRead, &offset)) {
+		st7789_ImageDraw(&display, &image, (ST7789_LCD_WIDTH - image.width) / 2, (ST7789_LCD_HEIGHT - image.height) / 2, pixels, PIXEL_BUFFER_SIZE);
 	}
 	st7789_WaitNanosecs(2000000);
 }
 
 
+// Frames of stream_display.py go from USART RX DMA to SPI DMA, demo moves
+// on when host sends nothing
+void demoRemoteDisplay() {
+	uint32_t last = st7789_Ticks();
+	st7789_BridgeStart(&remoteBridge);
+	for (;;) {
+		st7789_BridgeStatus status = st7789_BridgePoll(&display, &remoteBridge);
+		if (status == ST7789_BRIDGE_DONE) {
+			st7789_WaitNanosecs(2000000);
+			break;
+		}
+		if (status == ST7789_BRIDGE_FRAME) {
+			last = st7789_Ticks();
+		}
+		else if (st7789_Ticks() - last > REMOTE_IDLE_MS * ST7789_TICKS_PER_MS) {
+			break;
+		}
+	}
+	st7789_BridgeStop(&remoteBridge);
+	st7789_QueueFlush(&display);
+}
+
+
 int main(void) {
 	setupPrescaler(16);
 	setupTimer();
+	setupInterrupts();
 
+	st7789_DeviceInit(&display, &displayConfig);
 	st7789_GPIOInit();
-	st7789_Reset();
-	st7789_Init_1_3_LCD();
+	setupUart();
+	st7789_Reset(&display);
+	st7789_Init_1_3_LCD(&display);
+	st7789_SetGamma(&display, &st7789_Gamma_1_3_LCD);
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_VsyncInit(&display, &displayVsync, EXTI_IMR_MR0, EXTI0_IRQn);
+	st7789_BridgeInit(&remoteBridge, USART2, DMA1_Channel6, (uint8_t *)renderBuffers, REMOTE_SLOTS, REMOTE_SLOT_SIZE);
+#ifdef ST7789_STATS
+	st7789_StatsInit(&display, &displayStats);
+#endif
 
 	for(;;) {
 		demoCycleColors();
 		demoCheckboard();
 		demoMandelbrot();
+		demoPixelFormats();
+		demoPixelKernels();
+		demoDisplayList();
 		demoPixmap();
+		demoRemoteDisplay();
 	}
 	return 0;
 }
@@ -0,0 +1,311 @@
+#include <stddef.h>
+
+#include "mandelbrot.h"
+
+
+#define MANDELBROT_UNSET 0xffff // Count not computed yet, limits are lower
+#define MANDELBROT_MIXED 0xffff // Band has more counts
+
+
+// Escape loops of demo, fast one relies on same int overflow behaviour
+static uint16_t mandelbrotEscapeFast(int realInit, int imagInit, uint16_t maxiter) {
+	int realq, imagq, real, imag;
+	uint16_t iter;
+
+	real = realInit;
+	imag = imagInit;
+	for (iter = 0; iter < maxiter; ++iter) {
+		realq = (real * real) >> MANDELBROT_FAST_BITS;
+		imagq = (imag * imag) >> MANDELBROT_FAST_BITS;
+		if ((realq + imagq) > (int64_t)4 << MANDELBROT_FAST_BITS) {
+			break;
+		}
+		imag = ((real * imag) >> (MANDELBROT_FAST_BITS - 1)) + imagInit;
+		real = realq - imagq + realInit;
+	}
+	return iter;
+}
+
+
+static uint16_t mandelbrotEscape(int64_t realInit, int64_t imagInit, uint16_t maxiter) {
+	int64_t realq, imagq, real, imag;
+	uint16_t iter;
+
+	real = realInit;
+	imag = imagInit;
+	for (iter = 0; iter < maxiter; ++iter) {
+		realq = (real * real) >> MANDELBROT_BITS;
+		imagq = (imag * imag) >> MANDELBROT_BITS;
+		if ((realq + imagq) > (int64_t)4 << MANDELBROT_BITS) {
+			break;
+		}
+		imag = ((real * imag) >> (MANDELBROT_BITS - 1)) + imagInit;
+		real = realq - imagq + realInit;
+	}
+	return iter;
+}
+
+
+// Same arithmetic as mandelbrotEscapeFast. Fixed point orbit which comes
+// back to saved state (Brent, saved at powers of two) never escapes.
+static uint16_t mandelbrotIterateFast(int realInit, int imagInit, uint16_t maxiter, mandelbrotStats *stats) {
+	int realq, imagq, real, imag, savedReal, savedImag;
+	uint16_t iter, power = 1, length = 0;
+
+	real = savedReal = realInit;
+	imag = savedImag = imagInit;
+	for (iter = 0; iter < maxiter; ++iter) {
+		realq = (real * real) >> MANDELBROT_FAST_BITS;
+		imagq = (imag * imag) >> MANDELBROT_FAST_BITS;
+		if ((realq + imagq) > (int64_t)4 << MANDELBROT_FAST_BITS) {
+			break;
+		}
+		imag = ((real * imag) >> (MANDELBROT_FAST_BITS - 1)) + imagInit;
+		real = realq - imagq + realInit;
+		if (real == savedReal && imag == savedImag) {
+			stats->periodic++;
+			stats->iterations += iter + 1;
+			return maxiter;
+		}
+		if (++length == power) {
+			savedReal = real;
+			savedImag = imag;
+			power <<= 1;
+			length = 0;
+		}
+	}
+	stats->iterations += iter;
+	return iter;
+}
+
+
+static uint16_t mandelbrotIterate(int64_t realInit, int64_t imagInit, uint16_t maxiter, mandelbrotStats *stats) {
+	int64_t realq, imagq, real, imag, savedReal, savedImag;
+	uint16_t iter, power = 1, length = 0;
+
+	real = savedReal = realInit;
+	imag = savedImag = imagInit;
+	for (iter = 0; iter < maxiter; ++iter) {
+		realq = (real * real) >> MANDELBROT_BITS;
+		imagq = (imag * imag) >> MANDELBROT_BITS;
+		if ((realq + imagq) > (int64_t)4 << MANDELBROT_BITS) {
+			break;
+		}
+		imag = ((real * imag) >> (MANDELBROT_BITS - 1)) + imagInit;
+		real = realq - imagq + realInit;
+		if (real == savedReal && imag == savedImag) {
+			stats->periodic++;
+			stats->iterations += iter + 1;
+			return maxiter;
+		}
+		if (++length == power) {
+			savedReal = real;
+			savedImag = imag;
+			power <<= 1;
+			length = 0;
+		}
+	}
+	stats->iterations += iter;
+	return iter;
+}
+
+
+// Main cardioid is star shaped around its cusp, point is accepted when it
+// stays inside after moving 1/16 further from cusp. Period 2 bulb is tested
+// with 15/16 of radius. Margin leaves slowly converging orbits near the
+// boundary, where fixed point rounding could decide, to the iteration.
+static bool mandelbrotInterior(int64_t real, int64_t imag, uint8_t bits) {
+	int64_t one = (int64_t)1 << bits;
+	int64_t x = ((real - one / 4) * 17) >> 4;
+	int64_t y = (imag * 17) >> 4;
+	int64_t yy = (y * y) >> bits;
+	int64_t q = ((x * x) >> bits) + yy;
+	if (((q * (q + x)) >> bits) < yy / 4) {
+		return true;
+	}
+	int64_t bulb = real + one;
+	return ((bulb * bulb + imag * imag) >> bits) * 4096 < one * 225;
+}
+
+
+static uint16_t mandelbrotPixel(mandelbrotEngine *engine, uint16_t column, uint16_t row) {
+	const mandelbrotView *view = &engine->view;
+	int64_t real = view->realmin + view->stepReal * column;
+	int64_t imag = view->imagmax - view->stepImag * row;
+	if (mandelbrotInterior(real, imag, view->fast ? MANDELBROT_FAST_BITS : MANDELBROT_BITS)) {
+		engine->stats.rejected++;
+		return view->maxiter;
+	}
+	engine->stats.computed++;
+	if (view->fast) {
+		return mandelbrotIterateFast((int)real, (int)imag, view->maxiter, &engine->stats);
+	}
+	return mandelbrotIterate(real, imag, view->maxiter, &engine->stats);
+}
+
+
+static uint16_t mandelbrotPoint(mandelbrotEngine *engine, const st7789_Rect *band, uint16_t *counts, uint16_t x, uint16_t y) {
+	uint16_t *count = &counts[y * band->width + x];
+	if (*count == MANDELBROT_UNSET) {
+		*count = mandelbrotPixel(engine, band->x + x, band->y + y);
+	}
+	return *count;
+}
+
+
+// Mariani-Silver subdivision: box with one escape count on whole border is
+// filled, otherwise longer side is split and halves share middle line.
+// Corners are inclusive. Boxes bordered by maxiter are not filled, fixed
+// point orbits leave escaping specks inside the set (4 pixels of demo zoom,
+// host bench mandelbrot_zoom) and interior points are cheap anyway after
+// cardioid test and periodicity check.
+static void mandelbrotBox(mandelbrotEngine *engine, const st7789_Rect *band, uint16_t *counts, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	uint16_t first = mandelbrotPoint(engine, band, counts, x0, y0);
+	bool uniform = true;
+	for (uint16_t x = x0; x <= x1; ++x) {
+		uniform &= mandelbrotPoint(engine, band, counts, x, y0) == first;
+		uniform &= mandelbrotPoint(engine, band, counts, x, y1) == first;
+	}
+	for (uint16_t y = y0 + 1; y < y1; ++y) {
+		uniform &= mandelbrotPoint(engine, band, counts, x0, y) == first;
+		uniform &= mandelbrotPoint(engine, band, counts, x1, y) == first;
+	}
+	if (x1 - x0 < 2 || y1 - y0 < 2) {
+		return;
+	}
+	if (uniform && first < engine->view.maxiter) {
+		for (uint16_t y = y0 + 1; y < y1; ++y) {
+			for (uint16_t x = x0 + 1; x < x1; ++x) {
+				counts[y * band->width + x] = first;
+			}
+		}
+		engine->stats.filled += (uint32_t)(x1 - x0 - 1) * (y1 - y0 - 1);
+		return;
+	}
+	if (x1 - x0 >= y1 - y0) {
+		uint16_t middle = (x0 + x1) / 2;
+		mandelbrotBox(engine, band, counts, x0, y0, middle, y1);
+		mandelbrotBox(engine, band, counts, middle, y0, x1, y1);
+	}
+	else {
+		uint16_t middle = (y0 + y1) / 2;
+		mandelbrotBox(engine, band, counts, x0, y0, x1, middle);
+		mandelbrotBox(engine, band, counts, x0, middle, x1, y1);
+	}
+}
+
+
+void mandelbrotInit(mandelbrotEngine *engine) {
+	engine->band = 0;
+	engine->previousMaxiter = 0;
+	engine->stats = (mandelbrotStats){0, 0, 0, 0, 0, 0};
+	for (uint16_t band = 0; band < MANDELBROT_CACHE_TILES; ++band) {
+		engine->uniform[band] = MANDELBROT_MIXED;
+	}
+}
+
+
+void mandelbrotBegin(mandelbrotEngine *engine, const mandelbrotView *view) {
+	const mandelbrotView *last = &engine->view;
+	bool sameGrid = engine->band > 0 && view->fast == last->fast && view->realmin == last->realmin && view->imagmax == last->imagmax && view->stepReal == last->stepReal && view->stepImag == last->stepImag;
+	// Bands not rendered in last frame are stale
+	for (uint16_t band = sameGrid ? engine->band : 0; band < MANDELBROT_CACHE_TILES; ++band) {
+		engine->uniform[band] = MANDELBROT_MIXED;
+	}
+	engine->previousMaxiter = sameGrid ? last->maxiter : 0;
+	engine->view = *view;
+	engine->band = 0;
+}
+
+
+// Count below both limits does not depend on limit, uniform band of last
+// frame on same grid is copied
+void mandelbrotRender(mandelbrotEngine *engine, const st7789_Rect *band, uint16_t *counts) {
+	uint32_t size = (uint32_t)band->width * band->height;
+	uint16_t index = engine->band++;
+	uint16_t cached = (index < MANDELBROT_CACHE_TILES) ? engine->uniform[index] : MANDELBROT_MIXED;
+	if (cached < engine->previousMaxiter && cached < engine->view.maxiter) {
+		for (uint32_t i = 0; i < size; ++i) {
+			counts[i] = cached;
+		}
+		engine->stats.reused += size;
+		return;
+	}
+	for (uint32_t i = 0; i < size; ++i) {
+		counts[i] = MANDELBROT_UNSET;
+	}
+	mandelbrotBox(engine, band, counts, 0, 0, band->width - 1, band->height - 1);
+	if (index < MANDELBROT_CACHE_TILES) {
+		uint16_t uniform = counts[0];
+		for (uint32_t i = 1; i < size && uniform != MANDELBROT_MIXED; ++i) {
+			if (counts[i] != uniform) {
+				uniform = MANDELBROT_MIXED;
+			}
+		}
+		engine->uniform[index] = uniform;
+	}
+}
+
+
+// Rows are computed from imagmax, columns accumulate steps
+void mandelbrotReference(const mandelbrotView *view, const st7789_Rect *band, uint16_t *counts) {
+	for (uint16_t line = band->y; line < band->y + band->height; ++line) {
+		if (view->fast) {
+			int imag = view->imagmax - view->stepImag * line;
+			int real = view->realmin + view->stepReal * band->x;
+			for (uint16_t column = 0; column < band->width; ++column) {
+				*counts++ = mandelbrotEscapeFast(real, imag, view->maxiter);
+				real += view->stepReal;
+			}
+		}
+		else {
+			int64_t imag = view->imagmax - view->stepImag * line;
+			int64_t real = view->realmin + view->stepReal * band->x;
+			for (uint16_t column = 0; column < band->width; ++column) {
+				*counts++ = mandelbrotEscape(real, imag, view->maxiter);
+				real += view->stepReal;
+			}
+		}
+	}
+}
+
+
+// Still frames with limit 8 .. 15, 24 frames approaching final view with
+// limit 16 .. 39 and final view in precise arithmetic. Float coordinates
+// are rounded to fixed point as in demo before.
+bool mandelbrotZoom(uint8_t frame, mandelbrotView *view) {
+	float realMin = -2.0;
+	float imagMin = -1.35;
+	float realMax = 0.7;
+	float imagMax = 1.35;
+	const float realFinalMin = -0.749;
+	const float imagFinalMin = 0.125;
+	const float realFinalMax = -0.739;
+	const float imagFinalMax = 0.135;
+	const uint8_t zoomFrames = 24;
+
+	if (frame > MANDELBROT_STILL_FRAMES + zoomFrames) {
+		return false;
+	}
+	if (frame == MANDELBROT_STILL_FRAMES + zoomFrames) {
+		int64_t realmin = realFinalMin * ((int64_t)1 << MANDELBROT_BITS);
+		int64_t imagmin = imagFinalMin * ((int64_t)1 << MANDELBROT_BITS);
+		int64_t realmax = realFinalMax * ((int64_t)1 << MANDELBROT_BITS);
+		int64_t imagmax = imagFinalMax * ((int64_t)1 << MANDELBROT_BITS);
+		*view = (mandelbrotView){realmin, imagmax, (realmax - realmin) / ST7789_LCD_WIDTH, (imagmax - imagmin) / ST7789_LCD_HEIGHT, 1024, false};
+		return true;
+	}
+	uint16_t maxiter = 8 + frame;
+	for (uint8_t step = MANDELBROT_STILL_FRAMES; step <= frame; ++step) {
+		realMin = (realMin * 9 + realFinalMin) / 10;
+		realMax = (realMax * 9 + realFinalMax) / 10;
+		imagMin = (imagMin * 9 + imagFinalMin) / 10;
+		imagMax = (imagMax * 9 + imagFinalMax) / 10;
+	}
+	int realmin = realMin * ((int64_t)1 << MANDELBROT_FAST_BITS);
+	int imagmin = imagMin * ((int64_t)1 << MANDELBROT_FAST_BITS);
+	int realmax = realMax * ((int64_t)1 << MANDELBROT_FAST_BITS);
+	int imagmax = imagMax * ((int64_t)1 << MANDELBROT_FAST_BITS);
+	*view = (mandelbrotView){realmin, imagmax, (realmax - realmin) / ST7789_LCD_WIDTH, (imagmax - imagmin) / ST7789_LCD_HEIGHT, maxiter, true};
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef MANDELBROT_H
+#define MANDELBROT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <st7789.h>
+
+
+#define MANDELBROT_BITS 20          // Fixed point of precise views, int64_t arithmetic
+#define MANDELBROT_FAST_BITS 13     // Fixed point of fast views, int arithmetic
+#define MANDELBROT_CACHE_TILES 128  // Bands per frame remembered for next frame
+#define MANDELBROT_STILL_FRAMES 8   // Zoom starts with growing limit on same view
+
+
+// Pixel (column, row) is realmin + stepReal * column, imagmax - stepImag * row
+typedef struct mandelbrotView {
+	int64_t realmin;
+	int64_t imagmax;
+	int64_t stepReal;
+	int64_t stepImag;
+	uint16_t maxiter;
+	bool fast;
+} mandelbrotView;
+
+typedef struct mandelbrotStats {
+	uint32_t iterations; // Kernel iterations
+	uint32_t computed;   // Pixels iterated
+	uint32_t filled;     // Pixels inside box with uniform border
+	uint32_t rejected;   // Pixels inside main cardioid or period 2 bulb
+	uint32_t periodic;   // Pixels stopped on repeated orbit
+	uint32_t reused;     // Pixels of uniform bands taken from previous frame
+} mandelbrotStats;
+
+// Escape counts of uniform bands of last frame, reused while sample grid
+// stays the same (iteration limit grows in place)
+typedef struct mandelbrotEngine {
+	mandelbrotView view;
+	mandelbrotStats stats;
+	uint16_t band;            // Next band of frame
+	uint16_t previousMaxiter; // 0 when grid of last frame differs
+	uint16_t uniform[MANDELBROT_CACHE_TILES];
+} mandelbrotEngine;
+
+
+void mandelbrotInit(mandelbrotEngine *engine);
+// Starts frame, bands have to be rendered in same order in every frame
+void mandelbrotBegin(mandelbrotEngine *engine, const mandelbrotView *view);
+// Escape counts of band, maxiter for points which did not escape
+void mandelbrotRender(mandelbrotEngine *engine, const st7789_Rect *band, uint16_t *counts);
+// Every pixel iterated up to maxiter, as demo did before
+void mandelbrotReference(const mandelbrotView *view, const st7789_Rect *band, uint16_t *counts);
+// View of zoom sequence frame, false after last frame
+bool mandelbrotZoom(uint8_t frame, mandelbrotView *view);
+
+#endif
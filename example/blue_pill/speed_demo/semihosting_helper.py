@@ -31,16 +31,18 @@ def write0(message):
 	gdb.execute('continue')
 
 
-def writePixels(message):
+def readImage(message):
 	inferior = gdb.inferiors()[0]
-	batch, size = struct.unpack('<HH', inferior.read_memory(message, 4).tobytes())
-	with open('image.png.dat', 'rb') as fp:
-		fp.seek(batch * size * 2)
-		inferior.write_memory(message, fp.read(size * 2));
+	offset, size = struct.unpack('<II', inferior.read_memory(message, 8).tobytes())
+	with open('image.png.q565', 'rb') as fp:
+		fp.seek(offset)
+		data = fp.read(size)
+	inferior.write_memory(message + 8, data)
+	inferior.write_memory(message + 4, struct.pack('<I', len(data)))
 	gdb.execute('continue')
 
 
 SVC_COMMANDS = {
 	0x04: write0,
-	0xff: writePixels,
+	0xff: readImage,
 }
@@ -0,0 +1,164 @@
+# -*- coding: utf-8 -*-
+"""
+Sends image to remote display demo over serial line (lib/st7789_bridge.h)
+
+usage: stream_display.py [--baud N] [--slot-size N] [--gradient] [image] port
+"""
+import argparse
+import binascii
+import os
+import struct
+import sys
+import termios
+
+
+PANEL_SIZE = (240, 240)
+SLOT_SIZE = 16 + 240 * 2 # REMOTE_SLOT_SIZE in main.c
+
+MAGIC = 0x53
+FRAME_PIXELS = 1
+FRAME_COMMAND = 2
+FRAME_END = 3
+NAK = 0x80
+SEQUENCE_MASK = 0x7f
+
+BAUD_RATES = {
+	115200: termios.B115200,
+	230400: termios.B230400,
+	460800: getattr(termios, 'B460800', None),
+	921600: getattr(termios, 'B921600', None),
+	1000000: getattr(termios, 'B1000000', None),
+	2000000: getattr(termios, 'B2000000', None),
+}
+
+
+def encode_frame(frame_type, sequence, window, payload, slot_size):
+	"""
+	Header, CRC-16/CCITT-FALSE of header and payload, padding to slot size
+	"""
+	header = struct.pack('<BBBBHHHHH', MAGIC, frame_type, sequence & SEQUENCE_MASK, 0, *window, len(payload))
+	crc = binascii.crc_hqx(header + payload, 0xffff)
+	frame = header + struct.pack('<H', crc) + payload
+	if len(frame) > slot_size:
+		raise ValueError("Frame does not fit to slot")
+	return frame + bytes(slot_size - len(frame))
+
+
+def band_frames(width, height, x, y, pixels, slot_size):
+	"""
+	Splits little endian RGB565 pixels to bands of whole rows
+	"""
+	lines = (slot_size - 16) // (width * 2)
+	if lines == 0:
+		raise ValueError("Row does not fit to slot")
+	frames = []
+	for top in range(0, height, lines):
+		rows = min(lines, height - top)
+		payload = b''.join(struct.pack('<H', pixel) for pixel in pixels[top * width:(top + rows) * width])
+		frames.append((FRAME_PIXELS, (x, y + top, width, rows), payload))
+	return frames
+
+
+def gradient_frames(slot_size):
+	"""
+	Pattern of bridge_stream scenario of host emulator
+	"""
+	width, height = PANEL_SIZE
+	pixels = [((py >> 3) << 11) | ((px >> 2) << 5) | ((255 - py) >> 3) for py in range(height) for px in range(width)]
+	return band_frames(width, height, 0, 0, pixels, slot_size)
+
+
+def image_frames(path, slot_size):
+	from PIL import Image
+	with open(path, 'rb') as image_fp:
+		im = Image.open(image_fp)
+		im = im.convert('RGB')
+	im.thumbnail(PANEL_SIZE)
+	pixels = [((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3) for r, g, b in im.getdata()]
+	x = (PANEL_SIZE[0] - im.width) // 2
+	y = (PANEL_SIZE[1] - im.height) // 2
+	return band_frames(im.width, im.height, x, y, pixels, slot_size)
+
+
+def open_port(path, baud):
+	fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+	attributes = termios.tcgetattr(fd)
+	# Raw 8N1 like cfmakeraw
+	attributes[0] &= ~(termios.IGNBRK | termios.BRKINT | termios.PARMRK | termios.ISTRIP | termios.INLCR | termios.IGNCR | termios.ICRNL | termios.IXON)
+	attributes[1] &= ~termios.OPOST
+	attributes[2] &= ~(termios.CSIZE | termios.PARENB)
+	attributes[2] |= termios.CS8 | termios.CLOCAL | termios.CREAD
+	attributes[3] &= ~(termios.ECHO | termios.ECHONL | termios.ICANON | termios.ISIG | termios.IEXTEN)
+	attributes[6][termios.VMIN] = 1
+	attributes[6][termios.VTIME] = 0
+	speed = BAUD_RATES.get(baud)
+	if speed is None:
+		raise ValueError("Unsupported baud rate %d" % baud)
+	attributes[4] = speed
+	attributes[5] = speed
+	termios.tcsetattr(fd, termios.TCSANOW, attributes)
+	return fd
+
+
+def stream(fd, frames, slot_size):
+	"""
+	Sends frame per granted slot, goes back to sequence of NAK reply.
+	Returns after reply acknowledges end frame.
+	"""
+	frames = frames + [(FRAME_END, (0, 0, 0, 0), b'')]
+	next_frame = 0
+	credits = 0
+	synced = False
+	resends = 0
+	while True:
+		while synced and credits > 0 and next_frame < len(frames):
+			frame_type, window, payload = frames[next_frame]
+			data = encode_frame(frame_type, next_frame, window, payload, slot_size)
+			while data:
+				data = data[os.write(fd, data):]
+			next_frame += 1
+			credits -= 1
+		reply = os.read(fd, 1)
+		if not reply:
+			raise IOError("Serial line closed")
+		reply = reply[0]
+		sequence = reply & SEQUENCE_MASK
+		if reply & NAK:
+			# First NAK is sent by device when demo starts
+			if synced:
+				resends += (next_frame - sequence) & SEQUENCE_MASK
+			synced = True
+			credits = 0
+			next_frame -= (next_frame - sequence) & SEQUENCE_MASK
+		elif synced:
+			credits += 1
+			if next_frame == len(frames) and sequence == len(frames) & SEQUENCE_MASK:
+				return resends
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Remote display sender")
+	parser.add_argument('--baud', type=int, default=2000000)
+	parser.add_argument('--slot-size', type=int, default=SLOT_SIZE)
+	parser.add_argument('--gradient', action='store_true', help="send test pattern instead of image")
+	parser.add_argument('image', nargs='?')
+	parser.add_argument('port')
+	args = parser.parse_args()
+
+	if args.gradient:
+		frames = gradient_frames(args.slot_size)
+	elif args.image:
+		frames = image_frames(args.image, args.slot_size)
+	else:
+		parser.error("image or --gradient is required")
+
+	fd = open_port(args.port, args.baud)
+	try:
+		resends = stream(fd, frames, args.slot_size)
+	finally:
+		os.close(fd)
+	sys.stdout.write("%d frames, %d resent\n" % (len(frames) + 1, resends))
+
+
+if __name__ == "__main__":
+	main()
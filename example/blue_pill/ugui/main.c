@@ -2,11 +2,18 @@
 #include <stdlib.h>
 
 #include <st7789.h>
+#include <st7789_text.h>
+#include <st7789_ugui.h>
 #include <stm32f10x.h>
 #include <svc.h>
 #include <ugui.h>
 
 
+// Panel on SPI1, D/CX on PA8, RST on PA9
+static const st7789_Config displayConfig = {ST7789_SPI1_DMA, GPIOA, GPIO_ODR_ODR8, GPIOA, GPIO_ODR_ODR9, ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0};
+static st7789_Device display;
+
+
 void setupPrescaler(int pllmul) {
 	// enable high speed external oscillator
 	RCC->CR = (RCC->CR & ~RCC_CR_HSEBYP) | RCC_CR_HSEON;
@@ -45,24 +52,24 @@ void st7789_GPIOInit(void) {
 	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
 
 	// Enable SPI
-	ST7789_SPI->SR = 0;
+	SPI1->SR = 0;
 	// Reverse polarity?
-	ST7789_SPI->CR1 = \
+	SPI1->CR1 = \
 		SPI_CR1_SSM | \
 		SPI_CR1_SSI | \
 		SPI_CR1_MSTR | \
 		SPI_CR1_CPOL | \
 		SPI_CR1_BIDIMODE | \
 		SPI_CR1_BIDIOE;
-	ST7789_SPI->CR1 |= SPI_CR1_SPE;
+	SPI1->CR1 |= SPI_CR1_SPE;
 	
 	// DC and RST signals
 	// Maximum output speed
-	ST7789_DC_PORT->CRH |= GPIO_CRH_MODE8;
-	ST7789_RST_PORT->CRH |= GPIO_CRH_MODE9;
+	GPIOA->CRH |= GPIO_CRH_MODE8;
+	GPIOA->CRH |= GPIO_CRH_MODE9;
 	// Output push pull
-	ST7789_DC_PORT->CRH &= ~(GPIO_CRH_CNF8);
-	ST7789_RST_PORT->CRH &= ~(GPIO_CRH_CNF9);
+	GPIOA->CRH &= ~(GPIO_CRH_CNF8);
+	GPIOA->CRH &= ~(GPIO_CRH_CNF9);
 
 	// SPI pins
 	// Maximum output speed on PA5/PA7
@@ -74,59 +81,115 @@ void st7789_GPIOInit(void) {
 }
 
 
-void UG_Driver_PushPixel(UG_COLOR color) {
-	st7789_WriteDMA(&color, 2);
-	st7789_WaitForDMA();
-}
-
-
-void UG_Driver_SetPixel(UG_S16 x, UG_S16 y, UG_COLOR color) {
-	st7789_SetWindow(x, y, x, y);
-	st7789_WriteDMA(&color, 2);
-	st7789_WaitForDMA();
-	st7789_SetWindow(0, 0, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
+// Console between fixed title and status bar, text rows scroll in hardware
+#define CONSOLE_TOP        16
+#define CONSOLE_BOTTOM     14
+#define CONSOLE_ROW        14
+#define CONSOLE_COLUMN     8
+#define CONSOLE_ROWS       ((ST7789_LCD_HEIGHT - CONSOLE_TOP - CONSOLE_BOTTOM) / CONSOLE_ROW)
+#define CONSOLE_COLUMNS    (ST7789_LCD_WIDTH / CONSOLE_COLUMN)
+
+
+static uint16_t consoleRow;
+static uint16_t consoleColumn;
+static UG_COLOR consoleForeground = C_WHITE;
+static UG_COLOR consoleBackground = C_BLACK;
+static st7789_Font consoleFont;
+static st7789_Text consoleText;
+static uint32_t consoleBand[ST7789_LCD_WIDTH * 2];
+
+
+void consoleInit(void) {
+	st7789_UguiFlush();
+	st7789_SetScrollArea(&display, CONSOLE_TOP, ST7789_LCD_HEIGHT - CONSOLE_TOP - CONSOLE_ROWS * CONSOLE_ROW);
+	st7789_FillArea(&display, consoleBackground, 0, CONSOLE_TOP, ST7789_LCD_WIDTH, CONSOLE_ROWS * CONSOLE_ROW);
+	consoleFont = (st7789_Font)ST7789_UGUI_FONT(FONT_8X14);
+	st7789_TextInit(&consoleText, &consoleFont, (uint16_t *)consoleBand, sizeof(consoleBand) / 2);
+	consoleRow = 0;
+	consoleColumn = 0;
 }
 
 
-UG_RESULT UG_Driver_FillFrame(UG_S16 x1, UG_S16 y1, UG_S16 x2, UG_S16 y2, UG_COLOR color) {
-	st7789_FillArea(color, x1, y1, x2, y2);
-	return UG_RESULT_OK;
+// Scrolls by one text row when bottom is reached, only new row is cleared
+void consoleNewLine(void) {
+	st7789_UguiFlush();
+	consoleColumn = 0;
+	if (consoleRow < CONSOLE_ROWS - 1) {
+		consoleRow++;
+		return;
+	}
+	st7789_SetScroll(&display, st7789_GetScroll(&display) + CONSOLE_ROW);
+	st7789_FillArea(&display, consoleBackground, 0, CONSOLE_TOP + consoleRow * CONSOLE_ROW, ST7789_LCD_WIDTH, CONSOLE_ROW);
 }
 
 
-void(*UG_Driver_FillArea(UG_S16 x1, UG_S16 y1, UG_S16 x2, UG_S16 y2))(UG_COLOR) {
-	st7789_SetWindow(x1, y1, x2, y2);
-	return UG_Driver_PushPixel;
+// Text up to end of line is drawn by one st7789_TextDrawLine call
+void consolePutString(const char *text) {
+	if (consoleText.foreground != consoleForeground || consoleText.background != consoleBackground) {
+		st7789_TextSetColors(&consoleText, consoleForeground, consoleBackground);
+	}
+	while (*text) {
+		if (*text == '\n') {
+			consoleNewLine();
+			text++;
+			continue;
+		}
+		if (consoleColumn == CONSOLE_COLUMNS) {
+			consoleNewLine();
+		}
+		uint16_t length = 0;
+		while (text[length] && text[length] != '\n' && consoleColumn + length < CONSOLE_COLUMNS) {
+			length++;
+		}
+		st7789_TextDrawLine(&display, &consoleText, consoleColumn * CONSOLE_COLUMN, CONSOLE_TOP + consoleRow * CONSOLE_ROW, text, length);
+		consoleColumn += length;
+		text += length;
+	}
 }
 
 
 int main(void) {
 	setupPrescaler(16);
 
+	st7789_DeviceInit(&display, &displayConfig);
 	st7789_GPIOInit();
-	st7789_Reset();
-	st7789_Init_1_3_LCD();
+	st7789_Reset(&display);
+	st7789_Init_1_3_LCD(&display);
+	st7789_UguiSelect(&display);
 
 	UG_GUI gui;
-	UG_Init(&gui, UG_Driver_SetPixel, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
+	UG_Init(&gui, st7789_UguiSetPixel, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
 	UG_SelectGUI(&gui);
 
-	//UG_DriverRegister(DRIVER_DRAW_LINE, (void *) UG_Driver_DrawLine);
-	UG_DriverRegister(DRIVER_FILL_FRAME, (void *) UG_Driver_FillFrame);
-	UG_DriverRegister(DRIVER_FILL_AREA, (void *) UG_Driver_FillArea);
-	//UG_DriverEnable(DRIVER_DRAW_LINE);
+	UG_DriverRegister(DRIVER_DRAW_LINE, (void *) st7789_UguiDrawLine);
+	UG_DriverRegister(DRIVER_FILL_FRAME, (void *) st7789_UguiFillFrame);
+	UG_DriverRegister(DRIVER_FILL_AREA, (void *) st7789_UguiFillArea);
+	UG_DriverEnable(DRIVER_DRAW_LINE);
 	UG_DriverEnable(DRIVER_FILL_FRAME);
 	UG_DriverEnable(DRIVER_FILL_AREA);
 
-	UG_FillFrame(0, 0, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT, C_BLACK);
+	UG_FillFrame(0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1, C_BLACK);
 	/* Draw text with uGUI */
 	UG_FontSelect(&FONT_8X14);
-	UG_ConsoleSetArea(0, 0, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
-	UG_ConsoleSetBackcolor(C_BLACK);
-	UG_ConsoleSetForecolor(C_RED);
-	UG_ConsolePutString("Beginning System Initialization...\n");
-	UG_ConsoleSetForecolor(C_GREEN);
-	UG_ConsolePutString("System Initialization Complete\n");
+	UG_FillFrame(0, 0, ST7789_LCD_WIDTH - 1, CONSOLE_TOP - 1, C_NAVY);
+	UG_SetForecolor(C_WHITE);
+	UG_SetBackcolor(C_NAVY);
+	UG_PutString(4, 1, "System console");
+	UG_FillFrame(0, ST7789_LCD_HEIGHT - CONSOLE_BOTTOM, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1, C_DIM_GRAY);
+	consoleInit();
+	consoleForeground = C_RED;
+	consolePutString("Beginning System Initialization...\n");
+	consoleForeground = C_GREEN;
+	consolePutString("System Initialization Complete\n");
+
+	// Every line after the 15th costs one text row of pixel writes
+	consoleForeground = C_WHITE;
+	char number[8];
+	for (int i = 0; i < 100; ++i) {
+		consolePutString("Line ");
+		consolePutString(itoa(i, number, 10));
+		consolePutString("\n");
+	}
 
 	for(;;) {
 	}
@@ -0,0 +1,2261 @@
+// Wire level cost report of lib/st7789.c and lib/st7789.hpp running against
+// the emulated panel
+//
+// Every scenario starts from a freshly reset MCU and panel, most of them
+// from an initialised display. Numbers are totals divided by the number of
+// API calls in the scenario. Cycles are virtual CPU cycles of the emulator
+// (register accesses and SPI shifting), not including the C code between
+// register accesses.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Output delay masks of termios.h collide with register names
+#undef CR0
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include <st7789.h>
+#include <st7789_queue.h>
+#include <st7789_damage.h>
+#include <st7789_display_list.h>
+#include <st7789_vsync.h>
+#include <st7789_ugui.h>
+#include <st7789_text.h>
+#include <st7789_image.h>
+#include <st7789_blit.h>
+#include <st7789_pixels.h>
+#include <st7789_render.h>
+#include <st7789_stats.h>
+#include <st7789_bridge.h>
+#include <st7789_readback.h>
+#include <st7789_gamma.h>
+#include <st7789_power.h>
+#include <st7789.hpp>
+
+#include "demo/mandelbrot.h"
+#include "emulator/mcu.h"
+#include "emulator/panel.h"
+
+
+#define BENCH_STACK_SIZE (1024 * 1024)
+
+
+typedef struct bench_Scenario {
+	const char *name;
+	uint32_t calls;
+	bool initialized;
+	void (*run)(void);
+	void (*report)(void); // Optional extra output after cost line
+	void (*setup)(void);  // Optional state preparation, not counted
+} bench_Scenario;
+
+
+// Host time base for the weak st7789_WaitNanosecs
+void st7789_WaitNanosecs(uint32_t ns) {
+	emu_Delay((uint64_t)ns * EMU_CPU_MHZ / 1000);
+}
+
+
+void *svcCall(int command, const void *message) {
+	(void)command;
+	(void)message;
+	return NULL;
+}
+
+
+void svcWrite0(const char *message) {
+	fputs(message, stdout);
+}
+
+
+#define BENCH_QUEUE_LINES 4
+
+
+static const char *outputDir;
+static const char *bridgeSender; // -s, external bridge_stream sender
+static int exitCode;
+
+
+// Panels of emulated board (emulator/mcu.h)
+static const st7789_Config displayConfig = {ST7789_SPI1_DMA, EMU_PANEL1_DC_PORT, EMU_PANEL1_DC_PIN, EMU_PANEL1_RST_PORT, EMU_PANEL1_RST_PIN, ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0};
+static const st7789_Config secondConfig = {ST7789_SPI2_DMA, EMU_PANEL2_DC_PORT, EMU_PANEL2_DC_PIN, EMU_PANEL2_RST_PORT, EMU_PANEL2_RST_PIN, ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0};
+static st7789_Device display;
+static st7789_Device second;
+static st7789_Queue displayQueue;
+static st7789_Queue secondQueue;
+static st7789_Vsync displayVsync;
+static uint8_t benchPack[2 * ST7789_PACK_BUFFER_SIZE];
+
+
+static void benchDisplayDMAInterrupt(void) {
+	st7789_DMAInterruptHandler(&display);
+}
+
+
+static void benchDisplayTEInterrupt(void) {
+	st7789_TEInterruptHandler(&display);
+}
+
+
+static void benchSecondDMAInterrupt(void) {
+	st7789_DMAInterruptHandler(&second);
+}
+
+
+static uint16_t benchLine[ST7789_LCD_WIDTH * BENCH_QUEUE_LINES];
+static uint16_t benchFrame[ST7789_LCD_WIDTH * ST7789_LCD_HEIGHT];
+
+
+static uint16_t benchGradient(uint16_t x, uint16_t y) {
+	return st7789_RGBToColor((uint8_t)y, (uint8_t)x, (uint8_t)(255 - y));
+}
+
+
+static void benchInit(void) {
+	st7789_Reset(&display);
+	st7789_Init_1_3_LCD(&display);
+}
+
+
+#define BENCH_INIT_SLICE (EMU_CPU_MHZ * 10) // Application work between polls
+
+static uint32_t benchInitPolls;
+static uint64_t benchInitFreeCycles;
+static uint64_t benchInitCycles;
+
+
+// Application main loop runs 10 us of other work between polls
+static void benchInitAsync(void) {
+	st7789_InitState state;
+	benchInitPolls = 0;
+	benchInitFreeCycles = 0;
+	emu_Counters before = emu_GetCounters();
+	st7789_InitStart(&display, &state);
+	do {
+		emu_Delay(BENCH_INIT_SLICE);
+		benchInitFreeCycles += BENCH_INIT_SLICE;
+		benchInitPolls++;
+	} while (!st7789_InitPoll(&display, &state));
+	emu_Counters after = emu_GetCounters();
+	benchInitCycles = after.cycles - before.cycles;
+}
+
+
+static void benchInitReport(void) {
+	printf(
+		"  init: ready after %u us, %u polls, %u us free for application\n",
+		(unsigned)(benchInitCycles / EMU_CPU_MHZ),
+		benchInitPolls,
+		(unsigned)(benchInitFreeCycles / EMU_CPU_MHZ)
+	);
+}
+
+
+static void benchSetWindow(void) {
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+}
+
+
+static void benchWriteCommand(void) {
+	st7789_WriteCommand(&display, ST7789_CMD_MADCTL, "\x00", 1);
+}
+
+
+static void benchReadId(void) {
+	uint8_t id[3];
+	st7789_ReadCommand(&display, ST7789_CMD_RDDID, id, sizeof(id));
+}
+
+
+static void benchPixel(void) {
+	static uint16_t color;
+	for (uint16_t i = 0; i < 64; ++i) {
+		color = st7789_RGBToColor(255, (uint8_t)(i * 4), 0);
+		st7789_SetWindow(&display, i, i, i, i);
+		st7789_WriteDMA(&display, &color, 2);
+		st7789_WaitForDMA(&display);
+	}
+}
+
+
+static void benchFillGlyph(void) {
+	for (uint16_t i = 0; i < 16; ++i) {
+		st7789_FillArea(&display, st7789_RGBToColor(0, 255, 0), (uint16_t)(i * 8), 16, 8, 14);
+	}
+}
+
+
+static void benchFillRect(void) {
+	st7789_FillArea(&display, st7789_RGBToColor(0, 0, 255), 20, 40, 100, 60);
+}
+
+
+static void benchClear(void) {
+	st7789_Clear(&display, st7789_RGBToColor(255, 255, 255));
+}
+
+
+static void benchQueueClear(void) {
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_QueueWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	st7789_QueueFill(&display, st7789_RGBToColor(255, 255, 255), ST7789_LCD_WIDTH * ST7789_LCD_HEIGHT, NULL, NULL);
+	st7789_QueueFlush(&display);
+}
+
+
+static void benchRectOutline(void) {
+	st7789_DrawRect(&display, st7789_RGBToColor(255, 0, 0), 10, 10, 220, 220);
+}
+
+
+static void benchFillRects(void) {
+	st7789_Rect rects[16];
+	for (uint16_t i = 0; i < 16; ++i) {
+		rects[i].x = (uint16_t)((i % 4) * 60 + 5);
+		rects[i].y = (uint16_t)((i / 4) * 60 + 5);
+		rects[i].width = 50;
+		rects[i].height = 50;
+	}
+	st7789_FillRects(&display, st7789_RGBToColor(255, 255, 0), rects, 16);
+}
+
+
+static void benchStreamLines(void) {
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buf = benchLine + (line & 1) * ST7789_LCD_WIDTH;
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buf[column] = benchGradient(column, line);
+		}
+		st7789_WriteDMA(&display, buf, ST7789_LCD_WIDTH * 2);
+		st7789_WaitForDMA(&display);
+	}
+}
+
+
+static void benchQueueFrame(void) {
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			benchFrame[y * ST7789_LCD_WIDTH + x] = benchGradient(x, y);
+		}
+	}
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_QueueWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	st7789_QueuePixels(&display, benchFrame, sizeof(benchFrame), NULL, NULL);
+	st7789_QueueFlush(&display);
+}
+
+
+static void benchQueueLines(void) {
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_QueueWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buf = benchLine + (line % BENCH_QUEUE_LINES) * ST7789_LCD_WIDTH;
+		// Buffer is free once at most BENCH_QUEUE_LINES - 1 lines are pending
+		st7789_QueueWait(&display, BENCH_QUEUE_LINES - 1);
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buf[column] = benchGradient(column, line);
+		}
+		st7789_QueuePixels(&display, buf, ST7789_LCD_WIDTH * 2, NULL, NULL);
+	}
+	st7789_QueueFlush(&display);
+}
+
+
+static void benchStreamFrame(void) {
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buf = benchLine + (line & 1) * ST7789_LCD_WIDTH;
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buf[column] = benchGradient(column, line);
+		}
+		st7789_WritePixels(&display, buf, ST7789_LCD_WIDTH);
+	}
+	st7789_WaitForDMA(&display);
+}
+
+
+static void benchStreamFrame444(void) {
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB444, benchPack, sizeof(benchPack));
+	benchStreamFrame();
+}
+
+
+// Fills in both formats must land on same pixels
+static void benchFillSwitch(void) {
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB444, benchPack, sizeof(benchPack));
+	st7789_FillArea(&display, st7789_RGBToColor(255, 255, 255), 10, 10, 100, 100);
+	st7789_FillArea(&display, st7789_RGBToColor(255, 128, 0), 21, 21, 77, 77);
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB565, NULL, 0);
+	st7789_FillArea(&display, st7789_RGBToColor(0, 0, 255), 40, 40, 41, 41);
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB444, benchPack, sizeof(benchPack));
+	st7789_FillArea(&display, st7789_RGBToColor(0, 255, 0), 55, 55, 11, 11);
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB565, NULL, 0);
+}
+
+
+static void benchQueueClear444(void) {
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB444, benchPack, sizeof(benchPack));
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_QueueWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	st7789_QueueFill(&display, st7789_RGBToColor(255, 128, 0), ST7789_LCD_WIDTH * ST7789_LCD_HEIGHT, NULL, NULL);
+	st7789_QueueFlush(&display);
+}
+
+
+static void benchDamageRender(const st7789_Rect *rect, void *context) {
+	(void)context;
+	for (uint16_t line = 0; line < rect->height; ++line) {
+		for (uint16_t column = 0; column < rect->width; ++column) {
+			benchLine[column] = benchGradient(rect->x + column, rect->y + line);
+		}
+		st7789_WriteDMA(&display, benchLine, rect->width * 2);
+		st7789_WaitForDMA(&display);
+	}
+}
+
+
+// Two adjacent labels, a cursor and an icon changed since last frame
+static void benchDamageWidgets(void) {
+	static st7789_Damage damage;
+	st7789_DamageInit(&damage, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
+	st7789_DamageAdd(&damage, 16, 20, 40, 14);
+	st7789_DamageAdd(&damage, 56, 20, 40, 14);
+	st7789_DamageAdd(&damage, 60, 30, 30, 8);
+	st7789_DamageAdd(&damage, 120, 120, 2, 10);
+	st7789_DamageAdd(&damage, 200, 196, 24, 24);
+	st7789_DamageFlush(&display, &damage, benchDamageRender, NULL);
+}
+
+
+static void benchDamageFull(void) {
+	static st7789_Damage damage;
+	st7789_DamageInit(&damage, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
+	st7789_DamageAll(&damage);
+	st7789_DamageFlush(&display, &damage, benchDamageRender, NULL);
+}
+
+
+// Console with fixed title and status bar, 15 text rows scroll between them
+#define BENCH_CONSOLE_TOP 16
+#define BENCH_CONSOLE_BOTTOM 14
+#define BENCH_CONSOLE_ROW 14
+#define BENCH_CONSOLE_ROWS ((ST7789_LCD_HEIGHT - BENCH_CONSOLE_TOP - BENCH_CONSOLE_BOTTOM) / BENCH_CONSOLE_ROW)
+
+
+// Background and a few glyph sized blocks, layout depends on line number
+static void benchConsoleLine(uint16_t slot, uint16_t line) {
+	uint16_t y = BENCH_CONSOLE_TOP + slot * BENCH_CONSOLE_ROW;
+	st7789_FillArea(&display, 0x0000, 0, y, ST7789_LCD_WIDTH, BENCH_CONSOLE_ROW);
+	for (uint16_t glyph = 0; glyph < 4 + line % 8; ++glyph) {
+		st7789_FillArea(&display, benchGradient(glyph * 16, line * 8), glyph * 10, y + 2, 8, 10);
+	}
+}
+
+
+static void benchConsoleSetup(void) {
+	st7789_SetScrollArea(&display, BENCH_CONSOLE_TOP, BENCH_CONSOLE_BOTTOM);
+	st7789_FillArea(&display, st7789_RGBToColor(0, 0, 128), 0, 0, ST7789_LCD_WIDTH, BENCH_CONSOLE_TOP);
+	st7789_FillArea(&display, st7789_RGBToColor(64, 64, 64), 0, ST7789_LCD_HEIGHT - BENCH_CONSOLE_BOTTOM, ST7789_LCD_WIDTH, BENCH_CONSOLE_BOTTOM);
+	for (uint16_t slot = 0; slot < BENCH_CONSOLE_ROWS; ++slot) {
+		benchConsoleLine(slot, slot);
+	}
+}
+
+
+// New line with hardware scroll, only the exposed row is drawn
+static void benchScrollRow(void) {
+	st7789_SetScroll(&display, st7789_GetScroll(&display) + BENCH_CONSOLE_ROW);
+	benchConsoleLine(BENCH_CONSOLE_ROWS - 1, BENCH_CONSOLE_ROWS);
+}
+
+
+// Same result by repainting every text row
+static void benchRepaintRows(void) {
+	for (uint16_t slot = 0; slot < BENCH_CONSOLE_ROWS; ++slot) {
+		benchConsoleLine(slot, slot + 1);
+	}
+}
+
+
+#define BENCH_BAND_HEIGHT 8
+#define BENCH_BLIT_SIZE 64
+
+
+static uint8_t benchFontData[('~' - ' ' + 1) * 8];
+static const st7789_Font benchFont = {benchFontData, 8, 8, ' ', '~'};
+
+
+// Blocky 8x8 glyphs derived from character code, stable for checksums
+static void benchFontInit(void) {
+	for (uint16_t c = ' '; c <= '~'; ++c) {
+		for (uint16_t row = 0; row < 8; ++row) {
+			uint8_t bits = (c == ' ') ? 0 : (uint8_t)((c * 37u + row * 11u) ^ (c >> row));
+			benchFontData[(c - ' ') * 8 + row] = (row == 0 || row == 7) ? 0 : (uint8_t)(bits & 0x7e);
+		}
+	}
+}
+
+
+// Status screen: header, grid of spans, text, blit and overlapping box
+static void benchDisplayList(void) {
+	static st7789_DisplayItem items[64];
+	static uint16_t bands[2 * ST7789_LCD_WIDTH * BENCH_BAND_HEIGHT];
+	static st7789_DisplayList list;
+	for (uint16_t y = 0; y < BENCH_BLIT_SIZE; ++y) {
+		for (uint16_t x = 0; x < BENCH_BLIT_SIZE; ++x) {
+			benchFrame[y * BENCH_BLIT_SIZE + x] = benchGradient(x * 4, y * 4);
+		}
+	}
+	benchFontInit();
+	st7789_DisplayListInit(&list, items, 64, bands, BENCH_BAND_HEIGHT);
+	st7789_DisplayListClear(&list, st7789_RGBToColor(16, 16, 48));
+	st7789_DisplayListRect(&list, 0, 0, ST7789_LCD_WIDTH, 20, st7789_RGBToColor(0, 96, 192));
+	st7789_DisplayListText(&list, 4, 6, &benchFont, "Display list", 0xffff, 0, true);
+	for (uint16_t y = 30; y < 230; y += 20) {
+		st7789_DisplayListSpan(&list, 10, y, 220, st7789_RGBToColor(64, 64, 96));
+	}
+	st7789_DisplayListBlit(&list, 20, 40, BENCH_BLIT_SIZE, BENCH_BLIT_SIZE, benchFrame);
+	st7789_DisplayListText(&list, 100, 50, &benchFont, "Temp 23.5", st7789_RGBToColor(255, 255, 0), 0x0000, false);
+	st7789_DisplayListText(&list, 100, 70, &benchFont, "Hum  41 %", st7789_RGBToColor(0, 255, 255), 0x0000, false);
+	st7789_DisplayListRect(&list, 60, 90, 120, 100, st7789_RGBToColor(192, 32, 32));
+	st7789_DisplayListRect(&list, 70, 100, 100, 80, st7789_RGBToColor(255, 255, 255));
+	st7789_DisplayListText(&list, 78, 136, &benchFont, "ALARM", st7789_RGBToColor(192, 32, 32), 0, true);
+	st7789_DisplayListRender(&display, &list, NULL);
+}
+
+
+static void benchStreamGradient(uint16_t frame) {
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buf = benchLine + (line & 1) * ST7789_LCD_WIDTH;
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buf[column] = benchGradient(column + frame * 16, line);
+		}
+		st7789_WritePixels(&display, buf, ST7789_LCD_WIDTH);
+	}
+	st7789_WaitForDMA(&display);
+}
+
+
+// Full screen updates ignoring refresh
+static void benchTearing(void) {
+	for (uint16_t frame = 0; frame < 4; ++frame) {
+		benchStreamGradient(frame);
+	}
+}
+
+
+// Frame starts at TE, rows are written after refresh passed them, third
+// frame renders too long and misses one refresh
+static void benchVsyncFrames(void) {
+	st7789_VsyncInit(&display, &displayVsync, EXTI_IMR_MR0, EXTI0_IRQn);
+	for (uint16_t frame = 0; frame < 4; ++frame) {
+		if (frame == 2) {
+			emu_Delay(ST7789_VSYNC_FRAME_TICKS);
+		}
+		st7789_VsyncBeginFrame(&display);
+		st7789_VsyncWaitLine(&display, 0);
+		benchStreamGradient(frame);
+	}
+}
+
+
+// RGB444 is faster than refresh, every row waits for the scan
+static void benchVsync444(void) {
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB444, benchPack, sizeof(benchPack));
+	st7789_VsyncInit(&display, &displayVsync, EXTI_IMR_MR0, EXTI0_IRQn);
+	for (uint16_t frame = 0; frame < 4; ++frame) {
+		st7789_VsyncBeginFrame(&display);
+		st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+		for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+			uint16_t *buf = benchLine + (line & 1) * ST7789_LCD_WIDTH;
+			for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+				buf[column] = benchGradient(column + frame * 16, line);
+			}
+			st7789_VsyncWaitLine(&display, line);
+			st7789_WritePixels(&display, buf, ST7789_LCD_WIDTH);
+		}
+		st7789_WaitForDMA(&display);
+	}
+}
+
+
+static void benchVsyncReport(void) {
+	const st7789_VsyncStats *stats = st7789_VsyncGetStats(&display);
+	printf(
+		"  vsync: edges %u frames %u missed %u latency %u..%u us, scanline %u (estimated %u)\n",
+		stats->edges,
+		stats->frames,
+		stats->missedFrames,
+		stats->latencyMin / EMU_CPU_MHZ,
+		stats->latencyMax / EMU_CPU_MHZ,
+		st7789_VsyncReadScanline(&display),
+		st7789_VsyncScanline(&display)
+	);
+}
+
+
+#define BENCH_UGUI_TEXT "Hello uGUI 0123!"
+#define BENCH_UGUI_LINES 8
+
+
+// Per pixel driver of the uGUI example before st7789_ugui
+static void benchLegacyPush(uint16_t color) {
+	st7789_WriteDMA(&display, &color, 2);
+	st7789_WaitForDMA(&display);
+}
+
+
+static void benchLegacySetPixel(int16_t x, int16_t y, uint16_t color) {
+	st7789_SetWindow(&display, x, y, x, y);
+	st7789_WriteDMA(&display, &color, 2);
+	st7789_WaitForDMA(&display);
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
+}
+
+
+static st7789_UguiPush benchLegacyFillArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+	st7789_SetWindow(&display, x1, y1, x2, y2);
+	return benchLegacyPush;
+}
+
+
+// Glyph loop of uGUI _UG_PutChar with DRIVER_FILL_AREA
+static void benchUguiText(st7789_UguiPush (*fillArea)(int16_t, int16_t, int16_t, int16_t)) {
+	const char *text = BENCH_UGUI_TEXT;
+	for (uint16_t i = 0; text[i]; ++i) {
+		const uint8_t *glyph = benchFontData + (text[i] - ' ') * 8;
+		st7789_UguiPush push = fillArea(i * 8, 16, i * 8 + 7, 23);
+		for (uint16_t row = 0; row < 8; ++row) {
+			for (uint16_t column = 0; column < 8; ++column) {
+				push(((glyph[row] >> column) & 1) ? 0xffff : st7789_RGBToColor(0, 0, 128));
+			}
+		}
+	}
+}
+
+
+// Transparent text, uGUI calls pset for foreground pixels only
+static void benchUguiTransparent(void (*pset)(int16_t, int16_t, uint16_t)) {
+	const char *text = BENCH_UGUI_TEXT;
+	for (uint16_t row = 0; row < 8; ++row) {
+		for (uint16_t i = 0; text[i]; ++i) {
+			const uint8_t *glyph = benchFontData + (text[i] - ' ') * 8;
+			for (uint16_t column = 0; column < 8; ++column) {
+				if ((glyph[row] >> column) & 1) {
+					pset(i * 8 + column, 40 + row, st7789_RGBToColor(255, 255, 0));
+				}
+			}
+		}
+	}
+}
+
+
+// Bresenham fallback of UG_DrawLine
+static void benchUguiLineFallback(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+	int16_t dx = abs(x2 - x1);
+	int16_t dy = abs(y2 - y1);
+	int16_t sx = (x2 > x1) ? 1 : -1;
+	int16_t sy = (y2 > y1) ? 1 : -1;
+	int32_t error = dx - dy;
+	for (;;) {
+		benchLegacySetPixel(x1, y1, color);
+		if (x1 == x2 && y1 == y2) {
+			break;
+		}
+		int32_t error2 = 2 * error;
+		if (error2 > -dy) {
+			error -= dy;
+			x1 += sx;
+		}
+		if (error2 < dx) {
+			error += dx;
+			y1 += sy;
+		}
+	}
+}
+
+
+// Star of lines in all octants
+static void benchUguiLines(bool legacy) {
+	for (int16_t i = 0; i < BENCH_UGUI_LINES; ++i) {
+		int16_t x = (i < 4) ? 60 + i * 40 : 230;
+		int16_t y = (i < 4) ? 230 : 70 + (i - 4) * 40;
+		uint16_t color = benchGradient(i * 30, 128);
+		if (legacy) {
+			benchUguiLineFallback(120, 140, x, y, color);
+			benchUguiLineFallback(120, 140, 240 - x, 280 - y, color);
+		}
+		else {
+			st7789_UguiDrawLine(120, 140, x, y, color);
+			st7789_UguiDrawLine(120, 140, 240 - x, 280 - y, color);
+		}
+	}
+}
+
+
+static void benchUguiTextLegacy(void) {
+	benchFontInit();
+	benchUguiText(benchLegacyFillArea);
+}
+
+
+static void benchUguiTextBatched(void) {
+	benchFontInit();
+	benchUguiText(st7789_UguiFillArea);
+	st7789_UguiFlush();
+}
+
+
+static void benchUguiPsetLegacy(void) {
+	benchFontInit();
+	benchUguiTransparent(benchLegacySetPixel);
+}
+
+
+static void benchUguiPsetBatched(void) {
+	benchFontInit();
+	benchUguiTransparent(st7789_UguiSetPixel);
+	st7789_UguiFlush();
+}
+
+
+static void benchUguiLinesLegacy(void) {
+	benchUguiLines(true);
+}
+
+
+static void benchUguiLinesBatched(void) {
+	benchUguiLines(false);
+}
+
+
+static st7789_Text benchText;
+static uint32_t benchTextBand[ST7789_LCD_WIDTH * BENCH_BAND_HEIGHT];
+
+
+static void benchTextSetup(void) {
+	benchFontInit();
+	st7789_TextInit(&benchText, &benchFont, (uint16_t *)benchTextBand, ST7789_LCD_WIDTH * BENCH_BAND_HEIGHT * 2);
+	st7789_TextSetColors(&benchText, 0xffff, st7789_RGBToColor(0, 0, 128));
+}
+
+
+// Same glyphs as ugui_text in one window
+static void benchTextLine(void) {
+	st7789_TextDraw(&display, &benchText, 0, 16, BENCH_UGUI_TEXT);
+}
+
+
+// Screen of text lines, glyphs repeat and come from cache
+static void benchTextScreen(void) {
+	static const char *lines[] = {
+		"Temperature  21.5 C",
+		"Humidity     48 %",
+		"Pressure     1013 hPa",
+		"Battery      3.71 V",
+	};
+	for (uint16_t i = 0; i < 24; ++i) {
+		st7789_TextDraw(&display, &benchText, 0, i * 10, lines[i % 4]);
+	}
+}
+
+
+static void benchTextReport(void) {
+	printf("  text: cache hits %u misses %u\n", (unsigned)benchText.stats.hits, (unsigned)benchText.stats.misses);
+}
+
+
+// Reference encoder, same as encode_q565 in convert_image.py
+static uint32_t benchEncodeImage(uint8_t *out, uint16_t width, uint16_t height, const uint16_t *pixels) {
+	uint8_t *start = out;
+	uint16_t index[ST7789_IMAGE_INDEX_SIZE] = {0};
+	uint16_t previous = 0;
+	uint8_t run = 0;
+	uint32_t count = (uint32_t)width * height;
+	memcpy(out, "q565", 4);
+	out[4] = width & 0xff;
+	out[5] = width >> 8;
+	out[6] = height & 0xff;
+	out[7] = height >> 8;
+	out += ST7789_IMAGE_HEADER_SIZE;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint16_t pixel = pixels[i];
+		if (pixel == previous) {
+			run++;
+			if (run == 62 || i == count - 1) {
+				*out++ = ST7789_IMAGE_OP_RUN | (run - 1);
+				run = 0;
+			}
+			continue;
+		}
+		if (run) {
+			*out++ = ST7789_IMAGE_OP_RUN | (run - 1);
+			run = 0;
+		}
+		uint8_t hash = ((pixel >> 11) * 3 + ((pixel >> 5) & 0x3f) * 5 + (pixel & 0x1f) * 7) % ST7789_IMAGE_INDEX_SIZE;
+		if (index[hash] == pixel) {
+			*out++ = ST7789_IMAGE_OP_INDEX | hash;
+		}
+		else {
+			index[hash] = pixel;
+			int dr = (((pixel >> 11) - (previous >> 11) + 16) & 0x1f) - 16;
+			int dg = ((((pixel >> 5) & 0x3f) - ((previous >> 5) & 0x3f) + 32) & 0x3f) - 32;
+			int db = (((pixel & 0x1f) - (previous & 0x1f) + 16) & 0x1f) - 16;
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+				*out++ = ST7789_IMAGE_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+			}
+			else if (dr - dg >= -8 && dr - dg <= 7 && db - dg >= -8 && db - dg <= 7) {
+				*out++ = ST7789_IMAGE_OP_LUMA | (dg + 32);
+				*out++ = ((dr - dg + 8) << 4) | (db - dg + 8);
+			}
+			else {
+				*out++ = ST7789_IMAGE_OP_PIXEL;
+				*out++ = pixel & 0xff;
+				*out++ = pixel >> 8;
+			}
+		}
+		previous = pixel;
+	}
+	return (uint32_t)(out - start);
+}
+
+
+static uint8_t benchImageData[ST7789_IMAGE_HEADER_SIZE + ST7789_LCD_WIDTH * ST7789_LCD_HEIGHT * 3];
+static uint32_t benchImageSize;
+static uint32_t benchImageOffset;
+static st7789_Image benchImage;
+
+
+// Gradient of damage_full with noise and flat panels, decoded image is
+// checked against source
+static void benchImageSetup(void) {
+	uint32_t seed = 1;
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			seed = seed * 1103515245 + 12345;
+			uint16_t pixel = benchGradient(x, y);
+			if (y >= 160) {
+				pixel ^= (seed >> 16) & 0x0821;
+			}
+			if (x >= 160 && y < 80) {
+				pixel = ((x / 20 + y / 20) & 1) ? 0xffff : st7789_RGBToColor(200, 30, 30);
+			}
+			benchFrame[y * ST7789_LCD_WIDTH + x] = pixel;
+		}
+	}
+	benchImageSize = benchEncodeImage(benchImageData, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT, benchFrame);
+
+	static uint16_t decoded[ST7789_LCD_WIDTH * ST7789_LCD_HEIGHT];
+	st7789_ImageOpen(&benchImage, benchImageData, benchImageSize);
+	if (st7789_ImageDecode(&benchImage, decoded, sizeof(decoded) / 2) != sizeof(decoded) / 2 || memcmp(decoded, benchFrame, sizeof(decoded)) != 0) {
+		fprintf(stderr, "image: decoded pixels differ from source\n");
+		exitCode = 1;
+	}
+}
+
+
+// Stream in odd sized pieces to split ops between reads
+static uint32_t benchImageRead(void *context, uint8_t *buffer, uint32_t size) {
+	(void)context;
+	uint32_t length = (size > 37) ? 37 : size;
+	if (length > benchImageSize - benchImageOffset) {
+		length = benchImageSize - benchImageOffset;
+	}
+	memcpy(buffer, benchImageData + benchImageOffset, length);
+	benchImageOffset += length;
+	return length;
+}
+
+
+static void benchImageDraw(void) {
+	st7789_ImageOpen(&benchImage, benchImageData, benchImageSize);
+	st7789_ImageDraw(&display, &benchImage, 0, 0, benchLine, sizeof(benchLine) / 2);
+}
+
+
+static void benchImageStream(void) {
+	benchImageOffset = 0;
+	st7789_ImageOpenStream(&benchImage, benchImageRead, NULL);
+	st7789_ImageDraw(&display, &benchImage, 0, 0, benchLine, sizeof(benchLine) / 2);
+}
+
+
+static void benchImageReport(void) {
+	printf("  image: %u bytes compressed, %u raw\n", (unsigned)benchImageSize, (unsigned)(ST7789_LCD_WIDTH * ST7789_LCD_HEIGHT * 2));
+}
+
+
+#define BENCH_PIXELS_TEST 1000
+#define BENCH_SPRITE_SIZE 32
+#define BENCH_SPRITES 4
+
+
+static uint8_t benchSpriteData[BENCH_SPRITES][BENCH_SPRITE_SIZE * BENCH_SPRITE_SIZE];
+static uint16_t benchSpriteColors[256];
+static const uint32_t benchSpriteKey[8] = {0x00000001};
+static const uint32_t benchSpriteMask[8] = {0x00000021};
+static st7789_Bitmap benchSprites[BENCH_SPRITES];
+static st7789_Palette benchSpritePalettes[BENCH_SPRITES];
+
+
+static uint8_t benchSpriteIndex(const st7789_Bitmap *bitmap, uint16_t x, uint16_t y) {
+	uint32_t bit = (uint32_t)x * bitmap->bpp;
+	uint8_t byte = bitmap->data[y * ST7789_BITMAP_STRIDE(bitmap) + bit / 8];
+	return (byte >> (bit % 8)) & ((1u << bitmap->bpp) - 1);
+}
+
+
+// Icons of 1, 2, 4 and 8 bpp (ring with key coloured corners), blitter is
+// checked against per pixel reference on unaligned source areas
+static void benchSpriteSetup(void) {
+	static const uint8_t bpps[BENCH_SPRITES] = {1, 2, 4, 8};
+	for (uint16_t i = 0; i < 256; ++i) {
+		benchSpriteColors[i] = st7789_RGBToColor((uint8_t)(i * 37), (uint8_t)(i * 91), (uint8_t)(i * 53));
+	}
+	for (uint16_t s = 0; s < BENCH_SPRITES; ++s) {
+		st7789_Bitmap *bitmap = &benchSprites[s];
+		uint8_t bpp = bpps[s];
+		uint8_t *data = benchSpriteData[s];
+		bitmap->data = data;
+		bitmap->width = BENCH_SPRITE_SIZE;
+		bitmap->height = BENCH_SPRITE_SIZE - s;
+		bitmap->bpp = bpp;
+		memset(data, 0, sizeof(benchSpriteData[s]));
+		for (uint16_t y = 0; y < bitmap->height; ++y) {
+			for (uint16_t x = 0; x < bitmap->width; ++x) {
+				int dx = x - 16;
+				int dy = y - 16;
+				int distance = dx * dx + dy * dy;
+				uint8_t index = (distance > 225) ? 0 : (uint8_t)((distance / 16 + x) & ((1u << bpp) - 1));
+				uint32_t bit = (uint32_t)x * bpp;
+				data[y * ST7789_BITMAP_STRIDE(bitmap) + bit / 8] |= index << (bit % 8);
+			}
+		}
+		benchSpritePalettes[s].colors = benchSpriteColors;
+		benchSpritePalettes[s].transparent = (bpp == 4) ? benchSpriteMask : benchSpriteKey;
+
+		static uint16_t out[BENCH_SPRITE_SIZE * BENCH_SPRITE_SIZE];
+		st7789_Rect source = {3, 1, 27, 20};
+		for (uint16_t i = 0; i < BENCH_SPRITE_SIZE * BENCH_SPRITE_SIZE; ++i) {
+			out[i] = 0x1234;
+		}
+		st7789_BlitIndexed(out, BENCH_SPRITE_SIZE, bitmap, &benchSpritePalettes[s], &source);
+		for (uint16_t y = 0; y < BENCH_SPRITE_SIZE; ++y) {
+			for (uint16_t x = 0; x < BENCH_SPRITE_SIZE; ++x) {
+				uint16_t expected = 0x1234;
+				if (x < source.width && y < source.height) {
+					uint8_t index = benchSpriteIndex(bitmap, source.x + x, source.y + y);
+					if (!((benchSpritePalettes[s].transparent[index >> 5] >> (index & 31)) & 1)) {
+						expected = benchSpriteColors[index];
+					}
+				}
+				if (out[y * BENCH_SPRITE_SIZE + x] != expected) {
+					fprintf(stderr, "sprite: %u bpp blit differs at %u,%u\n", bpp, x, y);
+					exitCode = 1;
+					return;
+				}
+			}
+		}
+	}
+}
+
+
+// Sprites over striped background and each other
+static void benchSpriteList(void) {
+	static st7789_DisplayItem items[32];
+	static uint16_t bands[2 * ST7789_LCD_WIDTH * BENCH_BAND_HEIGHT];
+	static st7789_DisplayList list;
+	st7789_DisplayListInit(&list, items, 32, bands, BENCH_BAND_HEIGHT);
+	st7789_DisplayListClear(&list, st7789_RGBToColor(20, 20, 40));
+	for (uint16_t i = 0; i < 8; ++i) {
+		st7789_DisplayListRect(&list, 0, i * 30, ST7789_LCD_WIDTH, 10, st7789_RGBToColor(40, 60, 40));
+	}
+	for (uint16_t i = 0; i < 16; ++i) {
+		st7789_DisplayListSprite(&list, (uint16_t)(10 + (i % 4) * 56 + i), (uint16_t)(10 + (i / 4) * 56 + i), &benchSprites[i % BENCH_SPRITES], &benchSpritePalettes[i % BENCH_SPRITES]);
+	}
+	st7789_DisplayListRender(&display, &list, NULL);
+}
+
+
+static void benchSpriteDraw(void) {
+	for (uint16_t i = 0; i < BENCH_SPRITES; ++i) {
+		st7789_DrawIndexed(&display, (uint16_t)(i * 40), 100, &benchSprites[i], &benchSpritePalettes[i], benchLine, sizeof(benchLine) / 2);
+	}
+}
+
+
+static void benchSpriteReport(void) {
+	uint32_t indexed = 0;
+	uint32_t raw = 0;
+	for (uint16_t i = 0; i < BENCH_SPRITES; ++i) {
+		indexed += ST7789_BITMAP_STRIDE(&benchSprites[i]) * benchSprites[i].height;
+		raw += (uint32_t)benchSprites[i].width * benchSprites[i].height * 2;
+	}
+	printf("  sprite: %u bytes indexed, %u RGB565\n", (unsigned)indexed, (unsigned)raw);
+}
+
+
+// Scalar references of st7789_pixels kernels
+static uint16_t benchReferenceMix(uint16_t dst, uint16_t src, int alpha) {
+	int r = (dst >> 11) + ((((src >> 11) - (dst >> 11)) * alpha) >> 5);
+	int g = ((dst >> 5) & 0x3f) + (((((src >> 5) & 0x3f) - ((dst >> 5) & 0x3f)) * alpha) >> 5);
+	int b = (dst & 0x1f) + ((((src & 0x1f) - (dst & 0x1f)) * alpha) >> 5);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+
+static void benchPixelsFail(const char *kernel, uint32_t offset, uint32_t count) {
+	fprintf(stderr, "pixels: %s differs from reference (offset %u, count %u)\n", kernel, (unsigned)offset, (unsigned)count);
+	exitCode = 1;
+}
+
+
+// Kernels against references for all buffer alignments and short counts,
+// blend for every alpha over random pixel pairs
+static void benchPixelsSetup(void) {
+	static uint16_t source[BENCH_PIXELS_TEST + 2];
+	static uint16_t expected[BENCH_PIXELS_TEST + 2];
+	static uint16_t actual[BENCH_PIXELS_TEST + 2];
+	static uint8_t rgb[(BENCH_PIXELS_TEST + 2) * 3];
+	static uint8_t alpha[BENCH_PIXELS_TEST + 2];
+	uint32_t seed = 7;
+	for (uint32_t i = 0; i < BENCH_PIXELS_TEST + 2; ++i) {
+		seed = seed * 1103515245 + 12345;
+		source[i] = (uint16_t)(seed >> 8);
+		alpha[i] = (uint8_t)(seed >> 24);
+		rgb[i * 3] = (uint8_t)(seed >> 3);
+		rgb[i * 3 + 1] = (uint8_t)(seed >> 13);
+		rgb[i * 3 + 2] = (uint8_t)(seed >> 23);
+	}
+	for (uint32_t offset = 0; offset < 2; ++offset) {
+		for (uint32_t count = 0; count <= BENCH_PIXELS_TEST; count += (count < 20) ? 1 : 37) {
+			uint16_t *out = actual + offset;
+			const uint16_t *in = source + (1 - offset);
+
+			for (uint32_t i = 0; i < count; ++i) {
+				expected[i] = 0xbeef;
+			}
+			st7789_PixelFill(out, 0xbeef, count);
+			if (memcmp(out, expected, count * 2) != 0) {
+				benchPixelsFail("fill", offset, count);
+			}
+
+			st7789_PixelCopy(out, source + offset, count);
+			if (memcmp(out, source + offset, count * 2) != 0) {
+				benchPixelsFail("copy", offset, count);
+			}
+			st7789_PixelCopy(out, in, count);
+			if (memcmp(out, in, count * 2) != 0) {
+				benchPixelsFail("copy unaligned", offset, count);
+			}
+
+			for (uint32_t i = 0; i < count; ++i) {
+				expected[i] = (uint16_t)((in[i] << 8) | (in[i] >> 8));
+			}
+			st7789_PixelSwap(out, in, count);
+			if (memcmp(out, expected, count * 2) != 0) {
+				benchPixelsFail("swap", offset, count);
+			}
+			st7789_PixelSwap(out, source + offset, count);
+			for (uint32_t i = 0; i < count; ++i) {
+				expected[i] = (uint16_t)((source[offset + i] << 8) | (source[offset + i] >> 8));
+			}
+			if (memcmp(out, expected, count * 2) != 0) {
+				benchPixelsFail("swap aligned", offset, count);
+			}
+
+			const uint8_t *color = rgb + offset;
+			for (uint32_t i = 0; i < count; ++i) {
+				expected[i] = (uint16_t)(((color[i * 3] & 0xf8) << 8) | ((color[i * 3 + 1] & 0xfc) << 3) | (color[i * 3 + 2] >> 3));
+			}
+			st7789_PixelFromRGB888(out, color, count);
+			if (memcmp(out, expected, count * 2) != 0) {
+				benchPixelsFail("rgb888", offset, count);
+			}
+
+			for (uint32_t i = 0; i < count; ++i) {
+				int a = (alpha[i] + 4) >> 3;
+				expected[i] = benchReferenceMix(source[count - i], in[i], a);
+				out[i] = source[count - i];
+			}
+			st7789_PixelBlendAlpha(out, in, alpha, count);
+			if (memcmp(out, expected, count * 2) != 0) {
+				benchPixelsFail("blend alpha", offset, count);
+			}
+		}
+	}
+	for (int a = 0; a <= ST7789_ALPHA_MAX; ++a) {
+		for (uint32_t i = 0; i < BENCH_PIXELS_TEST; ++i) {
+			expected[i] = benchReferenceMix(source[i + 1], source[i], a);
+			actual[i] = source[i + 1];
+		}
+		st7789_PixelBlend(actual, source, (uint8_t)a, BENCH_PIXELS_TEST);
+		if (memcmp(actual, expected, BENCH_PIXELS_TEST * 2) != 0) {
+			benchPixelsFail("blend", (uint32_t)a, BENCH_PIXELS_TEST);
+		}
+	}
+}
+
+
+// Gradient faded over checker pattern line by line
+static void benchPixelBlend(void) {
+	uint16_t *gradient = benchLine + ST7789_LCD_WIDTH * 2;
+	st7789_SetWindow(&display, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		uint16_t *line = benchLine + (y & 1) * ST7789_LCD_WIDTH;
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			gradient[x] = benchGradient(x, y);
+		}
+		st7789_WaitForDMA(&display);
+		st7789_PixelFill(line, ((y / 16) & 1) ? 0xffff : 0x0000, ST7789_LCD_WIDTH);
+		st7789_PixelBlend(line, gradient, (uint8_t)(y * ST7789_ALPHA_MAX / ST7789_LCD_HEIGHT), ST7789_LCD_WIDTH);
+		st7789_WritePixels(&display, line, ST7789_LCD_WIDTH);
+	}
+	st7789_WaitForDMA(&display);
+}
+
+
+#define BENCH_RENDER_BAND 4
+
+
+static st7789_RenderStats benchRenderStats;
+
+
+// CPU work in small slices, DMA interrupts are dispatched between them like
+// they would preempt real computation
+static void benchCompute(uint64_t cycles) {
+	while (cycles > 0) {
+		uint64_t slice = (cycles < 256) ? cycles : 256;
+		emu_Delay(slice);
+		cycles -= slice;
+	}
+}
+
+
+// Bursty compute: every fourth band costs 2.5 times its wire time, others
+// 0.3 times, average is below wire time
+static void benchRenderBand(void *context, uint16_t *pixels, const st7789_Rect *band) {
+	(void)context;
+	uint64_t wire = (uint64_t)band->width * band->height * 2 * ST7789_PRESCALER;
+	benchCompute(((band->y / BENCH_RENDER_BAND) % 4 == 0) ? wire * 5 / 2 : wire * 3 / 10);
+	for (uint16_t y = 0; y < band->height; ++y) {
+		for (uint16_t x = 0; x < band->width; ++x) {
+			*pixels++ = benchGradient(band->x + x, band->y + y);
+		}
+	}
+}
+
+
+static void benchRenderDepth(uint8_t depth) {
+	static uint16_t buffers[ST7789_RENDER_MAX_DEPTH * ST7789_LCD_WIDTH * BENCH_RENDER_BAND];
+	st7789_Rect window = {0, 0, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT};
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_VsyncInit(&display, &displayVsync, EXTI_IMR_MR0, EXTI0_IRQn);
+	st7789_RenderWindow(&display, &window, BENCH_RENDER_BAND, buffers, depth, benchRenderBand, NULL, &benchRenderStats);
+}
+
+
+static void benchRenderDepth1(void) {
+	benchRenderDepth(1);
+}
+
+
+static void benchRenderDepth2(void) {
+	benchRenderDepth(2);
+}
+
+
+static void benchRenderDepth6(void) {
+	benchRenderDepth(6);
+}
+
+
+static void benchRenderReport(void) {
+	printf(
+		"  render: %u bands in %u us, stalled on dma %u us, on compute %u us\n",
+		(unsigned)benchRenderStats.bands,
+		(unsigned)(benchRenderStats.ticks / EMU_CPU_MHZ),
+		(unsigned)(benchRenderStats.dmaStallTicks / EMU_CPU_MHZ),
+		(unsigned)(benchRenderStats.computeStallTicks / EMU_CPU_MHZ)
+	);
+}
+
+
+#define BENCH_READ_BAND 8
+
+
+static uint16_t benchReadBuffer[ST7789_READ_BUFFER_WORDS(ST7789_LCD_WIDTH * BENCH_READ_BAND)];
+static uint32_t benchReadPixels;
+static uint32_t benchReadMismatches;
+static const st7789_Rect benchOverlay = {20, 176, 200, 40};
+
+
+// Gradient frame on panel, readback compares with benchGradient
+static void benchReadSetup(void) {
+	benchStreamFrame();
+	benchReadPixels = 0;
+	benchReadMismatches = 0;
+}
+
+
+static void benchReadWindow(void) {
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; y += BENCH_READ_BAND) {
+		st7789_Rect band = {0, y, ST7789_LCD_WIDTH, BENCH_READ_BAND};
+		st7789_ReadWindow(&display, &band, benchReadBuffer);
+		for (uint32_t i = 0; i < ST7789_LCD_WIDTH * BENCH_READ_BAND; ++i) {
+			if (benchReadBuffer[i] != benchGradient(i % ST7789_LCD_WIDTH, y + i / ST7789_LCD_WIDTH)) {
+				benchReadMismatches++;
+			}
+		}
+		benchReadPixels += ST7789_LCD_WIDTH * BENCH_READ_BAND;
+	}
+	if (st7789_ReadPixel(&display, 17, 233) != benchGradient(17, 233)) {
+		benchReadMismatches++;
+	}
+	benchReadPixels++;
+}
+
+
+// 50 % black, translucent caption bar
+static void benchOverlayBand(void *context, uint16_t *pixels, const st7789_Rect *band) {
+	(void)context;
+	for (uint32_t i = 0; i < (uint32_t)band->width * band->height; ++i) {
+		pixels[i] = (pixels[i] >> 1) & 0x7bef;
+	}
+	benchReadPixels += (uint32_t)band->width * band->height;
+}
+
+
+static void benchModifyOverlay(void) {
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_ModifyWindow(&display, &benchOverlay, BENCH_READ_BAND, benchReadBuffer, benchOverlayBand, NULL);
+}
+
+
+static void benchReadReport(void) {
+	if (benchReadMismatches > 0) {
+		exitCode = 1;
+	}
+	printf(
+		"  readback: %u pixels, %u read from panel, %u mismatches\n",
+		(unsigned)benchReadPixels,
+		(unsigned)emu_GetPanel()->pixelsRead,
+		(unsigned)benchReadMismatches
+	);
+}
+
+
+// Panel has to show darkened gradient inside the bar only
+static void benchOverlayReport(void) {
+	const panel_Panel *panel = emu_GetPanel();
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			bool inside = x >= benchOverlay.x && x < benchOverlay.x + benchOverlay.width && y >= benchOverlay.y && y < benchOverlay.y + benchOverlay.height;
+			uint16_t expected = benchGradient(x, y);
+			if (inside) {
+				expected = (expected >> 1) & 0x7bef;
+			}
+			if (panel_GetPixel(panel, x, y) != expected) {
+				benchReadMismatches++;
+			}
+		}
+	}
+	benchReadReport();
+}
+
+
+static st7789_Gamma benchGammaTable;
+static uint32_t benchGammaMismatches;
+
+
+// Warm white point, red and blue follow different curves
+static void benchGammaSetup(void) {
+	benchGammaTable = st7789_Gamma_1_3_LCD;
+	benchGammaTable.curve = ST7789_GAMMA_CURVE_2_5;
+	benchGammaTable.digital = true;
+	for (uint8_t level = 0; level < ST7789_GAMMA_LUT_SIZE; ++level) {
+		benchGammaTable.red[level] = (uint8_t)(level * level / (ST7789_GAMMA_LUT_SIZE - 1));
+		benchGammaTable.blue[level] = (uint8_t)(level * 3 / 4);
+	}
+	benchGammaMismatches = 0;
+}
+
+
+static void benchGammaUpload(void) {
+	st7789_SetGamma(&display, &benchGammaTable);
+}
+
+
+static uint32_t benchGammaCompare(const uint8_t *expected, const uint8_t *actual, uint8_t size) {
+	uint32_t mismatches = 0;
+	for (uint8_t i = 0; i < size; ++i) {
+		if (expected[i] != actual[i]) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+
+// Panel registers have to hold uploaded table, default table is restored
+// so that later png output is not remapped
+static void benchGammaReport(void) {
+	const panel_Panel *panel = emu_GetPanel();
+	bool digital = panel->digitalGamma;
+	benchGammaMismatches += (panel->gammaCurve != benchGammaTable.curve) + !digital;
+	benchGammaMismatches += benchGammaCompare(benchGammaTable.positive, panel->gammaCurves[0], ST7789_GAMMA_CURVE_SIZE);
+	benchGammaMismatches += benchGammaCompare(benchGammaTable.negative, panel->gammaCurves[1], ST7789_GAMMA_CURVE_SIZE);
+	benchGammaMismatches += benchGammaCompare(benchGammaTable.red, panel->gammaLut[0], ST7789_GAMMA_LUT_SIZE);
+	benchGammaMismatches += benchGammaCompare(benchGammaTable.blue, panel->gammaLut[1], ST7789_GAMMA_LUT_SIZE);
+	st7789_SetGamma(&display, &st7789_Gamma_1_3_LCD);
+	benchGammaMismatches += (panel->gammaCurve != ST7789_GAMMA_CURVE_2_2) + panel->digitalGamma;
+	if (benchGammaMismatches > 0) {
+		exitCode = 1;
+	}
+	printf(
+		"  gamma: curve %02x, digital %s, %u mismatches\n",
+		(unsigned)benchGammaTable.curve,
+		digital ? "on" : "off",
+		(unsigned)benchGammaMismatches
+	);
+}
+
+
+#define BENCH_ORIENTATIONS 5
+#define BENCH_ROTATE_SCROLL 17
+
+static const st7789_Config rotatedConfig = {ST7789_SPI1_DMA, EMU_PANEL1_DC_PORT, EMU_PANEL1_DC_PIN, EMU_PANEL1_RST_PORT, EMU_PANEL1_RST_PIN, ST7789_GEOMETRY_135X240, ST7789_ORIENTATION_0};
+static const uint8_t benchOrientations[BENCH_ORIENTATIONS] = {
+	ST7789_ORIENTATION_0,
+	ST7789_ORIENTATION_90,
+	ST7789_ORIENTATION_180,
+	ST7789_ORIENTATION_270,
+	ST7789_ORIENTATION_0 | ST7789_MADCTL_MX,
+};
+static const st7789_Rect benchRotateRect = {3, 5, 10, 6};
+static uint32_t benchRotatePixels;
+static uint32_t benchRotateMismatches;
+
+
+// Logical content, row and column fit to byte on 135x240 panel
+static uint16_t benchRotatePattern(uint16_t x, uint16_t y) {
+	const st7789_Rect *rect = &benchRotateRect;
+	if (x >= rect->x && x < rect->x + rect->width && y >= rect->y && y < rect->y + rect->height) {
+		return 0xffff;
+	}
+	return (uint16_t)((y << 8) | x);
+}
+
+
+// Glass pixel which has to show logical (x, y)
+static uint16_t benchRotateGlass(uint8_t madctl, uint16_t x, uint16_t y) {
+	const panel_Panel *panel = emu_GetPanel();
+	uint16_t width = panel->geometry.width;
+	uint16_t height = panel->geometry.height;
+	switch (madctl) {
+		case ST7789_ORIENTATION_90:
+			return panel_GetPixel(panel, width - 1 - y, x);
+		case ST7789_ORIENTATION_180:
+			return panel_GetPixel(panel, width - 1 - x, height - 1 - y);
+		case ST7789_ORIENTATION_270:
+			return panel_GetPixel(panel, y, height - 1 - x);
+		case ST7789_ORIENTATION_0 | ST7789_MADCTL_MX:
+			return panel_GetPixel(panel, width - 1 - x, y);
+		default:
+			return panel_GetPixel(panel, x, y);
+	}
+}
+
+
+// Display row y shows content row y + scroll
+static void benchRotateCompare(uint8_t madctl, uint16_t scroll) {
+	for (uint16_t y = 0; y < display.height; ++y) {
+		for (uint16_t x = 0; x < display.width; ++x) {
+			if (benchRotateGlass(madctl, x, y) != benchRotatePattern(x, (y + scroll) % display.height)) {
+				benchRotateMismatches++;
+			}
+		}
+	}
+	benchRotatePixels += (uint32_t)display.width * display.height;
+}
+
+
+// Glass of 135x240 module sits inside frame memory at column 52, row 40
+static void benchRotateSetup(void) {
+	panel_PowerOn(emu_GetPanel(), &panel_Geometry135x240);
+	st7789_DeviceInit(&display, &rotatedConfig);
+	benchInit();
+	benchRotatePixels = 0;
+	benchRotateMismatches = 0;
+}
+
+
+// Same drawing code in every orientation, panel does the rotation
+static void benchRotate(void) {
+	for (uint8_t i = 0; i < BENCH_ORIENTATIONS; ++i) {
+		uint8_t madctl = benchOrientations[i];
+		st7789_SetOrientation(&display, madctl);
+		st7789_SetWindow(&display, 0, 0, display.width - 1, display.height - 1);
+		for (uint16_t y = 0; y < display.height; ++y) {
+			uint16_t *buf = benchLine + (y & 1) * ST7789_LCD_WIDTH;
+			for (uint16_t x = 0; x < display.width; ++x) {
+				buf[x] = (uint16_t)((y << 8) | x);
+			}
+			st7789_WritePixels(&display, buf, display.width);
+		}
+		st7789_WaitForDMA(&display);
+		st7789_FillArea(&display, 0xffff, benchRotateRect.x, benchRotateRect.y, benchRotateRect.width, benchRotateRect.height);
+		uint16_t corner = st7789_ReadPixel(&display, display.width - 1, display.height - 1);
+		if (corner != benchRotatePattern(display.width - 1, display.height - 1)) {
+			benchRotateMismatches++;
+		}
+		benchRotateCompare(madctl, 0);
+		if (!(madctl & ST7789_MADCTL_MV)) {
+			st7789_SetScrollArea(&display, 0, 0);
+			st7789_SetScroll(&display, BENCH_ROTATE_SCROLL);
+			benchRotateCompare(madctl, BENCH_ROTATE_SCROLL);
+		}
+	}
+}
+
+
+static void benchRotateReport(void) {
+	if (benchRotateMismatches > 0) {
+		exitCode = 1;
+	}
+	printf(
+		"  orientation: %u orientations of 135x240, %u pixels checked, %u mismatches\n",
+		(unsigned)BENCH_ORIENTATIONS,
+		(unsigned)benchRotatePixels,
+		(unsigned)benchRotateMismatches
+	);
+}
+
+
+#define BENCH_POWER_FRAMES 1400
+#define BENCH_POWER_DRAWS 3
+
+static const st7789_PowerConfig benchPowerConfig = {30, 120, 600, ST7789_POWER_RTN_39HZ, 3};
+static const uint16_t benchPowerDraws[BENCH_POWER_DRAWS] = {200, 500, 1300}; // Frames with drawing
+static const char *const benchPowerNames[ST7789_POWER_MODES] = {"full", "slow", "idle", "sleep"};
+static st7789_Power benchPower;
+static uint32_t benchPowerMismatches;
+
+
+static void benchPowerSetup(void) {
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_PowerInit(&display, &benchPower, &benchPowerConfig);
+	st7789_PowerSetPartial(&display, 200, 40);
+	benchPowerMismatches = 0;
+}
+
+
+// Mode expected after frames without drawing, independent of governor
+static st7789_PowerMode benchPowerExpected(uint32_t quiet) {
+	if (quiet >= benchPowerConfig.sleepFrames) {
+		return ST7789_POWER_SLEEP;
+	}
+	if (quiet >= benchPowerConfig.idleFrames) {
+		return ST7789_POWER_IDLE;
+	}
+	if (quiet >= benchPowerConfig.slowFrames) {
+		return ST7789_POWER_SLOW;
+	}
+	return ST7789_POWER_FULL;
+}
+
+
+// Governor mode and panel registers have to match expected mode, sleep
+// keeps state of idle mode
+static void benchPowerCheck(st7789_PowerMode expected) {
+	const panel_Panel *panel = emu_GetPanel();
+	bool sleeping = expected == ST7789_POWER_SLEEP;
+	bool idle = expected == ST7789_POWER_IDLE || sleeping;
+	uint8_t rate = (expected == ST7789_POWER_FULL) ? ST7789_POWER_RTN_60HZ : benchPowerConfig.slowRtn;
+	if (st7789_PowerGetMode(&display) != expected) {
+		benchPowerMismatches++;
+	}
+	if (panel->sleeping != sleeping || panel->idle != idle || panel->partial != idle || panel->frameRate != rate) {
+		benchPowerMismatches++;
+	}
+}
+
+
+// Clock face redrawn three times, queued drawing wakes panel as well
+static void benchPowerGovernor(void) {
+	uint16_t lastDraw = 0;
+	uint8_t draw = 0;
+	for (uint16_t frame = 1; frame <= BENCH_POWER_FRAMES; ++frame) {
+		emu_Delay(ST7789_VSYNC_FRAME_TICKS);
+		if (draw < BENCH_POWER_DRAWS && frame == benchPowerDraws[draw]) {
+			if (draw & 1) {
+				st7789_QueueWindow(&display, 200, 210, 219, 229);
+				st7789_QueueFill(&display, 0x07e0, 400, NULL, NULL);
+			}
+			else {
+				st7789_FillArea(&display, 0xf800, 200, 210, 20, 20);
+			}
+			benchPowerCheck(ST7789_POWER_FULL);
+			st7789_QueueFlush(&display);
+			lastDraw = frame;
+			draw++;
+		}
+		st7789_PowerFrame(&display);
+		benchPowerCheck(benchPowerExpected(frame - lastDraw));
+	}
+}
+
+
+static void benchPowerReport(void) {
+	const st7789_PowerStats *stats = st7789_PowerGetStats(&display);
+	uint64_t energy = 0;
+	uint64_t ticks = 0;
+	const panel_Panel *panel = emu_GetPanel();
+	if (panel->partialStart != 200 || panel->partialEnd != 239) {
+		benchPowerMismatches++;
+	}
+	if (benchPowerMismatches > 0 || stats->wakeups != BENCH_POWER_DRAWS) {
+		exitCode = 1;
+	}
+	for (uint8_t mode = 0; mode < ST7789_POWER_MODES; ++mode) {
+		printf(
+			"  power %-5s: %4u frames, %5u ms, %5u uW, %6u uJ\n",
+			benchPowerNames[mode],
+			(unsigned)stats->frames[mode],
+			(unsigned)(stats->ticks[mode] / ST7789_TICKS_PER_MS),
+			(unsigned)st7789_PowerEstimate(&display, (st7789_PowerMode)mode),
+			(unsigned)(stats->energy[mode] / 1000)
+		);
+		energy += stats->energy[mode];
+		ticks += stats->ticks[mode];
+	}
+	uint64_t full = (uint64_t)st7789_PowerEstimate(&display, ST7789_POWER_FULL) * ticks / ST7789_TICKS_PER_MS;
+	printf(
+		"  power: %u uJ (%u uJ at full rate), %u wakeups, %u mismatches\n",
+		(unsigned)(energy / 1000),
+		(unsigned)(full / 1000),
+		(unsigned)stats->wakeups,
+		(unsigned)benchPowerMismatches
+	);
+}
+
+
+// Compile time specialised driver on wiring of displayConfig, scenarios
+// repeat C driver ones and have to end with same checksum
+typedef st7789::St7789<
+	st7789::Spi<1>,
+	st7789::DmaChannel<3>,
+	st7789::Pin<st7789::PortA, 8>,
+	st7789::Pin<st7789::PortA, 9>,
+	st7789::Geometry<ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0>,
+	ST7789_PIXEL_FORMAT_RGB565
+> benchStatic;
+typedef st7789::St7789<
+	st7789::Spi<1>,
+	st7789::DmaChannel<3>,
+	st7789::Pin<st7789::PortA, 8>,
+	st7789::Pin<st7789::PortA, 9>,
+	st7789::Geometry<ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0>,
+	ST7789_PIXEL_FORMAT_RGB444
+> benchStatic444;
+
+
+static void benchStaticSetup(void) {
+	benchStatic::Configure();
+}
+
+
+static void benchStaticInit(void) {
+	benchStatic::Init();
+}
+
+
+static void benchStaticPixel(void) {
+	static uint16_t color;
+	for (uint16_t i = 0; i < 64; ++i) {
+		color = st7789_RGBToColor(255, (uint8_t)(i * 4), 0);
+		benchStatic::SetWindow(i, i, i, i);
+		benchStatic::WritePixels(&color, 1);
+		benchStatic::WaitForDMA();
+	}
+}
+
+
+static void benchStaticFillGlyph(void) {
+	for (uint16_t i = 0; i < 16; ++i) {
+		benchStatic::Fill(st7789_RGBToColor(0, 255, 0), (uint16_t)(i * 8), 16, 8, 14);
+	}
+}
+
+
+static void benchStaticFillRect(void) {
+	benchStatic::Fill(st7789_RGBToColor(0, 0, 255), 20, 40, 100, 60);
+}
+
+
+static void benchStaticClear(void) {
+	benchStatic::Clear(st7789_RGBToColor(255, 255, 255));
+}
+
+
+static void benchStaticStreamLines(void) {
+	benchStatic::SetWindow(0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buf = benchLine + (line & 1) * ST7789_LCD_WIDTH;
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buf[column] = benchGradient(column, line);
+		}
+		benchStatic::WritePixels(buf, ST7789_LCD_WIDTH);
+	}
+	benchStatic::WaitForDMA();
+}
+
+
+static void benchStatic444Setup(void) {
+	st7789_SetPixelFormat(&display, ST7789_PIXEL_FORMAT_RGB444, benchPack, sizeof(benchPack));
+	benchStatic444::Configure();
+}
+
+
+static void benchStaticStreamFrame444(void) {
+	benchStatic444::SetWindow(0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	for (uint16_t line = 0; line < ST7789_LCD_HEIGHT; ++line) {
+		uint16_t *buf = benchLine + (line & 1) * ST7789_LCD_WIDTH;
+		for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+			buf[column] = benchGradient(column, line);
+		}
+		benchStatic444::WritePixels(buf, ST7789_LCD_WIDTH);
+	}
+	benchStatic444::WaitForDMA();
+}
+
+
+#define BENCH_STATIC_BAND_ROWS (BENCH_QUEUE_LINES / 2)
+
+
+// Bands continue with RAMWRC only, next band is rendered while previous one
+// is sent
+static void benchStaticBands(void) {
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; y += BENCH_STATIC_BAND_ROWS) {
+		uint16_t *buf = benchLine + ((y / BENCH_STATIC_BAND_ROWS) & 1) * ST7789_LCD_WIDTH * BENCH_STATIC_BAND_ROWS;
+		for (uint16_t row = 0; row < BENCH_STATIC_BAND_ROWS; ++row) {
+			for (uint16_t column = 0; column < ST7789_LCD_WIDTH; ++column) {
+				buf[row * ST7789_LCD_WIDTH + column] = benchGradient(column, y + row);
+			}
+		}
+		st7789_Rect band = {0, y, ST7789_LCD_WIDTH, BENCH_STATIC_BAND_ROWS};
+		benchStatic::WriteBand(band, buf);
+	}
+	benchStatic::WaitForDMA();
+}
+
+
+#define BENCH_MANDELBROT_TILE_WIDTH 24
+#define BENCH_MANDELBROT_TILE_HEIGHT 20
+#define BENCH_MANDELBROT_FAST_CYCLES 12    // Estimated M3 cycles per int iteration
+#define BENCH_MANDELBROT_PRECISE_CYCLES 40 // Same for int64_t iteration
+
+
+typedef struct bench_MandelbrotTotals {
+	uint32_t frames;
+	uint32_t pixels;
+	uint32_t referenceIterations;
+	uint32_t mismatches;
+} bench_MandelbrotTotals;
+
+
+static mandelbrotEngine benchMandelbrotEngine;
+static bench_MandelbrotTotals benchMandelbrotTotals;
+static st7789_RenderStats benchMandelbrotStats;
+
+
+// Engine counts are compared with iteration of every pixel, only engine
+// iterations are charged as compute time
+static void benchMandelbrotBand(void *context, uint16_t *pixels, const st7789_Rect *band) {
+	(void)context;
+	static uint16_t reference[BENCH_MANDELBROT_TILE_WIDTH * BENCH_MANDELBROT_TILE_HEIGHT];
+	const mandelbrotView *view = &benchMandelbrotEngine.view;
+	uint32_t iterations = benchMandelbrotEngine.stats.iterations;
+	mandelbrotRender(&benchMandelbrotEngine, band, pixels);
+	iterations = benchMandelbrotEngine.stats.iterations - iterations;
+	benchCompute((uint64_t)iterations * (view->fast ? BENCH_MANDELBROT_FAST_CYCLES : BENCH_MANDELBROT_PRECISE_CYCLES));
+
+	mandelbrotReference(view, band, reference);
+	for (uint32_t i = 0; i < (uint32_t)band->width * band->height; ++i) {
+		benchMandelbrotTotals.referenceIterations += reference[i];
+		if (pixels[i] != reference[i]) {
+			if (benchMandelbrotTotals.mismatches == 0) {
+				fprintf(stderr, "mandelbrot_zoom: frame %u pixel %u,%u count %u, reference %u\n", (unsigned)benchMandelbrotTotals.frames, (unsigned)(band->x + i % band->width), (unsigned)(band->y + i / band->width), (unsigned)pixels[i], (unsigned)reference[i]);
+			}
+			benchMandelbrotTotals.mismatches++;
+			exitCode = 1;
+		}
+		pixels[i] = (pixels[i] == view->maxiter) ? 0 : benchGradient(pixels[i] * 4, pixels[i] * 8);
+	}
+	benchMandelbrotTotals.pixels += (uint32_t)band->width * band->height;
+}
+
+
+// Zoom sequence of speed demo in columns of tiles like the demo renders it
+static void benchMandelbrotZoom(void) {
+	static uint16_t buffers[2 * BENCH_MANDELBROT_TILE_WIDTH * BENCH_MANDELBROT_TILE_HEIGHT];
+	mandelbrotView view;
+	st7789_QueueInit(&display, &displayQueue);
+	mandelbrotInit(&benchMandelbrotEngine);
+	benchMandelbrotTotals = (bench_MandelbrotTotals){0, 0, 0, 0};
+	benchMandelbrotStats = (st7789_RenderStats){0, 0, 0, 0};
+	for (uint8_t frame = 0; mandelbrotZoom(frame, &view); ++frame) {
+		mandelbrotBegin(&benchMandelbrotEngine, &view);
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; x += BENCH_MANDELBROT_TILE_WIDTH) {
+			st7789_Rect window = {x, 0, BENCH_MANDELBROT_TILE_WIDTH, ST7789_LCD_HEIGHT};
+			st7789_RenderStats column;
+			st7789_RenderWindow(&display, &window, BENCH_MANDELBROT_TILE_HEIGHT, buffers, 2, benchMandelbrotBand, NULL, &column);
+			benchMandelbrotStats.bands += column.bands;
+			benchMandelbrotStats.ticks += column.ticks;
+			benchMandelbrotStats.dmaStallTicks += column.dmaStallTicks;
+			benchMandelbrotStats.computeStallTicks += column.computeStallTicks;
+		}
+		benchMandelbrotTotals.frames++;
+	}
+}
+
+
+static void benchMandelbrotReport(void) {
+	const mandelbrotStats *stats = &benchMandelbrotEngine.stats;
+	printf(
+		"  mandelbrot: %u frames, %u iterations (reference %u), %u mismatches\n",
+		(unsigned)benchMandelbrotTotals.frames,
+		(unsigned)stats->iterations,
+		(unsigned)benchMandelbrotTotals.referenceIterations,
+		(unsigned)benchMandelbrotTotals.mismatches
+	);
+	printf(
+		"  pixels: %u computed, %u filled, %u rejected, %u periodic, %u reused of %u\n",
+		(unsigned)stats->computed,
+		(unsigned)stats->filled,
+		(unsigned)stats->rejected,
+		(unsigned)stats->periodic,
+		(unsigned)stats->reused,
+		(unsigned)benchMandelbrotTotals.pixels
+	);
+	printf(
+		"  render: %u bands in %u us, stalled on dma %u us, on compute %u us\n",
+		(unsigned)benchMandelbrotStats.bands,
+		(unsigned)(benchMandelbrotStats.ticks / EMU_CPU_MHZ),
+		(unsigned)(benchMandelbrotStats.dmaStallTicks / EMU_CPU_MHZ),
+		(unsigned)(benchMandelbrotStats.computeStallTicks / EMU_CPU_MHZ)
+	);
+}
+
+
+// Both panels initialised, same gradient frame is sent to each
+static void benchDualSetup(void) {
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			benchFrame[y * ST7789_LCD_WIDTH + x] = benchGradient(x, y);
+		}
+	}
+	st7789_DeviceInit(&second, &secondConfig);
+	st7789_Reset(&second);
+	st7789_Init_1_3_LCD(&second);
+	st7789_QueueInit(&display, &displayQueue);
+	st7789_QueueInit(&second, &secondQueue);
+}
+
+
+static void benchDualFrame(st7789_Device *device) {
+	st7789_QueueWindow(device, 0, 0, ST7789_LCD_WIDTH - 1, ST7789_LCD_HEIGHT - 1);
+	st7789_QueuePixels(device, benchFrame, sizeof(benchFrame), NULL, NULL);
+}
+
+
+// One panel after other
+static void benchDualSerial(void) {
+	benchDualFrame(&display);
+	st7789_QueueFlush(&display);
+	benchDualFrame(&second);
+	st7789_QueueFlush(&second);
+}
+
+
+// Both DMA channels run at once
+static void benchDualParallel(void) {
+	benchDualFrame(&display);
+	benchDualFrame(&second);
+	st7789_QueueFlush(&display);
+	st7789_QueueFlush(&second);
+}
+
+
+static void benchDualReport(void) {
+	uint32_t first = panel_Checksum(emu_GetPanelAt(0));
+	uint32_t other = panel_Checksum(emu_GetPanelAt(1));
+	printf("  second panel: crc %08x\n", (unsigned)other);
+	if (first != other) {
+		fprintf(stderr, "second panel differs from first\n");
+		exitCode = 1;
+	}
+}
+
+
+#define BENCH_GLYPH_WIDTH 8
+#define BENCH_GLYPH_HEIGHT 14
+#define BENCH_GLYPH_COLUMNS (ST7789_LCD_WIDTH / BENCH_GLYPH_WIDTH)
+#define BENCH_GLYPH_ROWS (ST7789_LCD_HEIGHT / BENCH_GLYPH_HEIGHT)
+#define BENCH_GLYPHS (BENCH_GLYPH_COLUMNS * BENCH_GLYPH_ROWS)
+
+static uint16_t benchGlyph[BENCH_GLYPH_WIDTH * BENCH_GLYPH_HEIGHT];
+static uint64_t benchWindowCycles;
+
+
+// Cell of glyph grid, only st7789_SetWindow is timed
+static void benchGlyphWindow(uint16_t column, uint16_t row) {
+	uint16_t x = column * BENCH_GLYPH_WIDTH;
+	uint16_t y = row * BENCH_GLYPH_HEIGHT;
+	for (uint16_t i = 0; i < BENCH_GLYPH_WIDTH * BENCH_GLYPH_HEIGHT; ++i) {
+		benchGlyph[i] = benchGradient(x + i % BENCH_GLYPH_WIDTH, y + i / BENCH_GLYPH_WIDTH);
+	}
+	emu_Counters before = emu_GetCounters();
+	st7789_SetWindow(&display, x, y, x + BENCH_GLYPH_WIDTH - 1, y + BENCH_GLYPH_HEIGHT - 1);
+	emu_Counters after = emu_GetCounters();
+	benchWindowCycles += after.cycles - before.cycles;
+	st7789_WriteDMA(&display, benchGlyph, sizeof(benchGlyph));
+	st7789_WaitForDMA(&display);
+}
+
+
+// Text order, glyphs of line share rows
+static void benchGlyphRows(void) {
+	benchWindowCycles = 0;
+	for (uint16_t row = 0; row < BENCH_GLYPH_ROWS; ++row) {
+		for (uint16_t column = 0; column < BENCH_GLYPH_COLUMNS; ++column) {
+			benchGlyphWindow(column, row);
+		}
+	}
+}
+
+
+// Column order, each glyph continues rows of previous one
+static void benchGlyphColumns(void) {
+	benchWindowCycles = 0;
+	for (uint16_t column = 0; column < BENCH_GLYPH_COLUMNS; ++column) {
+		for (uint16_t row = 0; row < BENCH_GLYPH_ROWS; ++row) {
+			benchGlyphWindow(column, row);
+		}
+	}
+}
+
+
+static void benchGlyphReport(void) {
+	uint64_t cycles = benchWindowCycles / BENCH_GLYPHS;
+	printf(
+		"  windows: %u cycles per 8x14 window, %u windows/s\n",
+		(unsigned)cycles,
+		(unsigned)(EMU_CPU_MHZ * 1000000ull / cycles)
+	);
+}
+
+
+// Remote display over pseudo terminal: sender thread plays host side of
+// st7789_bridge.h on master end, device side reads slave end in place of
+// UART RX DMA. With -s command the device reads master end and command is
+// started with slave path as last argument. UART time is not emulated,
+// cycles are driver and SPI only.
+
+#define BENCH_BRIDGE_LINES 2
+#define BENCH_BRIDGE_SLOTS 4
+#define BENCH_BRIDGE_SLOT_SIZE ST7789_BRIDGE_SLOT_SIZE(ST7789_LCD_WIDTH * BENCH_BRIDGE_LINES)
+#define BENCH_BRIDGE_BANDS (ST7789_LCD_HEIGHT / BENCH_BRIDGE_LINES)
+#define BENCH_BRIDGE_FRAMES (BENCH_BRIDGE_BANDS + 2) // Bands, command and end
+#define BENCH_BRIDGE_CORRUPT 10                      // Band sent with bad CRC once
+#define BENCH_BRIDGE_TIMEOUT (100 * ST7789_TICKS_PER_MS)
+
+static st7789_Bridge benchBridge;
+static uint8_t benchBridgeSlots[BENCH_BRIDGE_SLOTS * BENCH_BRIDGE_SLOT_SIZE];
+static int benchBridgeMaster = -1;
+static int benchBridgeSlave = -1;
+static int benchBridgeDevice = -1;
+static uint32_t benchBridgeWrite; // Ring position of RX DMA stand-in
+static uint32_t benchBridgeSent;  // Frames written by sender including resends
+static bool benchBridgeFailed;
+
+
+// Sender owes head slot while it is granted, it is read as a whole so the
+// emulated time does not depend on pseudo terminal scheduling
+uint16_t st7789_BridgeRxPosition(st7789_Bridge *bridge) {
+	uint32_t size = (uint32_t)bridge->slotCount * bridge->slotSize;
+	uint32_t start = (uint32_t)bridge->head * bridge->slotSize;
+	if (benchBridgeWrite == size && start != size - bridge->slotSize) {
+		benchBridgeWrite = 0;
+	}
+	while (bridge->credits > 0 && !benchBridgeFailed && benchBridgeWrite < start + bridge->slotSize) {
+		struct pollfd fd = {benchBridgeDevice, POLLIN, 0};
+		ssize_t length = -1;
+		if (poll(&fd, 1, 2000) == 1) {
+			length = read(benchBridgeDevice, bridge->slots + benchBridgeWrite, start + bridge->slotSize - benchBridgeWrite);
+		}
+		if (length <= 0) {
+			fprintf(stderr, "bridge: sender stopped at ring position %u\n", (unsigned)benchBridgeWrite);
+			benchBridgeFailed = true;
+			exitCode = 1;
+			break;
+		}
+		benchBridgeWrite += (uint32_t)length;
+	}
+	return (uint16_t)(benchBridgeWrite % size);
+}
+
+
+void st7789_BridgeTransmit(st7789_Bridge *bridge, uint8_t reply) {
+	(void)bridge;
+	if (reply & ST7789_BRIDGE_NAK) {
+		benchBridgeWrite = 0; // Ring restarted
+	}
+	if (write(benchBridgeDevice, &reply, 1) != 1) {
+		benchBridgeFailed = true;
+	}
+}
+
+
+static void benchBridgeEncode(uint8_t *frame, uint32_t index) {
+	uint16_t header[6] = {0, 0, 0, 0, 0, 0}; // x, y, width, height, length, crc
+	memset(frame, 0, BENCH_BRIDGE_SLOT_SIZE);
+	frame[0] = ST7789_BRIDGE_MAGIC;
+	frame[2] = index & ST7789_BRIDGE_SEQUENCE_MASK;
+	if (index < BENCH_BRIDGE_BANDS) {
+		frame[1] = ST7789_BRIDGE_PIXELS;
+		header[1] = (uint16_t)(index * BENCH_BRIDGE_LINES);
+		header[2] = ST7789_LCD_WIDTH;
+		header[3] = BENCH_BRIDGE_LINES;
+		header[4] = ST7789_LCD_WIDTH * BENCH_BRIDGE_LINES * 2;
+		memcpy(frame + ST7789_BRIDGE_HEADER_SIZE, benchFrame + header[1] * ST7789_LCD_WIDTH, header[4]);
+	}
+	else if (index == BENCH_BRIDGE_BANDS) {
+		frame[1] = ST7789_BRIDGE_COMMAND;
+		frame[ST7789_BRIDGE_HEADER_SIZE] = ST7789_CMD_DISPON;
+		header[4] = 1;
+	}
+	else {
+		frame[1] = ST7789_BRIDGE_END;
+	}
+	for (int field = 0; field < 5; ++field) {
+		frame[4 + field * 2] = (uint8_t)(header[field] & 0xff);
+		frame[5 + field * 2] = (uint8_t)(header[field] >> 8);
+	}
+	uint16_t crc = st7789_BridgeCrc(ST7789_BRIDGE_CRC_INIT, frame, 14);
+	crc = st7789_BridgeCrc(crc, frame + ST7789_BRIDGE_HEADER_SIZE, header[4]);
+	frame[14] = (uint8_t)(crc & 0xff);
+	frame[15] = (uint8_t)(crc >> 8);
+}
+
+
+// Host side: waits for NAK of Start, sends frame per credit, goes back after
+// NAK and stops once reply acknowledges end frame
+static void *benchBridgeSender(void *arg) {
+	(void)arg;
+	static uint8_t frame[BENCH_BRIDGE_SLOT_SIZE];
+	uint32_t next = 0;
+	uint32_t credits = 0;
+	bool synced = false;
+	bool corrupted = false;
+	for (;;) {
+		while (synced && credits > 0 && next < BENCH_BRIDGE_FRAMES) {
+			benchBridgeEncode(frame, next);
+			if (next == BENCH_BRIDGE_CORRUPT && !corrupted) {
+				frame[ST7789_BRIDGE_HEADER_SIZE] ^= 0xff;
+				corrupted = true;
+			}
+			for (size_t offset = 0; offset < sizeof(frame);) {
+				ssize_t length = write(benchBridgeMaster, frame + offset, sizeof(frame) - offset);
+				if (length <= 0) {
+					return NULL;
+				}
+				offset += (size_t)length;
+			}
+			++next;
+			--credits;
+			++benchBridgeSent;
+		}
+		uint8_t reply;
+		if (read(benchBridgeMaster, &reply, 1) != 1) {
+			return NULL;
+		}
+		uint8_t sequence = reply & ST7789_BRIDGE_SEQUENCE_MASK;
+		if (reply & ST7789_BRIDGE_NAK) {
+			synced = true;
+			credits = 0;
+			next -= (next - sequence) & ST7789_BRIDGE_SEQUENCE_MASK;
+		}
+		else if (synced) {
+			++credits;
+			if (next == BENCH_BRIDGE_FRAMES && sequence == (BENCH_BRIDGE_FRAMES & ST7789_BRIDGE_SEQUENCE_MASK)) {
+				return NULL;
+			}
+		}
+	}
+}
+
+
+static void benchBridgeSetup(void) {
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			benchFrame[y * ST7789_LCD_WIDTH + x] = benchGradient(x, y);
+		}
+	}
+	st7789_QueueInit(&display, &displayQueue);
+	benchBridgeWrite = 0;
+	benchBridgeSent = 0;
+	benchBridgeFailed = false;
+	benchBridgeMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if (benchBridgeMaster < 0 || grantpt(benchBridgeMaster) != 0 || unlockpt(benchBridgeMaster) != 0) {
+		perror("posix_openpt");
+		exit(1);
+	}
+	benchBridgeSlave = open(ptsname(benchBridgeMaster), O_RDWR | O_NOCTTY);
+	if (benchBridgeSlave < 0) {
+		perror("open pty");
+		exit(1);
+	}
+	// Binary link, no echo or line editing
+	struct termios tio;
+	tcgetattr(benchBridgeSlave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(benchBridgeSlave, TCSANOW, &tio);
+	benchBridgeDevice = (bridgeSender != NULL) ? benchBridgeMaster : benchBridgeSlave;
+	st7789_BridgeInit(&benchBridge, USART2, DMA1_Channel6, benchBridgeSlots, BENCH_BRIDGE_SLOTS, BENCH_BRIDGE_SLOT_SIZE);
+}
+
+
+static void benchBridgeStream(void) {
+	pthread_t sender;
+	pid_t senderPid = -1;
+	if (bridgeSender != NULL) {
+		char command[512];
+		snprintf(command, sizeof(command), "%s %s", bridgeSender, ptsname(benchBridgeMaster));
+		char *argv[] = {(char *)"sh", (char *)"-c", command, NULL};
+		if (posix_spawn(&senderPid, "/bin/sh", NULL, NULL, argv, environ) != 0) {
+			perror("posix_spawn");
+			exit(1);
+		}
+	}
+	else if (pthread_create(&sender, NULL, benchBridgeSender, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+	st7789_BridgeStart(&benchBridge);
+	uint32_t last = st7789_Ticks();
+	while (!benchBridgeFailed) {
+		st7789_BridgeStatus status = st7789_BridgePoll(&display, &benchBridge);
+		if (status == ST7789_BRIDGE_DONE) {
+			break;
+		}
+		if (status == ST7789_BRIDGE_FRAME) {
+			last = st7789_Ticks();
+		}
+		else if (st7789_Ticks() - last > BENCH_BRIDGE_TIMEOUT) {
+			fprintf(stderr, "bridge: no frame received\n");
+			exitCode = 1;
+			break;
+		}
+	}
+	st7789_BridgeStop(&benchBridge);
+	if (benchBridgeFailed) {
+		// Sender waiting for reply gets hangup
+		close(benchBridgeDevice);
+	}
+	if (senderPid > 0) {
+		int status;
+		waitpid(senderPid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "bridge: sender failed\n");
+			exitCode = 1;
+		}
+	}
+	else {
+		pthread_join(sender, NULL);
+	}
+	if (!benchBridgeFailed) {
+		close(benchBridgeDevice);
+	}
+	close((benchBridgeDevice == benchBridgeMaster) ? benchBridgeSlave : benchBridgeMaster);
+}
+
+
+static void benchBridgeReport(void) {
+	const panel_Panel *panel = emu_GetPanel();
+	uint32_t mismatches = 0;
+	for (uint16_t y = 0; y < ST7789_LCD_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ST7789_LCD_WIDTH; ++x) {
+			if (panel_GetPixel(panel, x, y) != benchFrame[y * ST7789_LCD_WIDTH + x]) {
+				++mismatches;
+			}
+		}
+	}
+	printf(
+		"  bridge: %u frames accepted, %u sent by bench, %u skipped, %u resyncs, %u byte slots\n",
+		(unsigned)benchBridge.stats.frames,
+		(unsigned)benchBridgeSent,
+		(unsigned)benchBridge.stats.skipped,
+		(unsigned)benchBridge.stats.resyncs,
+		(unsigned)BENCH_BRIDGE_SLOT_SIZE
+	);
+	if (mismatches > 0) {
+		fprintf(stderr, "bridge: %u pixels differ from sent frame\n", (unsigned)mismatches);
+		exitCode = 1;
+	}
+}
+
+
+#ifdef ST7789_STATS
+
+#define BENCH_STATS_FRAMES 4
+
+static st7789_Stats benchStats;
+
+
+// Display list and band renderer frames alternate
+static void benchStatsFrames(void) {
+	st7789_StatsInit(&display, &benchStats);
+	for (uint16_t frame = 0; frame < BENCH_STATS_FRAMES; ++frame) {
+		st7789_StatsFrameBegin(&display);
+		if (frame & 1) {
+			benchRenderDepth(2);
+		}
+		else {
+			benchDisplayList();
+		}
+		st7789_StatsFrameEnd(&display);
+	}
+}
+
+
+static void benchStatsReport(void) {
+	const st7789_Stats *stats = st7789_StatsGet(&display);
+	printf(
+		"  stats: %u frames %u..%u us, dma %u bytes in last frame\n",
+		stats->frames,
+		stats->frameMin / EMU_CPU_MHZ,
+		stats->frameMax / EMU_CPU_MHZ,
+		stats->dmaBytes
+	);
+	for (int stage = 0; stage < ST7789_STATS_STAGES; ++stage) {
+		const st7789_StatsCounter *counter = &stats->stages[stage];
+		printf(
+			"  stats: %-8s %6u..%6u us per frame, %6u us total, %u events in last frame\n",
+			st7789_StatsStageName((st7789_StatsStage)stage),
+			counter->minTicks / EMU_CPU_MHZ,
+			counter->maxTicks / EMU_CPU_MHZ,
+			(unsigned)(counter->totalTicks / EMU_CPU_MHZ),
+			counter->events
+		);
+	}
+	unsigned binMs = ST7789_STATS_HISTOGRAM_TICKS / (EMU_CPU_MHZ * 1000);
+	for (unsigned bin = 0; bin < ST7789_STATS_HISTOGRAM_BINS; ++bin) {
+		if (stats->histogram[bin] > 0) {
+			printf("  stats: %u frames in %u..%u ms\n", stats->histogram[bin], bin * binMs, (bin + 1) * binMs);
+		}
+	}
+}
+
+#endif
+
+
+static const bench_Scenario scenarios[] = {
+	{"init",          1,                 false, benchInit, NULL, NULL},
+	{"init_async",    1,                 false, benchInitAsync, benchInitReport, NULL},
+	{"set_window",    1,                 true,  benchSetWindow, NULL, NULL},
+	{"write_command", 1,                 true,  benchWriteCommand, NULL, NULL},
+	{"read_id",       1,                 true,  benchReadId, NULL, NULL},
+	{"pixel",         64,                true,  benchPixel, NULL, NULL},
+	{"fill_glyph",    16,                true,  benchFillGlyph, NULL, NULL},
+	{"fill_rect",     1,                 true,  benchFillRect, NULL, NULL},
+	{"clear",         1,                 true,  benchClear, NULL, NULL},
+	{"queue_clear",   1,                 true,  benchQueueClear, NULL, NULL},
+	{"rect_outline",  4,                 true,  benchRectOutline, NULL, NULL},
+	{"fill_rects",    16,                true,  benchFillRects, NULL, NULL},
+	{"stream_lines",  ST7789_LCD_HEIGHT, true,  benchStreamLines, NULL, NULL},
+	{"queue_frame",   1,                 true,  benchQueueFrame, NULL, NULL},
+	{"queue_lines",   ST7789_LCD_HEIGHT, true,  benchQueueLines, NULL, NULL},
+	{"stream_frame",  1,                 true,  benchStreamFrame, NULL, NULL},
+	{"stream_frame_444", 1,              true,  benchStreamFrame444, NULL, NULL},
+	{"fill_switch",   5,                 true,  benchFillSwitch, NULL, NULL},
+	{"queue_clear_444", 1,               true,  benchQueueClear444, NULL, NULL},
+	{"display_list",  1,                 true,  benchDisplayList, NULL, NULL},
+	{"tearing",       4,                 true,  benchTearing, NULL, NULL},
+	{"vsync_frames",  4,                 true,  benchVsyncFrames, benchVsyncReport, NULL},
+	{"vsync_444",     4,                 true,  benchVsync444, benchVsyncReport, NULL},
+	{"damage_widgets", 1,                true,  benchDamageWidgets, NULL, NULL},
+	{"damage_full",   1,                 true,  benchDamageFull, NULL, NULL},
+	{"scroll_row",    1,                 true,  benchScrollRow, NULL, benchConsoleSetup},
+	{"repaint_rows",  1,                 true,  benchRepaintRows, NULL, benchConsoleSetup},
+	{"ugui_text_legacy", 16,             true,  benchUguiTextLegacy, NULL, NULL},
+	{"ugui_text",     16,                true,  benchUguiTextBatched, NULL, NULL},
+	{"ugui_pset_legacy", 1,              true,  benchUguiPsetLegacy, NULL, NULL},
+	{"ugui_pset",     1,                 true,  benchUguiPsetBatched, NULL, NULL},
+	{"ugui_lines_legacy", 16,            true,  benchUguiLinesLegacy, NULL, NULL},
+	{"ugui_lines",    16,                true,  benchUguiLinesBatched, NULL, NULL},
+	{"text_line",     16,                true,  benchTextLine, benchTextReport, benchTextSetup},
+	{"text_screen",   24,                true,  benchTextScreen, benchTextReport, benchTextSetup},
+	{"image_draw",    1,                 true,  benchImageDraw, benchImageReport, benchImageSetup},
+	{"image_stream",  1,                 true,  benchImageStream, NULL, benchImageSetup},
+	{"sprite_list",   1,                 true,  benchSpriteList, benchSpriteReport, benchSpriteSetup},
+	{"sprite_draw",   BENCH_SPRITES,     true,  benchSpriteDraw, NULL, benchSpriteSetup},
+	{"pixel_blend",   ST7789_LCD_HEIGHT, true,  benchPixelBlend, NULL, benchPixelsSetup},
+	{"render_depth1", 1,                 true,  benchRenderDepth1, benchRenderReport, NULL},
+	{"render_depth2", 1,                 true,  benchRenderDepth2, benchRenderReport, NULL},
+	{"render_depth6", 1,                 true,  benchRenderDepth6, benchRenderReport, NULL},
+	{"read_window",   ST7789_LCD_HEIGHT / BENCH_READ_BAND + 1, true, benchReadWindow, benchReadReport, benchReadSetup},
+	{"modify_overlay", 1,                true,  benchModifyOverlay, benchOverlayReport, benchReadSetup},
+	{"gamma_upload",  1,                 true,  benchGammaUpload, benchGammaReport, benchGammaSetup},
+	{"orientation",   BENCH_ORIENTATIONS, false, benchRotate, benchRotateReport, benchRotateSetup},
+	{"power_governor", BENCH_POWER_FRAMES, true, benchPowerGovernor, benchPowerReport, benchPowerSetup},
+	{"static_init",   1,                 false, benchStaticInit, NULL, NULL},
+	{"static_pixel",  64,                true,  benchStaticPixel, NULL, benchStaticSetup},
+	{"static_fill_glyph", 16,            true,  benchStaticFillGlyph, NULL, benchStaticSetup},
+	{"static_fill_rect", 1,              true,  benchStaticFillRect, NULL, benchStaticSetup},
+	{"static_clear",  1,                 true,  benchStaticClear, NULL, benchStaticSetup},
+	{"static_lines",  ST7789_LCD_HEIGHT, true,  benchStaticStreamLines, NULL, benchStaticSetup},
+	{"static_frame_444", 1,              true,  benchStaticStreamFrame444, NULL, benchStatic444Setup},
+	{"static_bands",  ST7789_LCD_HEIGHT / BENCH_STATIC_BAND_ROWS, true, benchStaticBands, NULL, benchStaticSetup},
+	{"mandelbrot_zoom", MANDELBROT_STILL_FRAMES + 25, true, benchMandelbrotZoom, benchMandelbrotReport, NULL},
+	{"dual_serial",   2,                 true,  benchDualSerial, benchDualReport, benchDualSetup},
+	{"dual_parallel", 2,                 true,  benchDualParallel, benchDualReport, benchDualSetup},
+	{"glyph_rows",    BENCH_GLYPHS,      true,  benchGlyphRows, benchGlyphReport, NULL},
+	{"glyph_columns", BENCH_GLYPHS,      true,  benchGlyphColumns, benchGlyphReport, NULL},
+	{"bridge_stream", BENCH_BRIDGE_BANDS, true,  benchBridgeStream, benchBridgeReport, benchBridgeSetup},
+#ifdef ST7789_STATS
+	{"stats_frames",  BENCH_STATS_FRAMES, true, benchStatsFrames, benchStatsReport, NULL},
+#endif
+};
+
+
+
+
+static void benchRunScenario(const bench_Scenario *scenario) {
+	emu_Reset();
+	st7789_DeviceInit(&display, &displayConfig);
+	if (scenario->initialized) {
+		benchInit();
+		emu_Drain();
+	}
+	if (scenario->setup != NULL) {
+		scenario->setup();
+		emu_Drain();
+	}
+	emu_Counters before = emu_GetCounters();
+	uint32_t tears = emu_GetPanel()->tears;
+	scenario->run();
+	emu_Drain();
+	emu_Counters after = emu_GetCounters();
+	emu_Counters cost = emu_CountersDiff(&after, &before);
+	uint32_t n = scenario->calls;
+	panel_Panel *panel = emu_GetPanel();
+
+	printf(
+		"%-16s %6u %8u %6u %6u %6u %6u %8u %6u %10llu %10llu %9llu %4u %4u %08x\n",
+		scenario->name,
+		n,
+		cost.bytes / n,
+		cost.commandBytes / n,
+		cost.readBytes / n,
+		cost.dcToggles / n,
+		cost.dmaKicks / n,
+		cost.spins / n,
+		cost.interrupts / n,
+		(unsigned long long)(cost.sleepCycles / n),
+		(unsigned long long)(cost.cycles / n),
+		(unsigned long long)(cost.cycles / n / EMU_CPU_MHZ),
+		cost.hazards,
+		panel->tears - tears,
+		panel_Checksum(panel)
+	);
+	if (scenario->report != NULL) {
+		scenario->report();
+	}
+
+	if (cost.deadlocks > 0) {
+		fprintf(stderr, "%s: WFI without pending interrupt\n", scenario->name);
+		exitCode = 1;
+	}
+	if (panel->unknownCommands > 0) {
+		fprintf(stderr, "%s: panel received %u unknown commands\n", scenario->name, panel->unknownCommands);
+		exitCode = 1;
+	}
+	if (outputDir != NULL) {
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s.png", outputDir, scenario->name);
+		if (!panel_SavePng(panel, path)) {
+			fprintf(stderr, "Cannot write %s\n", path);
+			exitCode = 1;
+		}
+	}
+}
+
+
+static void *benchMain(void *arg) {
+	const char *filter = (const char *)arg;
+	printf(
+		"%-16s %6s %8s %6s %6s %6s %6s %8s %6s %10s %10s %9s %4s %4s %8s\n",
+		"scenario", "calls", "bytes", "cmd", "read", "dc", "dma", "spins", "irq", "sleep", "cycles", "us", "haz", "tear", "crc"
+	);
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+		if (filter == NULL || strcmp(filter, scenarios[i].name) == 0) {
+			benchRunScenario(&scenarios[i]);
+		}
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+	const char *filter = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			outputDir = argv[++i];
+		}
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			bridgeSender = argv[++i];
+		}
+		else {
+			filter = argv[i];
+		}
+	}
+
+	emu_SetIrqHandler(DMA1_Channel3_IRQn, benchDisplayDMAInterrupt);
+	emu_SetIrqHandler(DMA1_Channel5_IRQn, benchSecondDMAInterrupt);
+	emu_SetIrqHandler(EXTI0_IRQn, benchDisplayTEInterrupt);
+	st7789_UguiSelect(&display);
+
+	// DMA address registers are 32 bit, so buffers handed to the driver must
+	// live in the low 4 GB: the binary is not position independent and the
+	// scenarios run on a stack mapped below 2 GB.
+	void *stack = mmap(NULL, BENCH_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (stack == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	pthread_attr_t attr;
+	pthread_t thread;
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, stack, BENCH_STACK_SIZE);
+	if (pthread_create(&thread, &attr, benchMain, (void *)filter) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+	pthread_join(thread, NULL);
+	return exitCode;
+}
@@ -0,0 +1,777 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcu.h"
+#include "panel.h"
+
+
+SPI_TypeDef emu_SPI1;
+SPI_TypeDef emu_SPI2;
+DMA_TypeDef emu_DMA1;
+DMA_Channel_TypeDef emu_DMA1_Channel[7];
+USART_TypeDef emu_USART1;
+USART_TypeDef emu_USART2;
+GPIO_TypeDef emu_GPIOA;
+GPIO_TypeDef emu_GPIOB;
+EXTI_TypeDef emu_EXTI;
+DWT_Type emu_DWT;
+CoreDebug_Type emu_CoreDebug;
+
+
+typedef struct emu_DmaState {
+	bool active;
+	uint32_t remaining;
+	uint32_t initial;
+	uint32_t position;
+} emu_DmaState;
+
+
+typedef struct emu_Spi {
+	SPI_TypeDef *regs;
+	int txChannel;
+	int rxChannel;
+	GPIO_TypeDef *dcPort;
+	uint32_t dcPin;
+	GPIO_TypeDef *rstPort;
+	uint32_t rstPin;
+	uint32_t teLine;          // EXTI line raised by TE output
+	panel_Panel *panel;
+	uint64_t cursor;          // Time up to which shifting is simulated
+	uint64_t tearingChecked;  // TE edges up to this time are raised
+
+	bool txFull;
+	uint16_t txData;
+	bool shifting;
+	bool shiftIsRead;
+	uint16_t shiftData;
+	uint64_t shiftEnd;
+	bool rxFull;
+	uint16_t rxData;
+	bool dcLevel;
+	bool rstLevel;
+} emu_Spi;
+
+
+#define EMU_EXCEPTION_CYCLES         12   // Interrupt entry and exit latency
+#define EMU_LINE_CYCLES              ((uint64_t)EMU_CPU_MHZ * 1000000 / PANEL_FRAME_RATE / PANEL_SCAN_LINES)
+#define EMU_FRAME_CYCLES             (EMU_LINE_CYCLES * PANEL_SCAN_LINES)
+
+
+static uint64_t now;
+static emu_Counters counters;
+static emu_IrqHandler irqHandlers[EMU_IRQ_COUNT];
+static bool irqEnabled[EMU_IRQ_COUNT];
+static uint32_t primask;
+static bool inInterrupt;
+static emu_DmaState dmaState[7];
+static emu_Spi spis[EMU_PANEL_COUNT];
+static panel_Panel panels[EMU_PANEL_COUNT];
+
+
+static int emu_ChannelIndex(emu_Register *reg, size_t offset) {
+	return (int)(((uint8_t *)reg - offset - (uint8_t *)emu_DMA1_Channel) / sizeof(DMA_Channel_TypeDef));
+}
+
+
+static bool emu_SpiTransmitting(const emu_Spi *spi) {
+	uint32_t cr1 = spi->regs->CR1.value;
+	return !(cr1 & SPI_CR1_BIDIMODE) || (cr1 & SPI_CR1_BIDIOE);
+}
+
+
+static uint32_t emu_SpiFrameCycles(const emu_Spi *spi) {
+	uint32_t cr1 = spi->regs->CR1.value;
+	uint32_t bits = (cr1 & SPI_CR1_DFF) ? 16 : 8;
+	uint32_t divider = 2u << ((cr1 & SPI_CR1_BR) >> 3);
+	return bits * divider;
+}
+
+
+static uint32_t emu_DmaElementSize(uint32_t ccr) {
+	return 1u << ((ccr & DMA_CCR1_MSIZE) >> 10);
+}
+
+
+static void emu_DmaComplete(int channel) {
+	DMA_Channel_TypeDef *regs = &emu_DMA1_Channel[channel];
+	emu_DmaState *state = &dmaState[channel];
+	emu_DMA1.ISR.value |= (0x3u << (channel * 4)); // GIF, TCIF
+	if (regs->CCR.value & DMA_CCR1_CIRC) {
+		state->remaining = state->initial;
+		state->position = 0;
+	}
+}
+
+
+static uint16_t emu_DmaFetch(int channel) {
+	DMA_Channel_TypeDef *regs = &emu_DMA1_Channel[channel];
+	emu_DmaState *state = &dmaState[channel];
+	uint32_t ccr = regs->CCR.value;
+	uint32_t size = emu_DmaElementSize(ccr);
+	const uint8_t *source = (const uint8_t *)(uintptr_t)regs->CMAR.value;
+	uint32_t value = 0;
+	memcpy(&value, source + state->position, size);
+	if (ccr & DMA_CCR1_MINC) {
+		state->position += size;
+	}
+	state->remaining--;
+	if (state->remaining == 0) {
+		emu_DmaComplete(channel);
+	}
+	return (uint16_t)value;
+}
+
+
+static void emu_DmaStore(int channel, uint16_t data) {
+	DMA_Channel_TypeDef *regs = &emu_DMA1_Channel[channel];
+	emu_DmaState *state = &dmaState[channel];
+	uint32_t ccr = regs->CCR.value;
+	uint32_t size = emu_DmaElementSize(ccr);
+	uint8_t *target = (uint8_t *)(uintptr_t)regs->CMAR.value;
+	uint32_t value = data;
+	memcpy(target + state->position, &value, size);
+	if (ccr & DMA_CCR1_MINC) {
+		state->position += size;
+	}
+	state->remaining--;
+	if (state->remaining == 0) {
+		emu_DmaComplete(channel);
+	}
+}
+
+
+static bool emu_DmaRequesting(const emu_Spi *spi, int channel, bool toPeripheral, uint32_t requestBit) {
+	const DMA_Channel_TypeDef *regs = &emu_DMA1_Channel[channel];
+	const emu_DmaState *state = &dmaState[channel];
+	if (!state->active || state->remaining == 0) {
+		return false;
+	}
+	if (!(spi->regs->CR2.value & requestBit)) {
+		return false;
+	}
+	if (((regs->CCR.value & DMA_CCR1_DIR) != 0) != toPeripheral) {
+		return false;
+	}
+	return regs->CPAR.value == (uint32_t)(uintptr_t)&spi->regs->DR;
+}
+
+
+static void emu_UpdateScan(panel_Panel *panel, uint64_t time) {
+	uint64_t lines = time / EMU_LINE_CYCLES;
+	panel->scanLine = (uint16_t)(lines % PANEL_SCAN_LINES);
+	panel->scanFrame = (uint32_t)(lines / PANEL_SCAN_LINES);
+}
+
+
+static void emu_SpiDeliver(emu_Spi *spi) {
+	emu_UpdateScan(spi->panel, spi->cursor);
+	uint32_t bytes = (spi->regs->CR1.value & SPI_CR1_DFF) ? 2 : 1;
+	if (spi->shiftIsRead) {
+		uint16_t value = 0;
+		for (uint32_t i = 0; i < bytes; ++i) {
+			value = (uint16_t)((value << 8) | (spi->rstLevel ? panel_Read(spi->panel) : 0));
+		}
+		counters.readBytes += bytes;
+		if (spi->rxFull) {
+			spi->regs->SR.value |= SPI_SR_OVR;
+		}
+		spi->rxFull = true;
+		spi->rxData = value;
+		return;
+	}
+	for (uint32_t i = 0; i < bytes; ++i) {
+		uint8_t byte = (bytes == 2 && i == 0) ? (uint8_t)(spi->shiftData >> 8) : (uint8_t)spi->shiftData;
+		if (spi->rstLevel) {
+			panel_Write(spi->panel, byte, spi->dcLevel);
+		}
+		counters.bytes++;
+		if (spi->dcLevel) {
+			counters.dataBytes++;
+		}
+		else {
+			counters.commandBytes++;
+		}
+	}
+}
+
+
+static void emu_SpiAdvance(emu_Spi *spi) {
+	for (;;) {
+		bool enabled = (spi->regs->CR1.value & SPI_CR1_SPE) != 0;
+		if (enabled && !spi->txFull && emu_SpiTransmitting(spi) && emu_DmaRequesting(spi, spi->txChannel, true, SPI_CR2_TXDMAEN)) {
+			spi->txData = emu_DmaFetch(spi->txChannel);
+			spi->txFull = true;
+		}
+		// Receive only mode clocks continuously, modelled while RX DMA takes
+		// the data, polled reads are clocked by dummy writes
+		bool receiving = enabled && !emu_SpiTransmitting(spi) && (spi->regs->CR2.value & SPI_CR2_RXDMAEN);
+		if (enabled && !spi->shifting && (spi->txFull || receiving)) {
+			spi->shifting = true;
+			spi->shiftIsRead = !emu_SpiTransmitting(spi);
+			spi->shiftData = spi->txData;
+			spi->shiftEnd = spi->cursor + emu_SpiFrameCycles(spi);
+			spi->txFull = false;
+			continue;
+		}
+		if (spi->shifting && spi->shiftEnd <= now) {
+			spi->cursor = spi->shiftEnd;
+			spi->shifting = false;
+			emu_SpiDeliver(spi);
+			if (spi->rxFull && emu_DmaRequesting(spi, spi->rxChannel, false, SPI_CR2_RXDMAEN)) {
+				emu_DmaStore(spi->rxChannel, spi->rxData);
+				spi->rxFull = false;
+			}
+			continue;
+		}
+		break;
+	}
+}
+
+
+// First TE edge after time, panel pulses TE when scan reaches teLine
+static uint64_t emu_NextTearing(const emu_Spi *spi, uint64_t time) {
+	uint64_t edge = (time / EMU_FRAME_CYCLES) * EMU_FRAME_CYCLES + spi->panel->teLine * EMU_LINE_CYCLES;
+	if (edge <= time) {
+		edge += EMU_FRAME_CYCLES;
+	}
+	return edge;
+}
+
+
+static bool emu_TearingArmed(const emu_Spi *spi) {
+	return spi->panel->tearingOn && spi->rstLevel && (emu_EXTI.RTSR.value & spi->teLine);
+}
+
+
+static void emu_TearingAdvance(emu_Spi *spi) {
+	uint64_t edge;
+	while ((edge = emu_NextTearing(spi, spi->tearingChecked)) <= now) {
+		if (emu_TearingArmed(spi)) {
+			emu_EXTI.PR.value |= spi->teLine;
+			counters.tearingEdges++;
+		}
+		spi->tearingChecked = edge;
+	}
+	spi->tearingChecked = now;
+}
+
+
+static void emu_Advance(void) {
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		emu_SpiAdvance(&spis[i]);
+		emu_TearingAdvance(&spis[i]);
+		spis[i].cursor = now;
+	}
+}
+
+
+static bool emu_SpiBusy(const emu_Spi *spi) {
+	return spi->shifting || spi->txFull;
+}
+
+
+// Frame on wire or DMA still feeding SPI
+static bool emu_SpiActive(const emu_Spi *spi) {
+	if (!(spi->regs->CR1.value & SPI_CR1_SPE)) {
+		return false;
+	}
+	return emu_SpiBusy(spi) || emu_DmaRequesting(spi, spi->txChannel, true, SPI_CR2_TXDMAEN);
+}
+
+
+static emu_Spi *emu_SpiFromRegister(emu_Register *reg) {
+	const uint8_t *address = (const uint8_t *)reg;
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		const uint8_t *base = (const uint8_t *)spis[i].regs;
+		if (address >= base && address < base + sizeof(SPI_TypeDef)) {
+			return &spis[i];
+		}
+	}
+	abort();
+}
+
+
+static uint32_t emu_SpiReadSR(emu_Register *reg) {
+	emu_Spi *spi = emu_SpiFromRegister(reg);
+	uint32_t sr = reg->value & ~(uint32_t)(SPI_SR_TXE | SPI_SR_BSY | SPI_SR_RXNE);
+	if (!spi->txFull) {
+		sr |= SPI_SR_TXE;
+	}
+	if (emu_SpiBusy(spi)) {
+		sr |= SPI_SR_BSY;
+		counters.spins++;
+	}
+	if (spi->rxFull) {
+		sr |= SPI_SR_RXNE;
+	}
+	return sr;
+}
+
+
+static void emu_SpiWriteSR(emu_Register *reg, uint32_t value) {
+	reg->value = value & SPI_SR_OVR;
+}
+
+
+static uint32_t emu_SpiReadDR(emu_Register *reg) {
+	emu_Spi *spi = emu_SpiFromRegister(reg);
+	spi->rxFull = false;
+	// Overrun clear sequence (DR read, SR read) shortened to DR read
+	spi->regs->SR.value &= ~(uint32_t)SPI_SR_OVR;
+	return spi->rxData;
+}
+
+
+static void emu_SpiWriteDR(emu_Register *reg, uint32_t value) {
+	emu_Spi *spi = emu_SpiFromRegister(reg);
+	if (spi->txFull) {
+		return; // Lost write, TXE not checked
+	}
+	spi->txData = (uint16_t)value;
+	spi->txFull = true;
+	emu_Advance();
+}
+
+
+static void emu_SpiWriteCR1(emu_Register *reg, uint32_t value) {
+	emu_Spi *spi = emu_SpiFromRegister(reg);
+	// Receive only mode is stopped by disabling SPI while it clocks
+	if ((reg->value & SPI_CR1_SPE) && !(value & SPI_CR1_SPE) && emu_SpiBusy(spi) && emu_SpiTransmitting(spi)) {
+		counters.hazards++;
+	}
+	reg->value = value;
+	emu_Advance();
+}
+
+
+static void emu_SpiWriteCR2(emu_Register *reg, uint32_t value) {
+	reg->value = value;
+	emu_Advance();
+}
+
+
+static uint32_t emu_DmaReadCNDTR(emu_Register *reg) {
+	int channel = emu_ChannelIndex(reg, offsetof(DMA_Channel_TypeDef, CNDTR));
+	emu_DmaState *state = &dmaState[channel];
+	if (state->active) {
+		if (state->remaining > 0) {
+			counters.spins++;
+		}
+		return state->remaining;
+	}
+	return reg->value;
+}
+
+
+static void emu_DmaWriteCNDTR(emu_Register *reg, uint32_t value) {
+	int channel = emu_ChannelIndex(reg, offsetof(DMA_Channel_TypeDef, CNDTR));
+	if (!dmaState[channel].active) {
+		reg->value = value & 0xffff;
+	}
+}
+
+
+static void emu_DmaWriteCCR(emu_Register *reg, uint32_t value) {
+	int channel = emu_ChannelIndex(reg, offsetof(DMA_Channel_TypeDef, CCR));
+	DMA_Channel_TypeDef *regs = &emu_DMA1_Channel[channel];
+	emu_DmaState *state = &dmaState[channel];
+	bool wasActive = state->active;
+	reg->value = value;
+	if (!wasActive && (value & DMA_CCR1_EN)) {
+		state->active = true;
+		state->remaining = regs->CNDTR.value;
+		state->initial = regs->CNDTR.value;
+		state->position = 0;
+		for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+			if (regs->CPAR.value == (uint32_t)(uintptr_t)&spis[i].regs->DR) {
+				counters.dmaKicks++;
+			}
+		}
+	}
+	else if (wasActive && !(value & DMA_CCR1_EN)) {
+		state->active = false;
+		regs->CNDTR.value = state->remaining;
+	}
+	emu_Advance();
+}
+
+
+static void emu_DmaWriteIFCR(emu_Register *reg, uint32_t value) {
+	(void)reg;
+	emu_DMA1.ISR.value &= ~value;
+	for (int channel = 0; channel < 7; ++channel) {
+		if (value & (1u << (channel * 4))) {
+			emu_DMA1.ISR.value &= ~(0xfu << (channel * 4));
+		}
+	}
+}
+
+
+static void emu_GpioUpdate(GPIO_TypeDef *port, uint32_t odr) {
+	uint32_t old = port->ODR.value;
+	port->ODR.value = odr & 0xffff;
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		emu_Spi *spi = &spis[i];
+		if (port == spi->dcPort && ((old ^ odr) & spi->dcPin)) {
+			counters.dcToggles++;
+			if (emu_SpiBusy(spi)) {
+				counters.hazards++;
+			}
+		}
+		if (port == spi->dcPort) {
+			spi->dcLevel = (odr & spi->dcPin) != 0;
+		}
+		if (port == spi->rstPort) {
+			bool level = (odr & spi->rstPin) != 0;
+			if (level && !spi->rstLevel) {
+				panel_HardwareReset(spi->panel);
+			}
+			spi->rstLevel = level;
+		}
+	}
+}
+
+
+static GPIO_TypeDef *emu_GpioFromRegister(emu_Register *reg, size_t offset) {
+	GPIO_TypeDef *port = (GPIO_TypeDef *)((uint8_t *)reg - offset);
+	if (port != &emu_GPIOA && port != &emu_GPIOB) {
+		abort();
+	}
+	return port;
+}
+
+
+static void emu_GpioWriteODR(emu_Register *reg, uint32_t value) {
+	emu_GpioUpdate(emu_GpioFromRegister(reg, offsetof(GPIO_TypeDef, ODR)), value);
+}
+
+
+static void emu_GpioWriteBSRR(emu_Register *reg, uint32_t value) {
+	GPIO_TypeDef *port = emu_GpioFromRegister(reg, offsetof(GPIO_TypeDef, BSRR));
+	uint32_t odr = port->ODR.value;
+	odr &= ~(value >> 16);
+	odr |= value & 0xffff;
+	emu_GpioUpdate(port, odr);
+}
+
+
+static void emu_GpioWriteBRR(emu_Register *reg, uint32_t value) {
+	GPIO_TypeDef *port = emu_GpioFromRegister(reg, offsetof(GPIO_TypeDef, BRR));
+	emu_GpioUpdate(port, port->ODR.value & ~(value & 0xffff));
+}
+
+
+static void emu_ExtiWritePR(emu_Register *reg, uint32_t value) {
+	reg->value &= ~value;
+}
+
+
+static void emu_ExtiWriteSWIER(emu_Register *reg, uint32_t value) {
+	(void)reg;
+	emu_EXTI.PR.value |= value & 0xfffff;
+}
+
+
+static uint32_t emu_DwtReadCYCCNT(emu_Register *reg) {
+	if (!(emu_DWT.CTRL.value & DWT_CTRL_CYCCNTENA_Msk)) {
+		return reg->value;
+	}
+	return (uint32_t)now;
+}
+
+
+static int emu_PendingIrq(void) {
+	for (int line = 0; line < 5; ++line) {
+		int irq = EXTI0_IRQn + line;
+		if ((emu_EXTI.PR.value & emu_EXTI.IMR.value & (1u << line)) && irqEnabled[irq]) {
+			return irq;
+		}
+	}
+	for (int channel = 0; channel < 7; ++channel) {
+		int irq = DMA1_Channel1_IRQn + channel;
+		bool flag = (emu_DMA1.ISR.value >> (channel * 4)) & 0x2;
+		if (flag && (emu_DMA1_Channel[channel].CCR.value & DMA_CCR1_TCIE) && irqEnabled[irq]) {
+			return irq;
+		}
+	}
+	return -1;
+}
+
+
+static void emu_DispatchInterrupts(void) {
+	if (inInterrupt || primask) {
+		return;
+	}
+	int irq;
+	uint32_t guard = 0;
+	while ((irq = emu_PendingIrq()) >= 0) {
+		if (irqHandlers[irq] == NULL || ++guard > 1000) {
+			fprintf(stderr, "Unhandled interrupt %d\n", irq);
+			abort();
+		}
+		inInterrupt = true;
+		now += EMU_EXCEPTION_CYCLES;
+		counters.interrupts++;
+		irqHandlers[irq]();
+		now += EMU_EXCEPTION_CYCLES;
+		emu_Advance();
+		inInterrupt = false;
+	}
+}
+
+
+uint32_t emu_RegisterRead(emu_Register *reg) {
+	now += EMU_BUS_CYCLES;
+	emu_Advance();
+	uint32_t value = reg->onRead ? reg->onRead(reg) : reg->value;
+	emu_DispatchInterrupts();
+	return value;
+}
+
+
+void emu_RegisterWrite(emu_Register *reg, uint32_t value) {
+	now += EMU_BUS_CYCLES;
+	emu_Advance();
+	if (reg->onWrite) {
+		reg->onWrite(reg, value);
+	}
+	else {
+		reg->value = value;
+	}
+	emu_DispatchInterrupts();
+}
+
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+	irqEnabled[IRQn] = true;
+	emu_DispatchInterrupts();
+}
+
+
+void NVIC_DisableIRQ(IRQn_Type IRQn) {
+	irqEnabled[IRQn] = false;
+}
+
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {
+	(void)IRQn;
+	(void)priority;
+}
+
+
+void __enable_irq(void) {
+	primask = 0;
+	emu_DispatchInterrupts();
+}
+
+
+void __disable_irq(void) {
+	primask = 1;
+}
+
+
+uint32_t __get_PRIMASK(void) {
+	return primask;
+}
+
+
+void __set_PRIMASK(uint32_t priMask) {
+	primask = priMask & 1;
+	emu_DispatchInterrupts();
+}
+
+
+// Time of next event which can raise interrupt, 0 if there is none
+static uint64_t emu_NextEvent(void) {
+	uint64_t next = 0;
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		const emu_Spi *spi = &spis[i];
+		uint64_t event = 0;
+		if (emu_SpiActive(spi)) {
+			event = now + emu_SpiFrameCycles(spi);
+		}
+		else if (emu_TearingArmed(spi) && (emu_EXTI.IMR.value & spi->teLine) && irqEnabled[EXTI0_IRQn + i]) {
+			event = emu_NextTearing(spi, spi->tearingChecked);
+		}
+		if (event != 0 && (next == 0 || event < next)) {
+			next = event;
+		}
+	}
+	return next;
+}
+
+
+// Sleep until an enabled interrupt is pending, returns when nothing could
+// wake the CPU (would hang on target)
+void emu_WaitForInterrupt(void) {
+	uint64_t start = now;
+	for (;;) {
+		if (emu_PendingIrq() >= 0) {
+			break;
+		}
+		uint64_t next = emu_NextEvent();
+		if (next == 0) {
+			break;
+		}
+		now = next;
+		emu_Advance();
+	}
+	if (emu_PendingIrq() < 0) {
+		counters.deadlocks++;
+	}
+	counters.sleepCycles += now - start;
+	emu_DispatchInterrupts();
+}
+
+
+void emu_SetIrqHandler(IRQn_Type irq, emu_IrqHandler handler) {
+	irqHandlers[irq] = handler;
+}
+
+
+void emu_Reset(void) {
+	memset(&emu_SPI1, 0, sizeof(emu_SPI1));
+	memset(&emu_SPI2, 0, sizeof(emu_SPI2));
+	memset(&emu_DMA1, 0, sizeof(emu_DMA1));
+	memset(&emu_DMA1_Channel, 0, sizeof(emu_DMA1_Channel));
+	memset(&emu_USART1, 0, sizeof(emu_USART1));
+	memset(&emu_USART2, 0, sizeof(emu_USART2));
+	memset(&emu_GPIOA, 0, sizeof(emu_GPIOA));
+	memset(&emu_GPIOB, 0, sizeof(emu_GPIOB));
+	memset(&emu_EXTI, 0, sizeof(emu_EXTI));
+	memset(&emu_DWT, 0, sizeof(emu_DWT));
+	memset(&emu_CoreDebug, 0, sizeof(emu_CoreDebug));
+	memset(&dmaState, 0, sizeof(dmaState));
+	memset(&counters, 0, sizeof(counters));
+	memset(&spis, 0, sizeof(spis));
+	memset(&irqEnabled, 0, sizeof(irqEnabled));
+	primask = 0;
+	inInterrupt = false;
+	now = 0;
+
+	SPI_TypeDef *spiRegs[EMU_PANEL_COUNT] = {&emu_SPI1, &emu_SPI2};
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		spiRegs[i]->CR1.onWrite = emu_SpiWriteCR1;
+		spiRegs[i]->CR2.onWrite = emu_SpiWriteCR2;
+		spiRegs[i]->SR.onRead = emu_SpiReadSR;
+		spiRegs[i]->SR.onWrite = emu_SpiWriteSR;
+		spiRegs[i]->DR.onRead = emu_SpiReadDR;
+		spiRegs[i]->DR.onWrite = emu_SpiWriteDR;
+	}
+	for (int channel = 0; channel < 7; ++channel) {
+		emu_DMA1_Channel[channel].CCR.onWrite = emu_DmaWriteCCR;
+		emu_DMA1_Channel[channel].CNDTR.onRead = emu_DmaReadCNDTR;
+		emu_DMA1_Channel[channel].CNDTR.onWrite = emu_DmaWriteCNDTR;
+	}
+	emu_DMA1.IFCR.onWrite = emu_DmaWriteIFCR;
+	GPIO_TypeDef *ports[2] = {&emu_GPIOA, &emu_GPIOB};
+	for (int i = 0; i < 2; ++i) {
+		ports[i]->ODR.onWrite = emu_GpioWriteODR;
+		ports[i]->BSRR.onWrite = emu_GpioWriteBSRR;
+		ports[i]->BRR.onWrite = emu_GpioWriteBRR;
+	}
+	emu_EXTI.PR.onWrite = emu_ExtiWritePR;
+	emu_EXTI.SWIER.onWrite = emu_ExtiWriteSWIER;
+	emu_DWT.CYCCNT.onRead = emu_DwtReadCYCCNT;
+	// USART line is not emulated, transmitter is always idle
+	emu_USART1.SR.value = USART_SR_TXE | USART_SR_TC;
+	emu_USART2.SR.value = USART_SR_TXE | USART_SR_TC;
+
+	// SPI1 requests are hard wired to DMA1 channel 2 (RX) and 3 (TX), SPI2
+	// to channel 4 (RX) and 5 (TX)
+	spis[0].regs = &emu_SPI1;
+	spis[0].txChannel = 2;
+	spis[0].rxChannel = 1;
+	spis[0].dcPort = EMU_PANEL1_DC_PORT;
+	spis[0].dcPin = EMU_PANEL1_DC_PIN;
+	spis[0].rstPort = EMU_PANEL1_RST_PORT;
+	spis[0].rstPin = EMU_PANEL1_RST_PIN;
+	spis[0].teLine = EXTI_PR_PR0;
+	spis[1].regs = &emu_SPI2;
+	spis[1].txChannel = 4;
+	spis[1].rxChannel = 3;
+	spis[1].dcPort = EMU_PANEL2_DC_PORT;
+	spis[1].dcPin = EMU_PANEL2_DC_PIN;
+	spis[1].rstPort = EMU_PANEL2_RST_PORT;
+	spis[1].rstPin = EMU_PANEL2_RST_PIN;
+	spis[1].teLine = EXTI_PR_PR1;
+
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		emu_Spi *spi = &spis[i];
+		spi->panel = &panels[i];
+		panel_PowerOn(spi->panel, &panel_Geometry240x240);
+		// Bring up SPI like st7789_GPIOInit in examples
+		spi->regs->CR1.value = SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_MSTR | SPI_CR1_CPOL | SPI_CR1_BIDIMODE | SPI_CR1_BIDIOE | SPI_CR1_SPE;
+		spi->rstPort->ODR.value |= spi->rstPin;
+		spi->rstLevel = true;
+	}
+}
+
+
+uint64_t emu_Now(void) {
+	return now;
+}
+
+
+void emu_Delay(uint64_t cycles) {
+	now += cycles;
+	emu_Advance();
+	emu_DispatchInterrupts();
+}
+
+
+bool emu_Busy(void) {
+	for (int i = 0; i < EMU_PANEL_COUNT; ++i) {
+		if (emu_SpiActive(&spis[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void emu_Drain(void) {
+	uint64_t next;
+	while ((next = emu_NextEvent()) != 0 && emu_Busy()) {
+		now = next;
+		emu_Advance();
+	}
+}
+
+
+panel_Panel *emu_GetPanel(void) {
+	return &panels[0];
+}
+
+
+panel_Panel *emu_GetPanelAt(int index) {
+	return &panels[index];
+}
+
+
+emu_Counters emu_GetCounters(void) {
+	emu_Counters result = counters;
+	result.cycles = now;
+	return result;
+}
+
+
+emu_Counters emu_CountersDiff(const emu_Counters *after, const emu_Counters *before) {
+	emu_Counters result;
+	result.cycles = after->cycles - before->cycles;
+	result.bytes = after->bytes - before->bytes;
+	result.commandBytes = after->commandBytes - before->commandBytes;
+	result.dataBytes = after->dataBytes - before->dataBytes;
+	result.readBytes = after->readBytes - before->readBytes;
+	result.dcToggles = after->dcToggles - before->dcToggles;
+	result.dmaKicks = after->dmaKicks - before->dmaKicks;
+	result.spins = after->spins - before->spins;
+	result.hazards = after->hazards - before->hazards;
+	result.interrupts = after->interrupts - before->interrupts;
+	result.sleepCycles = after->sleepCycles - before->sleepCycles;
+	result.deadlocks = after->deadlocks - before->deadlocks;
+	result.tearingEdges = after->tearingEdges - before->tearingEdges;
+	return result;
+}
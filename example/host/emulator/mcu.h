@@ -0,0 +1,57 @@
+#ifndef EMU_MCU_H
+#define EMU_MCU_H
+
+#include <stdint.h>
+#include <stm32f10x.h>
+
+#include "panel.h"
+
+
+// Cost model of the blue pill setup used in examples (HSE 8 MHz, PLL x16)
+#define EMU_CPU_MHZ                  128
+#define EMU_BUS_CYCLES               4    // CPU cycles per peripheral register access
+
+// Board wiring: first panel on SPI1 (TE on PB0, EXTI line 0), second on
+// SPI2 (TE on PB1, EXTI line 1)
+#define EMU_PANEL_COUNT              2
+#define EMU_PANEL1_DC_PORT           GPIOA
+#define EMU_PANEL1_DC_PIN            GPIO_ODR_ODR8
+#define EMU_PANEL1_RST_PORT          GPIOA
+#define EMU_PANEL1_RST_PIN           GPIO_ODR_ODR9
+#define EMU_PANEL2_DC_PORT           GPIOB
+#define EMU_PANEL2_DC_PIN            GPIO_ODR_ODR10
+#define EMU_PANEL2_RST_PORT          GPIOB
+#define EMU_PANEL2_RST_PIN           GPIO_ODR_ODR11
+
+
+typedef struct emu_Counters {
+	uint64_t cycles;       // virtual CPU cycles
+	uint32_t bytes;        // bytes clocked out to the panel
+	uint32_t commandBytes; // bytes sent with D/CX low
+	uint32_t dataBytes;    // bytes sent with D/CX high
+	uint32_t readBytes;    // bytes clocked in from the panel
+	uint32_t dcToggles;    // D/CX level changes
+	uint32_t dmaKicks;     // DMA channel enables towards SPI
+	uint32_t spins;        // status polls which found the peripheral busy
+	uint32_t hazards;      // D/CX or SPE changed while a frame was on the wire
+	uint32_t interrupts;   // interrupt handlers executed
+	uint64_t sleepCycles;  // cycles spent in WFI
+	uint32_t deadlocks;    // WFI with nothing left to wake the CPU
+	uint32_t tearingEdges; // TE pulses raised on EXTI line 0
+} emu_Counters;
+
+typedef void (*emu_IrqHandler)(void);
+
+
+void emu_Reset(void);
+uint64_t emu_Now(void);
+void emu_Delay(uint64_t cycles);
+void emu_Drain(void);
+bool emu_Busy(void);
+panel_Panel *emu_GetPanel(void);
+panel_Panel *emu_GetPanelAt(int index);
+void emu_SetIrqHandler(IRQn_Type irq, emu_IrqHandler handler);
+emu_Counters emu_GetCounters(void);
+emu_Counters emu_CountersDiff(const emu_Counters *after, const emu_Counters *before);
+
+#endif
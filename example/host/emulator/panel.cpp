@@ -0,0 +1,623 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "panel.h"
+
+
+#define PANEL_MADCTL_MY              0x80
+#define PANEL_MADCTL_MX              0x40
+#define PANEL_MADCTL_MV              0x20
+#define PANEL_RAMCTRL_LITTLE_ENDIAN  0x08
+#define PANEL_DGMEN_ENABLE           0x04
+
+#define PANEL_CMD_SWRESET            0x01
+#define PANEL_CMD_RDDID              0x04
+#define PANEL_CMD_RDDMADCTL          0x0b
+#define PANEL_CMD_RDDCOLMOD          0x0c
+#define PANEL_CMD_SLPIN              0x10
+#define PANEL_CMD_SLPOUT             0x11
+#define PANEL_CMD_PTLON              0x12
+#define PANEL_CMD_NORON              0x13
+#define PANEL_CMD_INVOFF             0x20
+#define PANEL_CMD_INVON              0x21
+#define PANEL_CMD_DISPOFF            0x28
+#define PANEL_CMD_DISPON             0x29
+#define PANEL_CMD_CASET              0x2a
+#define PANEL_CMD_RASET              0x2b
+#define PANEL_CMD_RAMWR              0x2c
+#define PANEL_CMD_VSCRDEF            0x33
+#define PANEL_CMD_TEOFF              0x34
+#define PANEL_CMD_TEON               0x35
+#define PANEL_CMD_PTLAR              0x30
+#define PANEL_CMD_IDMOFF             0x38
+#define PANEL_CMD_IDMON              0x39
+#define PANEL_CMD_MADCTL             0x36
+#define PANEL_CMD_VSCRSADD           0x37
+#define PANEL_CMD_COLMOD             0x3a
+#define PANEL_CMD_TESCAN             0x44
+#define PANEL_CMD_RDTESCAN           0x45
+#define PANEL_CMD_RAMWRC             0x3c
+#define PANEL_CMD_RAMRD              0x2e
+#define PANEL_CMD_RAMRDC             0x3e
+#define PANEL_CMD_RAMCTRL            0xb0
+#define PANEL_CMD_FRCTRL1            0xb3
+#define PANEL_CMD_FRCTR2             0xc6
+#define PANEL_CMD_GAMSET             0x26
+#define PANEL_CMD_DGMEN              0xba
+#define PANEL_CMD_PVGAMCTRL          0xe0
+#define PANEL_CMD_NVGAMCTRL          0xe1
+#define PANEL_CMD_DGMLUTR            0xe2
+#define PANEL_CMD_DGMLUTB            0xe3
+
+
+const panel_Geometry panel_Geometry240x240 = {240, 240, 0, 0};
+const panel_Geometry panel_Geometry135x240 = {135, 240, 52, 40};
+
+
+static void panel_SoftwareReset(panel_Panel *panel) {
+	panel->madctl = 0x00;
+	panel->colmod = 0x66;
+	panel->ramctrl[0] = 0x00;
+	panel->ramctrl[1] = 0xf0;
+	panel->gammaCurve = 0x01;
+	panel->idle = false;
+	panel->partial = false;
+	panel->partialStart = 0;
+	panel->partialEnd = PANEL_GRAM_HEIGHT - 1;
+	panel->frameRate = 0x0f;
+	panel->frameRateIdle[0] = 0x00;
+	panel->frameRateIdle[1] = 0x0f;
+	panel->frameRateIdle[2] = 0x0f;
+	panel->digitalGamma = false;
+	for (uint8_t level = 0; level < PANEL_GAMMA_LUT_SIZE; ++level) {
+		panel->gammaLut[0][level] = level;
+		panel->gammaLut[1][level] = level;
+	}
+	panel->inverted = false;
+	panel->sleeping = true;
+	panel->displayOn = false;
+	panel->tearingOn = false;
+	panel->xStart = 0;
+	panel->xEnd = PANEL_GRAM_WIDTH - 1;
+	panel->yStart = 0;
+	panel->yEnd = PANEL_GRAM_HEIGHT - 1;
+	panel->scrollTop = 0;
+	panel->scrollArea = PANEL_GRAM_HEIGHT;
+	panel->scrollBottom = 0;
+	panel->scrollStart = 0;
+	panel->teLine = PANEL_GRAM_HEIGHT;
+	panel->command = 0x00;
+	panel->paramCount = 0;
+	panel->writing = false;
+	panel->reading = false;
+	panel->pixelCount = 0;
+	panel->readLength = 0;
+	panel->readPosition = 0;
+}
+
+
+void panel_PowerOn(panel_Panel *panel, const panel_Geometry *geometry) {
+	memset(panel, 0, sizeof(*panel));
+	panel->geometry = *geometry;
+	panel->lastTearFrame = UINT32_MAX;
+	panel_SoftwareReset(panel);
+}
+
+
+void panel_HardwareReset(panel_Panel *panel) {
+	panel_SoftwareReset(panel);
+}
+
+
+static uint16_t panel_Param16(const panel_Panel *panel, uint8_t index) {
+	return (uint16_t)((panel->params[index] << 8) | panel->params[index + 1]);
+}
+
+
+static uint16_t panel_ScrolledRow(const panel_Panel *panel, uint16_t line) {
+	uint16_t top = panel->scrollTop;
+	uint16_t area = panel->scrollArea;
+	if (line < top || line >= top + area || area == 0) {
+		return line;
+	}
+	uint16_t start = panel->scrollStart;
+	if (start < top || start >= top + area) {
+		start = top;
+	}
+	return (uint16_t)(top + (line - top + start - top) % area);
+}
+
+
+// Write to the visible row which is just being refreshed splits the frame
+static void panel_CheckTearing(panel_Panel *panel, uint16_t row) {
+	if (!panel->displayOn || panel->sleeping || panel->scanLine >= PANEL_GRAM_HEIGHT) {
+		return;
+	}
+	if (row < panel->geometry.rowOffset || row >= panel->geometry.rowOffset + panel->geometry.height) {
+		return;
+	}
+	if (panel_ScrolledRow(panel, panel->scanLine) == row && panel->lastTearFrame != panel->scanFrame) {
+		panel->lastTearFrame = panel->scanFrame;
+		panel->tears++;
+	}
+}
+
+
+// Frame memory position of address counter, false outside of memory
+static bool panel_MemoryAddress(const panel_Panel *panel, uint16_t *column, uint16_t *row) {
+	uint16_t x = panel->col;
+	uint16_t y = panel->row;
+	if (panel->madctl & PANEL_MADCTL_MV) {
+		uint16_t tmp = x;
+		x = y;
+		y = tmp;
+	}
+	if (panel->madctl & PANEL_MADCTL_MX) {
+		x = (uint16_t)(PANEL_GRAM_WIDTH - 1 - x);
+	}
+	if (panel->madctl & PANEL_MADCTL_MY) {
+		y = (uint16_t)(PANEL_GRAM_HEIGHT - 1 - y);
+	}
+	*column = x;
+	*row = y;
+	return x < PANEL_GRAM_WIDTH && y < PANEL_GRAM_HEIGHT;
+}
+
+
+static void panel_AdvanceAddress(panel_Panel *panel) {
+	if (panel->col >= panel->xEnd) {
+		panel->col = panel->xStart;
+		panel->row = (panel->row >= panel->yEnd) ? panel->yStart : (uint16_t)(panel->row + 1);
+	}
+	else {
+		panel->col++;
+	}
+}
+
+
+static void panel_StorePixel(panel_Panel *panel, uint16_t color) {
+	uint16_t x, y;
+	if (panel_MemoryAddress(panel, &x, &y)) {
+		panel->gram[y][x] = color;
+		panel_CheckTearing(panel, y);
+	}
+	panel->pixelsWritten++;
+	panel_AdvanceAddress(panel);
+}
+
+
+// Serial interface reads RGB666 in bits 7..2 of 3 bytes, 5 bit channels
+// are extended with their top bit
+static void panel_LoadPixel(panel_Panel *panel) {
+	uint16_t x, y;
+	uint16_t color = 0;
+	if (panel_MemoryAddress(panel, &x, &y)) {
+		color = panel->gram[y][x];
+	}
+	uint8_t r = (uint8_t)(color >> 11);
+	uint8_t g = (uint8_t)((color >> 5) & 0x3f);
+	uint8_t b = (uint8_t)(color & 0x1f);
+	panel->pixelBytes[0] = (uint8_t)(((r << 1) | (r >> 4)) << 2);
+	panel->pixelBytes[1] = (uint8_t)(g << 2);
+	panel->pixelBytes[2] = (uint8_t)(((b << 1) | (b >> 4)) << 2);
+	panel->pixelsRead++;
+	panel_AdvanceAddress(panel);
+}
+
+
+static uint16_t panel_Expand444(uint8_t r, uint8_t g, uint8_t b) {
+	return (uint16_t)((((r << 1) | (r >> 3)) << 11) | (((g << 2) | (g >> 2)) << 5) | ((b << 1) | (b >> 3)));
+}
+
+
+static void panel_WritePixelByte(panel_Panel *panel, uint8_t byte) {
+	panel->pixelBytes[panel->pixelCount++] = byte;
+	const uint8_t *b = panel->pixelBytes;
+	switch (panel->colmod & 0x07) {
+		case 0x03: // 12 bit, 2 pixels in 3 bytes, first one stored after 12 bits
+			if (panel->pixelCount == 2) {
+				panel_StorePixel(panel, panel_Expand444(b[0] >> 4, b[0] & 0x0f, b[1] >> 4));
+			}
+			else if (panel->pixelCount == 3) {
+				panel_StorePixel(panel, panel_Expand444(b[1] & 0x0f, b[2] >> 4, b[2] & 0x0f));
+				panel->pixelCount = 0;
+			}
+			break;
+		case 0x05: // 16 bit
+			if (panel->pixelCount == 2) {
+				if (panel->ramctrl[1] & PANEL_RAMCTRL_LITTLE_ENDIAN) {
+					panel_StorePixel(panel, (uint16_t)(b[0] | (b[1] << 8)));
+				}
+				else {
+					panel_StorePixel(panel, (uint16_t)((b[0] << 8) | b[1]));
+				}
+				panel->pixelCount = 0;
+			}
+			break;
+		default: // 18 bit
+			if (panel->pixelCount == 3) {
+				panel_StorePixel(panel, (uint16_t)(((b[0] >> 3) << 11) | ((b[1] >> 2) << 5) | (b[2] >> 3)));
+				panel->pixelCount = 0;
+			}
+			break;
+	}
+}
+
+
+static void panel_QueueRead(panel_Panel *panel, const uint8_t *data, uint8_t length) {
+	memcpy(panel->readQueue, data, length);
+	panel->readLength = length;
+	panel->readPosition = 0;
+}
+
+
+static void panel_Command(panel_Panel *panel, uint8_t command) {
+	panel->command = command;
+	panel->paramCount = 0;
+	panel->writing = false;
+	panel->reading = false;
+	panel->pixelCount = 0;
+	panel->readLength = 0;
+	panel->commands++;
+	switch (command) {
+		case 0x00: // NOP
+			break;
+		case PANEL_CMD_SWRESET:
+			panel_SoftwareReset(panel);
+			break;
+		case PANEL_CMD_RDDID: {
+			const uint8_t id[3] = {0x85, 0x85, 0x52};
+			panel_QueueRead(panel, id, sizeof(id));
+			break;
+		}
+		case PANEL_CMD_RDDMADCTL:
+			panel_QueueRead(panel, &panel->madctl, 1);
+			break;
+		case PANEL_CMD_RDDCOLMOD:
+			panel_QueueRead(panel, &panel->colmod, 1);
+			break;
+		case PANEL_CMD_RDTESCAN: {
+			const uint8_t line[2] = {(uint8_t)(panel->scanLine >> 8), (uint8_t)panel->scanLine};
+			panel_QueueRead(panel, line, sizeof(line));
+			break;
+		}
+		case PANEL_CMD_SLPIN:
+			panel->sleeping = true;
+			break;
+		case PANEL_CMD_SLPOUT:
+			panel->sleeping = false;
+			break;
+		case PANEL_CMD_PTLON:
+			panel->partial = true;
+			break;
+		case PANEL_CMD_NORON:
+			panel->partial = false;
+			break;
+		case PANEL_CMD_IDMOFF:
+			panel->idle = false;
+			break;
+		case PANEL_CMD_IDMON:
+			panel->idle = true;
+			break;
+		case PANEL_CMD_INVOFF:
+			panel->inverted = false;
+			break;
+		case PANEL_CMD_INVON:
+			panel->inverted = true;
+			break;
+		case PANEL_CMD_DISPOFF:
+			panel->displayOn = false;
+			break;
+		case PANEL_CMD_DISPON:
+			panel->displayOn = true;
+			break;
+		case PANEL_CMD_TEOFF:
+			panel->tearingOn = false;
+			break;
+		case PANEL_CMD_TEON:
+			panel->tearingOn = true;
+			break;
+		case PANEL_CMD_RAMWR:
+			panel->col = panel->xStart;
+			panel->row = panel->yStart;
+			panel->writing = true;
+			break;
+		case PANEL_CMD_RAMWRC:
+			panel->writing = true;
+			break;
+		case PANEL_CMD_RAMRD:
+			panel->col = panel->xStart;
+			panel->row = panel->yStart;
+			panel->reading = true;
+			panel->readDummy = true;
+			break;
+		case PANEL_CMD_RAMRDC:
+			panel->reading = true;
+			panel->readDummy = true;
+			break;
+		case PANEL_CMD_CASET:
+		case PANEL_CMD_RASET:
+		case PANEL_CMD_VSCRDEF:
+		case PANEL_CMD_MADCTL:
+		case PANEL_CMD_VSCRSADD:
+		case PANEL_CMD_COLMOD:
+		case PANEL_CMD_TESCAN:
+		case PANEL_CMD_RAMCTRL:
+		case PANEL_CMD_GAMSET:
+		case PANEL_CMD_DGMEN:
+		case PANEL_CMD_PVGAMCTRL:
+		case PANEL_CMD_NVGAMCTRL:
+		case PANEL_CMD_DGMLUTR:
+		case PANEL_CMD_DGMLUTB:
+		case PANEL_CMD_PTLAR:
+		case PANEL_CMD_FRCTRL1:
+		case PANEL_CMD_FRCTR2:
+			break;
+		default:
+			if (command < 0xb0) {
+				panel->unknownCommands++;
+			}
+			break;
+	}
+}
+
+
+static void panel_Parameter(panel_Panel *panel, uint8_t byte) {
+	// Long parameter lists (gamma tables) are decoded byte by byte
+	if (panel->paramCount < sizeof(panel->params)) {
+		panel->params[panel->paramCount] = byte;
+	}
+	if (panel->paramCount < 0xff) {
+		panel->paramCount++;
+	}
+	uint8_t count = panel->paramCount;
+	switch (panel->command) {
+		case PANEL_CMD_CASET:
+			if (count == 4) {
+				panel->xStart = panel_Param16(panel, 0);
+				panel->xEnd = panel_Param16(panel, 2);
+			}
+			break;
+		case PANEL_CMD_RASET:
+			if (count == 4) {
+				panel->yStart = panel_Param16(panel, 0);
+				panel->yEnd = panel_Param16(panel, 2);
+			}
+			break;
+		case PANEL_CMD_VSCRDEF:
+			if (count == 6) {
+				panel->scrollTop = panel_Param16(panel, 0);
+				panel->scrollArea = panel_Param16(panel, 2);
+				panel->scrollBottom = panel_Param16(panel, 4);
+			}
+			break;
+		case PANEL_CMD_VSCRSADD:
+			if (count == 2) {
+				panel->scrollStart = panel_Param16(panel, 0);
+			}
+			break;
+		case PANEL_CMD_MADCTL:
+			if (count == 1) {
+				panel->madctl = byte;
+			}
+			break;
+		case PANEL_CMD_COLMOD:
+			if (count == 1) {
+				panel->colmod = byte;
+			}
+			break;
+		case PANEL_CMD_PTLAR:
+			if (count == 4) {
+				panel->partialStart = panel_Param16(panel, 0);
+				panel->partialEnd = panel_Param16(panel, 2);
+			}
+			break;
+		case PANEL_CMD_FRCTRL1:
+			if (count <= 3) {
+				panel->frameRateIdle[count - 1] = byte;
+			}
+			break;
+		case PANEL_CMD_FRCTR2:
+			if (count == 1) {
+				panel->frameRate = byte;
+			}
+			break;
+		case PANEL_CMD_TESCAN:
+			if (count == 2) {
+				panel->teLine = panel_Param16(panel, 0);
+			}
+			break;
+		case PANEL_CMD_RAMCTRL:
+			if (count <= 2) {
+				panel->ramctrl[count - 1] = byte;
+			}
+			break;
+		case PANEL_CMD_GAMSET:
+			if (count == 1) {
+				panel->gammaCurve = byte;
+			}
+			break;
+		case PANEL_CMD_DGMEN:
+			if (count == 1) {
+				panel->digitalGamma = (byte & PANEL_DGMEN_ENABLE) != 0;
+			}
+			break;
+		case PANEL_CMD_PVGAMCTRL:
+		case PANEL_CMD_NVGAMCTRL:
+			if (count <= PANEL_GAMMA_CURVE_SIZE) {
+				panel->gammaCurves[panel->command - PANEL_CMD_PVGAMCTRL][count - 1] = byte;
+			}
+			break;
+		case PANEL_CMD_DGMLUTR:
+		case PANEL_CMD_DGMLUTB:
+			if (count <= PANEL_GAMMA_LUT_SIZE) {
+				panel->gammaLut[panel->command - PANEL_CMD_DGMLUTR][count - 1] = byte & 0x3f;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+void panel_Write(panel_Panel *panel, uint8_t byte, bool data) {
+	if (!data) {
+		panel_Command(panel, byte);
+	}
+	else if (panel->writing) {
+		panel_WritePixelByte(panel, byte);
+	}
+	else {
+		panel_Parameter(panel, byte);
+	}
+}
+
+
+uint8_t panel_Read(panel_Panel *panel) {
+	if (panel->reading) {
+		if (panel->readDummy) {
+			panel->readDummy = false;
+			return 0x00;
+		}
+		if (panel->pixelCount == 0) {
+			panel_LoadPixel(panel);
+		}
+		uint8_t byte = panel->pixelBytes[panel->pixelCount];
+		panel->pixelCount = (uint8_t)((panel->pixelCount + 1) % 3);
+		return byte;
+	}
+	if (panel->readPosition < panel->readLength) {
+		return panel->readQueue[panel->readPosition++];
+	}
+	return 0x00;
+}
+
+
+uint16_t panel_GetPixel(const panel_Panel *panel, uint16_t x, uint16_t y) {
+	uint16_t column = (uint16_t)(panel->geometry.colOffset + x);
+	uint16_t row = panel_ScrolledRow(panel, (uint16_t)(panel->geometry.rowOffset + y));
+	if (column >= PANEL_GRAM_WIDTH || row >= PANEL_GRAM_HEIGHT) {
+		return 0;
+	}
+	return panel->gram[row][column];
+}
+
+
+static uint32_t panel_Crc32(uint32_t crc, const uint8_t *data, size_t length) {
+	crc = ~crc;
+	while (length--) {
+		crc ^= *data++;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+
+uint32_t panel_Checksum(const panel_Panel *panel) {
+	uint32_t crc = 0;
+	for (uint16_t y = 0; y < panel->geometry.height; ++y) {
+		for (uint16_t x = 0; x < panel->geometry.width; ++x) {
+			uint16_t pixel = panel_GetPixel(panel, x, y);
+			uint8_t bytes[2] = {(uint8_t)(pixel & 0xff), (uint8_t)(pixel >> 8)};
+			crc = panel_Crc32(crc, bytes, 2);
+		}
+	}
+	return crc;
+}
+
+
+static void panel_PutBe32(uint8_t *out, uint32_t value) {
+	out[0] = (uint8_t)(value >> 24);
+	out[1] = (uint8_t)(value >> 16);
+	out[2] = (uint8_t)(value >> 8);
+	out[3] = (uint8_t)value;
+}
+
+
+static void panel_PngChunk(FILE *fp, const char *type, const uint8_t *data, uint32_t length) {
+	uint8_t header[8];
+	panel_PutBe32(header, length);
+	memcpy(header + 4, type, 4);
+	fwrite(header, 1, 8, fp);
+	fwrite(data, 1, length, fp);
+	uint32_t crc = panel_Crc32(0, header + 4, 4);
+	crc = panel_Crc32(crc, data, length);
+	uint8_t trailer[4];
+	panel_PutBe32(trailer, crc);
+	fwrite(trailer, 1, 4, fp);
+}
+
+
+// Uncompressed PNG, zlib stream made of stored deflate blocks (one per row)
+// 8 bit output of 5 bit red (0) or blue (1) level, digital gamma works on
+// 6 bit levels
+static uint8_t panel_GlassLevel(const panel_Panel *panel, uint8_t channel, uint8_t level) {
+	if (!panel->digitalGamma) {
+		return (uint8_t)((level << 3) | (level >> 2));
+	}
+	level = panel->gammaLut[channel][(level << 1) | (level >> 4)];
+	return (uint8_t)((level << 2) | (level >> 4));
+}
+
+
+bool panel_SavePng(const panel_Panel *panel, const char *path) {
+	const uint32_t width = panel->geometry.width;
+	const uint32_t height = panel->geometry.height;
+	const uint32_t rowSize = 1 + width * 3;
+	static uint8_t idat[2 + PANEL_GRAM_HEIGHT * (5 + 1 + PANEL_GRAM_WIDTH * 3) + 4];
+	static uint8_t row[1 + PANEL_GRAM_WIDTH * 3];
+
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL) {
+		return false;
+	}
+	fwrite("\x89PNG\r\n\x1a\n", 1, 8, fp);
+
+	uint8_t ihdr[13];
+	panel_PutBe32(ihdr, width);
+	panel_PutBe32(ihdr + 4, height);
+	ihdr[8] = 8;  // Bit depth
+	ihdr[9] = 2;  // RGB
+	ihdr[10] = 0; // Deflate
+	ihdr[11] = 0; // Adaptive filtering
+	ihdr[12] = 0; // No interlace
+	panel_PngChunk(fp, "IHDR", ihdr, sizeof(ihdr));
+
+	uint32_t size = 0;
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+	idat[size++] = 0x78;
+	idat[size++] = 0x01;
+	for (uint32_t y = 0; y < height; ++y) {
+		row[0] = 0; // Filter none
+		for (uint32_t x = 0; x < width; ++x) {
+			uint16_t pixel = panel_GetPixel(panel, (uint16_t)x, (uint16_t)y);
+			uint8_t r = panel_GlassLevel(panel, 0, (uint8_t)((pixel >> 11) & 0x1f));
+			uint8_t g = (uint8_t)((pixel >> 5) & 0x3f);
+			uint8_t b = panel_GlassLevel(panel, 1, (uint8_t)(pixel & 0x1f));
+			row[1 + x * 3] = r;
+			row[2 + x * 3] = (uint8_t)((g << 2) | (g >> 4));
+			row[3 + x * 3] = b;
+		}
+		idat[size++] = (y == height - 1) ? 1 : 0;
+		idat[size++] = (uint8_t)(rowSize & 0xff);
+		idat[size++] = (uint8_t)(rowSize >> 8);
+		idat[size++] = (uint8_t)(~rowSize & 0xff);
+		idat[size++] = (uint8_t)((~rowSize >> 8) & 0xff);
+		memcpy(idat + size, row, rowSize);
+		size += rowSize;
+		for (uint32_t i = 0; i < rowSize; ++i) {
+			adlerA = (adlerA + row[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+	}
+	panel_PutBe32(idat + size, (adlerB << 16) | adlerA);
+	size += 4;
+	panel_PngChunk(fp, "IDAT", idat, size);
+	panel_PngChunk(fp, "IEND", NULL, 0);
+
+	return fclose(fp) == 0;
+}
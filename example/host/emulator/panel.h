@@ -0,0 +1,93 @@
+#ifndef EMU_PANEL_H
+#define EMU_PANEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define PANEL_GRAM_WIDTH             240
+#define PANEL_GRAM_HEIGHT            320
+// Refresh timing with PORCTRL 0x0c/0x0c and FRCTR2 0x0f: 320 lines plus
+// back and front porch at 60 Hz
+#define PANEL_SCAN_LINES             344
+#define PANEL_FRAME_RATE             60
+#define PANEL_GAMMA_CURVE_SIZE       14
+#define PANEL_GAMMA_LUT_SIZE         64
+
+
+// Part of the 240x320 frame memory visible on the glass
+typedef struct panel_Geometry {
+	uint16_t width;
+	uint16_t height;
+	uint16_t colOffset;
+	uint16_t rowOffset;
+} panel_Geometry;
+
+
+typedef struct panel_Panel {
+	panel_Geometry geometry;
+	uint16_t gram[PANEL_GRAM_HEIGHT][PANEL_GRAM_WIDTH];
+
+	// Registers
+	uint8_t madctl;
+	uint8_t colmod;
+	uint8_t ramctrl[2];
+	uint8_t gammaCurve;
+	uint8_t gammaCurves[2][PANEL_GAMMA_CURVE_SIZE]; // PVGAMCTRL, NVGAMCTRL
+	uint8_t gammaLut[2][PANEL_GAMMA_LUT_SIZE];      // DGMLUTR, DGMLUTB
+	bool digitalGamma;                              // Applied to png output only
+	bool inverted;
+	bool idle;              // 8 colours
+	bool partial;           // Scan limited to partialStart..partialEnd
+	uint16_t partialStart, partialEnd;
+	uint8_t frameRate;      // FRCTR2
+	uint8_t frameRateIdle[3]; // FRCTRL1 (partial and idle mode)
+	bool sleeping;
+	bool displayOn;
+	bool tearingOn;
+	uint16_t xStart, xEnd;
+	uint16_t yStart, yEnd;
+	uint16_t scrollTop, scrollArea, scrollBottom;
+	uint16_t scrollStart;
+	uint16_t teLine;
+
+	// Command decoder
+	uint8_t command;
+	uint8_t paramCount;
+	uint8_t params[16];
+	bool writing;
+	bool reading;           // RAMRD / RAMRDC, pixels are read from address counter
+	bool readDummy;         // First byte of memory read
+	uint16_t col, row;
+	uint8_t pixelBytes[3];
+	uint8_t pixelCount;
+	uint8_t readQueue[8];
+	uint8_t readLength;
+	uint8_t readPosition;
+
+	// Refresh position, updated by MCU before every access
+	uint16_t scanLine;
+	uint32_t scanFrame;
+
+	// Statistics
+	uint32_t commands;
+	uint32_t pixelsWritten;
+	uint32_t pixelsRead;
+	uint32_t unknownCommands;
+	uint32_t tears;         // refresh frames where scan crossed written row
+	uint32_t lastTearFrame;
+} panel_Panel;
+
+
+extern const panel_Geometry panel_Geometry240x240;
+extern const panel_Geometry panel_Geometry135x240;
+
+void panel_PowerOn(panel_Panel *panel, const panel_Geometry *geometry);
+void panel_HardwareReset(panel_Panel *panel);
+void panel_Write(panel_Panel *panel, uint8_t byte, bool data);
+uint8_t panel_Read(panel_Panel *panel);
+uint16_t panel_GetPixel(const panel_Panel *panel, uint16_t x, uint16_t y);
+uint32_t panel_Checksum(const panel_Panel *panel);
+bool panel_SavePng(const panel_Panel *panel, const char *path);
+
+#endif
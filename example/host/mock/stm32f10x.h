@@ -0,0 +1,239 @@
+// Host replacement for vendor/cmsis/stm32f10x.h
+//
+// Peripheral registers are proxy objects, every access is forwarded to the
+// emulator (emulator/mcu.cpp) which advances virtual time, moves DMA data
+// and feeds the emulated panel. Driver sources are compiled as C++ so plain
+// register expressions like ST7789_SPI->DR = data keep working unchanged.
+
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#ifndef __cplusplus
+#error "Host mock registers require the driver to be compiled as C++"
+#endif
+
+#include <stdint.h>
+
+
+typedef enum IRQn
+{
+	EXTI0_IRQn                  = 6,
+	EXTI1_IRQn                  = 7,
+	EXTI2_IRQn                  = 8,
+	EXTI3_IRQn                  = 9,
+	EXTI4_IRQn                  = 10,
+	DMA1_Channel1_IRQn          = 11,
+	DMA1_Channel2_IRQn          = 12,
+	DMA1_Channel3_IRQn          = 13,
+	DMA1_Channel4_IRQn          = 14,
+	DMA1_Channel5_IRQn          = 15,
+	DMA1_Channel6_IRQn          = 16,
+	DMA1_Channel7_IRQn          = 17,
+	EMU_IRQ_COUNT               = 68,
+} IRQn_Type;
+
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+void __enable_irq(void);
+void __disable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void emu_WaitForInterrupt(void);
+
+#define __WFI() emu_WaitForInterrupt()
+
+
+struct emu_Register;
+
+typedef uint32_t (*emu_ReadHandler)(emu_Register *reg);
+typedef void (*emu_WriteHandler)(emu_Register *reg, uint32_t value);
+
+uint32_t emu_RegisterRead(emu_Register *reg);
+void emu_RegisterWrite(emu_Register *reg, uint32_t value);
+
+struct emu_Register {
+	uint32_t value;
+	emu_ReadHandler onRead;
+	emu_WriteHandler onWrite;
+
+	operator uint32_t() { return emu_RegisterRead(this); }
+	emu_Register &operator=(uint32_t v) { emu_RegisterWrite(this, v); return *this; }
+	emu_Register &operator|=(uint32_t v) { emu_RegisterWrite(this, emu_RegisterRead(this) | v); return *this; }
+	emu_Register &operator&=(uint32_t v) { emu_RegisterWrite(this, emu_RegisterRead(this) & v); return *this; }
+	emu_Register &operator^=(uint32_t v) { emu_RegisterWrite(this, emu_RegisterRead(this) ^ v); return *this; }
+};
+
+
+typedef struct
+{
+	emu_Register CR1;
+	emu_Register CR2;
+	emu_Register SR;
+	emu_Register DR;
+} SPI_TypeDef;
+
+typedef struct
+{
+	emu_Register CCR;
+	emu_Register CNDTR;
+	emu_Register CPAR;
+	emu_Register CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+	emu_Register ISR;
+	emu_Register IFCR;
+} DMA_TypeDef;
+
+typedef struct
+{
+	emu_Register SR;
+	emu_Register DR;
+	emu_Register BRR;
+	emu_Register CR1;
+	emu_Register CR2;
+	emu_Register CR3;
+	emu_Register GTPR;
+} USART_TypeDef;
+
+typedef struct
+{
+	emu_Register CRL;
+	emu_Register CRH;
+	emu_Register IDR;
+	emu_Register ODR;
+	emu_Register BSRR;
+	emu_Register BRR;
+	emu_Register LCKR;
+} GPIO_TypeDef;
+
+
+typedef struct
+{
+	emu_Register IMR;
+	emu_Register EMR;
+	emu_Register RTSR;
+	emu_Register FTSR;
+	emu_Register SWIER;
+	emu_Register PR;
+} EXTI_TypeDef;
+
+typedef struct
+{
+	emu_Register CTRL;
+	emu_Register CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+	emu_Register DHCSR;
+	emu_Register DCRSR;
+	emu_Register DCRDR;
+	emu_Register DEMCR;
+} CoreDebug_Type;
+
+
+extern SPI_TypeDef emu_SPI1;
+extern SPI_TypeDef emu_SPI2;
+extern EXTI_TypeDef emu_EXTI;
+extern DWT_Type emu_DWT;
+extern CoreDebug_Type emu_CoreDebug;
+extern DMA_TypeDef emu_DMA1;
+extern DMA_Channel_TypeDef emu_DMA1_Channel[7];
+extern USART_TypeDef emu_USART1;
+extern USART_TypeDef emu_USART2;
+extern GPIO_TypeDef emu_GPIOA;
+extern GPIO_TypeDef emu_GPIOB;
+
+#define SPI1                ((SPI_TypeDef *) &emu_SPI1)
+#define SPI2                ((SPI_TypeDef *) &emu_SPI2)
+#define DMA1                ((DMA_TypeDef *) &emu_DMA1)
+#define DMA1_Channel1       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[0])
+#define DMA1_Channel2       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[1])
+#define DMA1_Channel3       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[2])
+#define DMA1_Channel4       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[3])
+#define DMA1_Channel5       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[4])
+#define DMA1_Channel6       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[5])
+#define DMA1_Channel7       ((DMA_Channel_TypeDef *) &emu_DMA1_Channel[6])
+#define USART1              ((USART_TypeDef *) &emu_USART1)
+#define USART2              ((USART_TypeDef *) &emu_USART2)
+#define GPIOA               ((GPIO_TypeDef *) &emu_GPIOA)
+#define GPIOB               ((GPIO_TypeDef *) &emu_GPIOB)
+#define EXTI                ((EXTI_TypeDef *) &emu_EXTI)
+#define DWT                 ((DWT_Type *) &emu_DWT)
+#define CoreDebug           ((CoreDebug_Type *) &emu_CoreDebug)
+
+
+#define  GPIO_ODR_ODR8                       ((uint16_t)0x0100)            /*!< Port output data, bit 8 */
+#define  GPIO_ODR_ODR9                       ((uint16_t)0x0200)            /*!< Port output data, bit 9 */
+#define  GPIO_ODR_ODR10                      ((uint16_t)0x0400)            /*!< Port output data, bit 10 */
+#define  GPIO_ODR_ODR11                      ((uint16_t)0x0800)            /*!< Port output data, bit 11 */
+
+#define  EXTI_IMR_MR0                        ((uint32_t)0x00000001)        /*!< Interrupt Mask on line 0 */
+#define  EXTI_IMR_MR1                        ((uint32_t)0x00000002)        /*!< Interrupt Mask on line 1 */
+#define  EXTI_RTSR_TR0                       ((uint32_t)0x00000001)        /*!< Rising trigger event configuration bit of line 0 */
+#define  EXTI_SWIER_SWIER0                   ((uint32_t)0x00000001)        /*!< Software Interrupt on line 0 */
+#define  EXTI_PR_PR0                         ((uint32_t)0x00000001)        /*!< Pending bit for line 0 */
+#define  EXTI_PR_PR1                         ((uint32_t)0x00000002)        /*!< Pending bit for line 1 */
+
+#define DWT_CTRL_CYCCNTENA_Msk               (0x1UL)                       /*!< DWT CTRL: CYCCNTENA Mask */
+#define CoreDebug_DEMCR_TRCENA_Msk           (1UL << 24)                   /*!< CoreDebug DEMCR: TRCENA Mask */
+
+#define  DMA_ISR_GIF1                        ((uint32_t)0x00000001)        /*!< Channel 1 Global interrupt flag */
+#define  DMA_ISR_TCIF1                       ((uint32_t)0x00000002)        /*!< Channel 1 Transfer Complete flag */
+#define  DMA_IFCR_CGIF1                      ((uint32_t)0x00000001)        /*!< Channel 1 Global interrupt clear */
+#define  DMA_ISR_GIF3                        ((uint32_t)0x00000100)        /*!< Channel 3 Global interrupt flag */
+#define  DMA_ISR_TCIF3                       ((uint32_t)0x00000200)        /*!< Channel 3 Transfer Complete flag */
+#define  DMA_IFCR_CGIF3                      ((uint32_t)0x00000100)        /*!< Channel 3 Global interrupt clear */
+#define  DMA_IFCR_CTCIF3                     ((uint32_t)0x00000200)        /*!< Channel 3 Transfer Complete clear */
+
+#define  DMA_CCR1_EN                         ((uint16_t)0x0001)            /*!< Channel enable*/
+#define  DMA_CCR1_TCIE                       ((uint16_t)0x0002)            /*!< Transfer complete interrupt enable */
+#define  DMA_CCR1_HTIE                       ((uint16_t)0x0004)            /*!< Half Transfer interrupt enable */
+#define  DMA_CCR1_TEIE                       ((uint16_t)0x0008)            /*!< Transfer error interrupt enable */
+#define  DMA_CCR1_DIR                        ((uint16_t)0x0010)            /*!< Data transfer direction */
+#define  DMA_CCR1_CIRC                       ((uint16_t)0x0020)            /*!< Circular mode */
+#define  DMA_CCR1_PINC                       ((uint16_t)0x0040)            /*!< Peripheral increment mode */
+#define  DMA_CCR1_MINC                       ((uint16_t)0x0080)            /*!< Memory increment mode */
+#define  DMA_CCR1_PSIZE                      ((uint16_t)0x0300)            /*!< PSIZE[1:0] bits (Peripheral size) */
+#define  DMA_CCR1_PSIZE_0                    ((uint16_t)0x0100)            /*!< Bit 0 */
+#define  DMA_CCR1_PSIZE_1                    ((uint16_t)0x0200)            /*!< Bit 1 */
+#define  DMA_CCR1_MSIZE                      ((uint16_t)0x0C00)            /*!< MSIZE[1:0] bits (Memory size) */
+#define  DMA_CCR1_MSIZE_0                    ((uint16_t)0x0400)            /*!< Bit 0 */
+#define  DMA_CCR1_MSIZE_1                    ((uint16_t)0x0800)            /*!< Bit 1 */
+#define  DMA_CCR1_PL                         ((uint16_t)0x3000)            /*!< PL[1:0] bits(Channel Priority level) */
+#define  DMA_CCR1_MEM2MEM                    ((uint16_t)0x4000)            /*!< Memory to memory mode */
+
+#define  SPI_CR1_CPHA                        ((uint16_t)0x0001)            /*!< Clock Phase */
+#define  SPI_CR1_CPOL                        ((uint16_t)0x0002)            /*!< Clock Polarity */
+#define  SPI_CR1_MSTR                        ((uint16_t)0x0004)            /*!< Master Selection */
+#define  SPI_CR1_BR                          ((uint16_t)0x0038)            /*!< BR[2:0] bits (Baud Rate Control) */
+#define  SPI_CR1_BR_0                        ((uint16_t)0x0008)            /*!< Bit 0 */
+#define  SPI_CR1_BR_1                        ((uint16_t)0x0010)            /*!< Bit 1 */
+#define  SPI_CR1_BR_2                        ((uint16_t)0x0020)            /*!< Bit 2 */
+#define  SPI_CR1_SPE                         ((uint16_t)0x0040)            /*!< SPI Enable */
+#define  SPI_CR1_LSBFIRST                    ((uint16_t)0x0080)            /*!< Frame Format */
+#define  SPI_CR1_SSI                         ((uint16_t)0x0100)            /*!< Internal slave select */
+#define  SPI_CR1_SSM                         ((uint16_t)0x0200)            /*!< Software slave management */
+#define  SPI_CR1_RXONLY                      ((uint16_t)0x0400)            /*!< Receive only */
+#define  SPI_CR1_DFF                         ((uint16_t)0x0800)            /*!< Data Frame Format */
+#define  SPI_CR1_BIDIOE                      ((uint16_t)0x4000)            /*!< Output enable in bidirectional mode */
+#define  SPI_CR1_BIDIMODE                    ((uint16_t)0x8000)            /*!< Bidirectional data mode enable */
+
+#define  SPI_CR2_RXDMAEN                     ((uint8_t)0x01)               /*!< Rx Buffer DMA Enable */
+#define  SPI_CR2_TXDMAEN                     ((uint8_t)0x02)               /*!< Tx Buffer DMA Enable */
+
+#define  SPI_SR_RXNE                         ((uint8_t)0x01)               /*!< Receive buffer Not Empty */
+#define  SPI_SR_TXE                          ((uint8_t)0x02)               /*!< Transmit buffer Empty */
+#define  SPI_SR_OVR                          ((uint8_t)0x40)               /*!< Overrun flag */
+#define  SPI_SR_BSY                          ((uint8_t)0x80)               /*!< Busy flag */
+
+#define  USART_SR_ORE                        ((uint16_t)0x0008)            /*!< OverRun Error */
+#define  USART_SR_TC                         ((uint16_t)0x0040)            /*!< Transmission Complete */
+#define  USART_SR_TXE                        ((uint16_t)0x0080)            /*!< Transmit Data Register Empty */
+#define  USART_CR3_DMAR                      ((uint16_t)0x0040)            /*!< DMA Enable Receiver */
+
+#endif
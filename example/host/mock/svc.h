@@ -0,0 +1,3 @@
+// Host replacement for utils/svc.h, semihosting calls go to stdout
+void *svcCall(int command, const void *message);
+void svcWrite0(const char *message);
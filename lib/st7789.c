@@ -3,53 +3,127 @@
 #include <svc.h>
 
 #include "st7789.h"
+#include "st7789_stats.h"
+#include "st7789_power.h"
 
 
-#define LCD_FILL_BUFFER_SIZE 64
+// Logical size and address of glass origin for current MADCTL, mirrored
+// axis counts offset of glass from the other end of frame memory
+static void st7789_UpdateGeometry(st7789_Device *device) {
+	uint16_t column = device->colOffset;
+	uint16_t row = device->rowOffset;
+	if (device->madctl & ST7789_MADCTL_MX) {
+		column = ST7789_GRAM_WIDTH - device->colOffset - device->panelWidth;
+	}
+	if (device->madctl & ST7789_MADCTL_MY) {
+		row = ST7789_GRAM_HEIGHT - device->rowOffset - device->panelHeight;
+	}
+	if (device->madctl & ST7789_MADCTL_MV) {
+		device->width = device->panelHeight;
+		device->height = device->panelWidth;
+		device->xOffset = row;
+		device->yOffset = column;
+	}
+	else {
+		device->width = device->panelWidth;
+		device->height = device->panelHeight;
+		device->xOffset = column;
+		device->yOffset = row;
+	}
+}
+
+
+// Copies wiring, pins and SPI have to be configured by application. Queue,
+// vsync and power governor are attached by their init functions. Enables
+// DWT cycle counter used by st7789_Ticks.
+void st7789_DeviceInit(st7789_Device *device, const st7789_Config *config) {
+	uint8_t flagShift = (uint8_t)((config->dmaChannel - 1) * 4);
+	device->spi = config->spi;
+	device->dmaController = config->dmaController;
+	device->dma = config->dma;
+	device->dmaIRQn = config->dmaIRQn;
+	device->dmaFlagTC = (uint32_t)DMA_ISR_TCIF1 << flagShift;
+	device->dmaFlagClear = (uint32_t)DMA_IFCR_CGIF1 << flagShift;
+	device->rxDma = config->rxDma;
+	device->busPrescaler = config->busPrescaler;
+	device->dcPort = config->dcPort;
+	device->dcPin = config->dcPin;
+	device->rstPort = config->rstPort;
+	device->rstPin = config->rstPin;
+	device->panelWidth = config->width;
+	device->panelHeight = config->height;
+	device->colOffset = config->colOffset;
+	device->rowOffset = config->rowOffset;
+	device->madctl = config->orientation;
+	st7789_UpdateGeometry(device);
+	device->pixelFormat = ST7789_PIXEL_FORMAT_RGB565;
+	device->packBuffer = NULL;
+	device->packPixels = 0;
+	device->packIndex = 0;
+	device->scrollTop = 0;
+	device->scrollHeight = 0;
+	device->scrollOffset = 0;
+	device->windowValid = false;
+	device->queue = NULL;
+	device->vsync = NULL;
+	device->power = NULL;
+#ifdef ST7789_STATS
+	device->stats = NULL;
+#endif
+
+	// Cycle counter is the time base
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+// CPU cycle counter, time base of delays, vsync and statistics. Weak
+// attribute to allow SysTick or timer based override.
+uint32_t __attribute__((weak)) st7789_Ticks(void) {
+	return DWT->CYCCNT;
+}
 
 
 // Weak attribute to allow override
 void __attribute__((weak)) st7789_WaitNanosecs(uint32_t ns) {
-	int ctr = ((ST7789_PRESCALER * ST7789_OSC_MHZ) * ns / 6);
-	while (ctr) {
-		__asm__ volatile ("nop");
-		--ctr;
-	}
+	uint32_t ticks = (uint32_t)((uint64_t)ns * ST7789_TICKS_PER_MS / 1000000);
+	uint32_t start = st7789_Ticks();
+	while (st7789_Ticks() - start < ticks);
 }
 
 
-void st7789_Reset(void) {
-	ST7789_RST_PORT->ODR &= ~ST7789_RST_PIN;
+void st7789_Reset(st7789_Device *device) {
+	device->rstPort->ODR &= ~device->rstPin;
 	st7789_WaitNanosecs(10000); // Reset pulse time
-	ST7789_RST_PORT->ODR |= ST7789_RST_PIN;
-	st7789_WaitNanosecs(120000); // Maximum time of blanking sequence
+	device->rstPort->ODR |= device->rstPin;
+	st7789_WaitNanosecs(120000000); // Maximum time of blanking sequence
 }
 
 
-void st7789_StartCommand(void) {
+void st7789_StartCommand(st7789_Device *device) {
 	//st7789_WaitNanosecs(10); //  D/CX setup time
-	ST7789_DC_PORT->ODR &= ~ST7789_DC_PIN;
+	device->dcPort->ODR &= ~device->dcPin;
 }
 
 
-void st7789_StartData(void) {
+void st7789_StartData(st7789_Device *device) {
 	//st7789_WaitNanosecs(10); //  D/CX setup time
-	ST7789_DC_PORT->ODR |= ST7789_DC_PIN;
+	device->dcPort->ODR |= device->dcPin;
 }
 
 
-void st7789_WriteSpi(uint8_t data) {
+void st7789_WriteSpi(st7789_Device *device, uint8_t data) {
 	for (int32_t i = 0; i<10000; i++) {
-		if (ST7789_SPI->SR & SPI_SR_TXE) break;
+		if (device->spi->SR & SPI_SR_TXE) break;
 	}
-	ST7789_SPI->DR = data;
-	while (ST7789_SPI->SR & SPI_SR_BSY);
+	device->spi->DR = data;
+	while (device->spi->SR & SPI_SR_BSY);
 }
 
 
-void st7789_ReadSpi(uint8_t *data, size_t length) {
+void st7789_ReadSpi(st7789_Device *device, uint8_t *data, size_t length) {
 	// Disable SPI output
-	ST7789_SPI->CR1 &= ~(SPI_CR1_BIDIOE);
+	device->spi->CR1 &= ~(SPI_CR1_BIDIOE);
 	uint8_t dummy = 0;
 
 	/*
@@ -64,185 +138,669 @@ void st7789_ReadSpi(uint8_t *data, size_t length) {
 	*/
 
 	while (length--) {
-		while (!(ST7789_SPI->SR & SPI_SR_TXE));
-		ST7789_SPI->DR = dummy;
-		while (!(ST7789_SPI->SR & SPI_SR_RXNE));
-		*data++ = ST7789_SPI->DR;
+		while (!(device->spi->SR & SPI_SR_TXE));
+		device->spi->DR = dummy;
+		while (!(device->spi->SR & SPI_SR_RXNE));
+		*data++ = device->spi->DR;
 	}
-	while (ST7789_SPI->SR & SPI_SR_BSY);
+	while (device->spi->SR & SPI_SR_BSY);
 
 	// Enable SPI output
-	ST7789_SPI->CR1 |= SPI_CR1_BIDIOE;
+	device->spi->CR1 |= SPI_CR1_BIDIOE;
+}
+
+
+void __attribute__((weak)) st7789_WriteDMA(st7789_Device *device, void *data, uint16_t length) {
+	device->dma->CCR =  (DMA_CCR1_MINC | DMA_CCR1_DIR); // Memory increment, direction to peripherial
+	device->dma->CMAR  = (uint32_t)(uintptr_t)data; // Source address
+	device->dma->CPAR  = (uint32_t)(uintptr_t)&device->spi->DR; // Destination address
+	device->dma->CNDTR = length;
+	ST7789_STATS_DMA_START(device, length);
+	device->spi->CR1 &= ~(SPI_CR1_SPE);  // Disable SPI
+	device->spi->CR2 |= SPI_CR2_TXDMAEN; // Enable DMA transfer
+	device->spi->CR1 |= SPI_CR1_SPE;     // Enable SPI
+	device->dma->CCR |= DMA_CCR1_EN;     // Start DMA transfer
 }
 
 
-void __attribute__((weak)) st7789_WriteDMA(void *data, uint16_t length) {
-	ST7789_DMA->CCR =  (DMA_CCR1_MINC | DMA_CCR1_DIR); // Memory increment, direction to peripherial
-	ST7789_DMA->CMAR  = (uint32_t)data; // Source address
-	ST7789_DMA->CPAR  = (uint32_t)&ST7789_SPI->DR; // Destination address
-	ST7789_DMA->CNDTR = length;
-	ST7789_SPI->CR1 &= ~(SPI_CR1_SPE);  // Disable SPI
-	ST7789_SPI->CR2 |= SPI_CR2_TXDMAEN; // Enable DMA transfer
-	ST7789_SPI->CR1 |= SPI_CR1_SPE;     // Enable SPI
-	ST7789_DMA->CCR |= DMA_CCR1_EN;     // Start DMA transfer
+// Repeats word in 16 bit frames without memory increment, SPI has to be in
+// 16 bit mode with TX DMA enabled
+static void st7789_StartFillDMA(st7789_Device *device, const uint16_t *word, uint16_t count) {
+	device->dma->CCR = (DMA_CCR1_DIR | DMA_CCR1_MSIZE_0 | DMA_CCR1_PSIZE_0); // 16 bit, no increment
+	device->dma->CMAR  = (uint32_t)(uintptr_t)word;
+	device->dma->CPAR  = (uint32_t)(uintptr_t)&device->spi->DR;
+	device->dma->CNDTR = count;
+	device->dma->CCR |= DMA_CCR1_EN;
+	ST7789_STATS_DMA_START(device, (uint32_t)count * 2);
 }
 
 
-void st7789_WaitForDMA(void) {
-	while(ST7789_DMA->CNDTR);
+void st7789_WaitForDMA(st7789_Device *device) {
+	ST7789_STATS_TICKS(start);
+	while(device->dma->CNDTR);
+	ST7789_STATS_DMA_DONE(device);
+	st7789_WaitForSpi(device);
+	ST7789_STATS_ADD(device, ST7789_STATS_WAIT, start);
+}
+
+
+void st7789_WaitForSpi(st7789_Device *device) {
+	// Last bytes are still in SPI, wait before D/CX change or SPI disable
+	while (!(device->spi->SR & SPI_SR_TXE));
+	while (device->spi->SR & SPI_SR_BSY);
+}
+
+// Bytes follow each other on wire, BSY is checked only after last one
+static void st7789_WriteSpiBurst(st7789_Device *device, const uint8_t *data, size_t length) {
+	while (length--) {
+		while (!(device->spi->SR & SPI_SR_TXE));
+		device->spi->DR = *data++;
+	}
+	st7789_WaitForSpi(device);
 }
 
-void st7789_ReadCommand(uint8_t command, void *data, size_t length) {
-	st7789_StartCommand();
-	st7789_WriteSpi(command);
-	st7789_StartData();
-	st7789_ReadSpi((void *)data, length);
+
+void st7789_ReadCommand(st7789_Device *device, uint8_t command, void *data, size_t length) {
+	st7789_StartCommand(device);
+	st7789_WriteSpi(device, command);
+	st7789_StartData(device);
+	st7789_ReadSpi(device, (uint8_t *)data, length);
 }
 
 
-void st7789_WriteCommand(uint8_t command, const void *data, size_t length) {
-	st7789_StartCommand();
-	st7789_WriteSpi(command);
-	st7789_StartData();
-	for (size_t i = 0; i < length; ++i) {
-		st7789_WriteSpi(((const uint8_t *)data)[i]);
+void st7789_WriteCommand(st7789_Device *device, uint8_t command, const void *data, size_t length) {
+	ST7789_STATS_TICKS(start);
+	st7789_StartCommand(device);
+	st7789_WriteSpi(device, command);
+	st7789_StartData(device);
+	if (length > 0) {
+		st7789_WriteSpiBurst(device, (const uint8_t *)data, length);
 	}
+	ST7789_STATS_ADD(device, ST7789_STATS_COMMAND, start);
 }
 
 
-void st7789_RunCommand(const st7789_Command *command) {
-	st7789_StartCommand();
-	st7789_WriteSpi(command->command);
+// Command and parameters without delay
+static void st7789_SendCommand(st7789_Device *device, const st7789_Command *command) {
+	ST7789_STATS_TICKS(start);
+	st7789_StartCommand(device);
+	st7789_WriteSpi(device, command->command);
 	if (command->dataSize > 0) {
-		st7789_StartData();
-		for (uint8_t i = 0; i < command->dataSize; ++i) {
-			st7789_WriteSpi(command->data[i]);
-		}
+		st7789_StartData(device);
+		st7789_WriteSpiBurst(device, command->data, command->dataSize);
 	}
+	ST7789_STATS_ADD(device, ST7789_STATS_COMMAND, start);
+}
+
+
+void st7789_RunCommand(st7789_Device *device, const st7789_Command *command) {
+	st7789_SendCommand(device, command);
 	if (command->waitMs > 0) {
-		st7789_WaitNanosecs(command->waitMs * 1000);
+		st7789_WaitNanosecs(command->waitMs * 1000000u);
 	}
 }
 
 
-void st7789_RunCommands(const st7789_Command *sequence) {
+void st7789_RunCommands(st7789_Device *device, const st7789_Command *sequence) {
 	while (sequence->command != ST7789_CMDLIST_END) {
-		st7789_RunCommand(sequence);
+		st7789_RunCommand(device, sequence);
 		sequence++;
 	}
 }
 
 
-void st7789_Init_1_3_LCD(void) {
-	// Resolution
-	const uint8_t caset[4] = {
-		0x00,
-		0x00,
-		(ST7789_LCD_WIDTH - 1) >> 8,
-		(ST7789_LCD_WIDTH - 1) & 0xff
-	};
-	const uint8_t raset[4] = {
-		0x00,
-		0x00,
-		(ST7789_LCD_HEIGHT - 1) >> 8,
-		(ST7789_LCD_HEIGHT - 1) & 0xff
-	};
-	const st7789_Command initSequence[] = {
-		// Sleep
-		{ST7789_CMD_SLPIN, 10, 0, NULL},                    // Sleep
-		{ST7789_CMD_SWRESET, 200, 0, NULL},                 // Reset
-		{ST7789_CMD_SLPOUT, 120, 0, NULL},                  // Sleep out
-		{ST7789_CMD_MADCTL, 0, 1, (const uint8_t *)"\x00"}, // Page / column address order
-		{ST7789_CMD_COLMOD, 0, 1, (const uint8_t *)"\x55"}, // 16 bit RGB
-		{ST7789_CMD_INVON, 0, 0, NULL},                     // Inversion on
-		{ST7789_CMD_CASET, 0, 4, (const uint8_t *)&caset},  // Set width
-		{ST7789_CMD_RASET, 0, 4, (const uint8_t *)&raset},  // Set height
-		// Porch setting
-		{ST7789_CMD_PORCTRL, 0, 5, (const uint8_t *)"\x0c\x0c\x00\x33\x33"},
-		// Set VGH to 13.26V and VGL to -10.43V
-		{ST7789_CMD_GCTRL, 0, 1, (const uint8_t *)"\x35"},
-		// Set VCOM to 1.675V
-		{ST7789_CMD_VCOMS, 0, 1, (const uint8_t *)"\x1f"},
-		// LCM control
-		{ST7789_CMD_LCMCTRL, 0, 1, (const uint8_t *)"\x2c"},
-		// VDV/VRH command enable
-		{ST7789_CMD_VDVVRHEN, 0, 2, (const uint8_t *)"\x01\xc3"},
-		// VDV set to default value
-		{ST7789_CMD_VDVSET, 0, 1, (const uint8_t *)"\x20"},
-		 // Set frame rate to 60Hz
-		{ST7789_CMD_FRCTR2, 0, 1, (const uint8_t *)"\x0f"},
-		// Set VDS to 2.3V, AVCL to -4.8V and AVDD to 6.8V
-		{ST7789_CMD_PWCTRL1, 0, 2, (const uint8_t *)"\xa4\xa1"},
-		// Gamma corection
-		//{ST7789_CMD_PVGAMCTRL, 0, 14, (const uint8_t *)"\xd0\x08\x11\x08\x0c\x15\x39\x33\x50\x36\x13\x14\x29\x2d"},
-		//{ST7789_CMD_NVGAMCTRL, 0, 14, (const uint8_t *)"\xd0\x08\x10\x08\x06\x06\x39\x44\x51\x0b\x16\x14\x2f\x31"},
-		// Little endian
-		{ST7789_CMD_RAMCTRL, 0, 2, (const uint8_t *)"\x00\x08"},
-		{ST7789_CMDLIST_END, 0, 0, NULL},                   // End of commands
-	};
-	st7789_RunCommands(initSequence);
-	st7789_Clear(0x0000);
-	const st7789_Command initSequence2[] = {
-		{ST7789_CMD_DISPON, 100, 0, NULL},                  // Display on
-		{ST7789_CMD_SLPOUT, 100, 0, NULL},                  // Sleep out
-		{ST7789_CMD_TEON, 0, 0, NULL},                      // Tearing line effect on
-		{ST7789_CMDLIST_END, 0, 0, NULL},                   // End of commands
-	};
-	st7789_RunCommands(initSequence2);
+// Panel setup before clear, address window is set by clear and MADCTL of
+// device follows
+static const st7789_Command st7789_initSequence[] = {
+	// Sleep
+	{ST7789_CMD_SLPIN, 10, 0, NULL},                    // Sleep
+	{ST7789_CMD_SWRESET, 200, 0, NULL},                 // Reset
+	{ST7789_CMD_SLPOUT, 120, 0, NULL},                  // Sleep out
+	{ST7789_CMD_COLMOD, 0, 1, (const uint8_t *)"\x55"}, // 16 bit RGB
+	{ST7789_CMD_INVON, 0, 0, NULL},                     // Inversion on
+	// Porch setting
+	{ST7789_CMD_PORCTRL, 0, 5, (const uint8_t *)"\x0c\x0c\x00\x33\x33"},
+	// Set VGH to 13.26V and VGL to -10.43V
+	{ST7789_CMD_GCTRL, 0, 1, (const uint8_t *)"\x35"},
+	// Set VCOM to 1.675V
+	{ST7789_CMD_VCOMS, 0, 1, (const uint8_t *)"\x1f"},
+	// LCM control
+	{ST7789_CMD_LCMCTRL, 0, 1, (const uint8_t *)"\x2c"},
+	// VDV/VRH command enable
+	{ST7789_CMD_VDVVRHEN, 0, 2, (const uint8_t *)"\x01\xc3"},
+	// VDV set to default value
+	{ST7789_CMD_VDVSET, 0, 1, (const uint8_t *)"\x20"},
+	 // Set frame rate to 60Hz
+	{ST7789_CMD_FRCTR2, 0, 1, (const uint8_t *)"\x0f"},
+	// Set VDS to 2.3V, AVCL to -4.8V and AVDD to 6.8V
+	{ST7789_CMD_PWCTRL1, 0, 2, (const uint8_t *)"\xa4\xa1"},
+	// Gamma corection
+	//{ST7789_CMD_PVGAMCTRL, 0, 14, (const uint8_t *)"\xd0\x08\x11\x08\x0c\x15\x39\x33\x50\x36\x13\x14\x29\x2d"},
+	//{ST7789_CMD_NVGAMCTRL, 0, 14, (const uint8_t *)"\xd0\x08\x10\x08\x06\x06\x39\x44\x51\x0b\x16\x14\x2f\x31"},
+	// Little endian
+	{ST7789_CMD_RAMCTRL, 0, 2, (const uint8_t *)"\x00\x08"},
+	{ST7789_CMDLIST_END, 0, 0, NULL},                   // End of commands
+};
+
+static const st7789_Command st7789_displaySequence[] = {
+	{ST7789_CMD_DISPON, 100, 0, NULL},                  // Display on
+	{ST7789_CMD_SLPOUT, 100, 0, NULL},                  // Sleep out
+	{ST7789_CMD_TEON, 0, 0, NULL},                      // Tearing line effect on
+	{ST7789_CMDLIST_END, 0, 0, NULL},                   // End of commands
+};
+
+
+static void st7789_InitDevice(st7789_Device *device) {
+	device->pixelFormat = ST7789_PIXEL_FORMAT_RGB565;
+	device->scrollHeight = 0;
+	device->scrollOffset = 0;
+	st7789_InvalidateWindow(device);
+}
+
+
+void st7789_Init_1_3_LCD(st7789_Device *device) {
+	st7789_InitDevice(device);
+	st7789_RunCommands(device, st7789_initSequence);
+	st7789_WriteCommand(device, ST7789_CMD_MADCTL, &device->madctl, 1);
+	st7789_Clear(device, 0x0000);
+	st7789_RunCommands(device, st7789_displaySequence);
+}
+
+
+enum {
+	ST7789_INIT_RESET,    // Reset pulse, then blanking after reset
+	ST7789_INIT_COMMANDS, // st7789_initSequence
+	ST7789_INIT_CLEAR,    // DMA chunks of clear
+	ST7789_INIT_DISPLAY,  // st7789_displaySequence
+	ST7789_INIT_DONE,
+};
+
+
+static void st7789_InitDelay(st7789_InitState *state, uint32_t ticks) {
+	state->waitStart = st7789_Ticks();
+	state->waitTicks = ticks;
+}
+
+
+// Sends next command of sequence and starts its delay, false at end
+static bool st7789_InitCommand(st7789_Device *device, st7789_InitState *state, const st7789_Command *sequence) {
+	const st7789_Command *command = &sequence[state->index];
+	if (command->command == ST7789_CMDLIST_END) {
+		state->index = 0;
+		return false;
+	}
+	st7789_SendCommand(device, command);
+	st7789_InitDelay(state, command->waitMs * ST7789_TICKS_PER_MS);
+	state->index++;
+	return true;
+}
+
+
+// Hardware reset and st7789_Init_1_3_LCD without blocking, continued by
+// st7789_InitPoll
+void st7789_InitStart(st7789_Device *device, st7789_InitState *state) {
+	st7789_InitDevice(device);
+	state->stage = ST7789_INIT_RESET;
+	state->index = 0;
+	state->clearRemaining = 0;
+	state->clearWord = 0x0000;
+	device->rstPort->ODR &= ~device->rstPin;
+	st7789_InitDelay(state, ST7789_TICKS_PER_MS / 100); // Reset pulse time
+}
+
+
+// Does at most one step and returns true once panel is ready. Call from
+// main loop or periodic timer interrupt, device must not be used by
+// anything else until then.
+bool st7789_InitPoll(st7789_Device *device, st7789_InitState *state) {
+	if (st7789_Ticks() - state->waitStart < state->waitTicks) {
+		return false;
+	}
+	state->waitTicks = 0;
+	switch (state->stage) {
+		case ST7789_INIT_RESET:
+			device->rstPort->ODR |= device->rstPin;
+			st7789_InitDelay(state, 120 * ST7789_TICKS_PER_MS); // Maximum time of blanking sequence
+			state->stage = ST7789_INIT_COMMANDS;
+			break;
+		case ST7789_INIT_COMMANDS:
+			if (!st7789_InitCommand(device, state, st7789_initSequence)) {
+				st7789_WriteCommand(device, ST7789_CMD_MADCTL, &device->madctl, 1);
+				st7789_SetWindow(device, 0, 0, device->width - 1, device->height - 1);
+				st7789_Set16BitMode(device, true);
+				device->spi->CR2 |= SPI_CR2_TXDMAEN;
+				state->clearRemaining = (uint32_t)device->width * device->height;
+				state->stage = ST7789_INIT_CLEAR;
+			}
+			break;
+		case ST7789_INIT_CLEAR:
+			if (device->dma->CNDTR) {
+				return false;
+			}
+			if (state->clearRemaining > 0) {
+				uint16_t transferSize = (state->clearRemaining > 0xffff) ? 0xffff : (uint16_t)state->clearRemaining;
+				st7789_StartFillDMA(device, &state->clearWord, transferSize);
+				state->clearRemaining -= transferSize;
+				return false;
+			}
+			ST7789_STATS_DMA_DONE(device);
+			st7789_Set16BitMode(device, false);
+			state->stage = ST7789_INIT_DISPLAY;
+			break;
+		case ST7789_INIT_DISPLAY:
+			if (!st7789_InitCommand(device, state, st7789_displaySequence)) {
+				state->stage = ST7789_INIT_DONE;
+			}
+			break;
+		default:
+			break;
+	}
+	return state->stage == ST7789_INIT_DONE;
+}
+
+
+// Restarts at first row of address window set on panel
+void st7789_StartMemoryWrite(st7789_Device *device) {
+	st7789_InvalidateWindow(device);
+	st7789_StartCommand(device);
+	st7789_WriteSpi(device, ST7789_CMD_RAMWR);
+	st7789_StartData(device);
+}
+
+
+// Rows are translated through scroll offset, window must not cross wrap
+// of scroll area (see st7789_ScrollContiguousRows). Offsets of orientation
+// are added to both axes, MADCTL does the rotation. CASET / RASET already
+// set on panel are skipped, window starting at row where previous one ended
+// only continues with RAMWRC. Window has to be written completely, otherwise
+// call st7789_InvalidateWindow before next one.
+void st7789_SetWindow(st7789_Device *device, uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd) {
+	ST7789_STATS_TICKS(start);
+	if (device->power != NULL) {
+		st7789_PowerActivity(device);
+	}
+	uint16_t row = st7789_TranslateRow(device, yStart) + device->yOffset;
+	yEnd = row + (yEnd - yStart);
+	yStart = row;
+	xStart += device->xOffset;
+	xEnd += device->xOffset;
+	bool columns = device->windowValid && xStart == device->windowXStart && xEnd == device->windowXEnd;
+	bool rows = device->windowValid && yEnd <= device->windowYEnd;
+	uint8_t command = ST7789_CMD_RAMWR;
+	if (columns && rows && yStart == device->windowNextRow) {
+		command = ST7789_CMD_RAMWRC;
+	}
+	else {
+		if (!columns) {
+			uint8_t caset[4] = {
+				(uint8_t)(xStart >> 8),
+				(uint8_t)(xStart & 0xff),
+				(uint8_t)(xEnd >> 8),
+				(uint8_t)(xEnd & 0xff),
+			};
+			st7789_WriteCommand(device, ST7789_CMD_CASET, caset, sizeof(caset));
+			device->windowXStart = xStart;
+			device->windowXEnd = xEnd;
+		}
+		if (!rows || yStart != device->windowYStart) {
+			// Window ends at last row to allow continuation of rows below
+			uint16_t bottom = device->yOffset + device->height - 1;
+			uint16_t lastRow = (yEnd > bottom) ? yEnd : bottom;
+			uint8_t raset[4] = {
+				(uint8_t)(yStart >> 8),
+				(uint8_t)(yStart & 0xff),
+				(uint8_t)(lastRow >> 8),
+				(uint8_t)(lastRow & 0xff),
+			};
+			st7789_WriteCommand(device, ST7789_CMD_RASET, raset, sizeof(raset));
+			device->windowYStart = yStart;
+			device->windowYEnd = lastRow;
+		}
+		device->windowValid = true;
+	}
+	st7789_WriteCommand(device, command, NULL, 0);
+	// Odd RGB444 window leaves half of pixel pair in panel
+	uint32_t pixels = (uint32_t)(xEnd - xStart + 1) * (yEnd - yStart + 1);
+	if (device->pixelFormat == ST7789_PIXEL_FORMAT_RGB444 && (pixels & 1)) {
+		device->windowNextRow = 0xffff;
+	}
+	else {
+		device->windowNextRow = yEnd + 1;
+	}
+	ST7789_STATS_ADD(device, ST7789_STATS_WINDOW, start);
+}
+
+
+// Next st7789_SetWindow sends full CASET / RASET / RAMWR, needed after
+// window was not written completely or commands were sent directly
+void st7789_InvalidateWindow(st7789_Device *device) {
+	device->windowValid = false;
 }
 
 
-void st7789_StartMemoryWrite(void) {
-	st7789_StartCommand();
-	st7789_WriteSpi(ST7789_CMD_RAMWR);
-	st7789_StartData();
+// MADCTL and window are set on panel, content drawn before keeps its place
+// on glass. Scroll area is dropped. Queue has to be flushed.
+void st7789_SetOrientation(st7789_Device *device, uint8_t madctl) {
+	st7789_SetScroll(device, 0);
+	device->scrollHeight = 0;
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_MADCTL, &madctl, 1);
+	device->madctl = madctl;
+	st7789_UpdateGeometry(device);
+	st7789_InvalidateWindow(device);
 }
 
 
-void st7789_SetWindow(uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd) {
-	uint8_t caset[4];
-	uint8_t raset[4];
-	caset[0] = (uint8_t)(xStart >> 8);
-	caset[1] = (uint8_t)(xStart & 0xff);
-	caset[2] = (uint8_t)(xEnd >> 8);
-	caset[3] = (uint8_t)(xEnd & 0xff);
-	raset[0] = (uint8_t)(yStart >> 8);
-	raset[1] = (uint8_t)(yStart & 0xff);
-	raset[2] = (uint8_t)(yEnd >> 8);
-	raset[3] = (uint8_t)(yEnd & 0xff);
-	st7789_Command sequence[] = {
-		{ST7789_CMD_CASET, 0, 4, caset},
-		{ST7789_CMD_RASET, 0, 4, raset},
-		{ST7789_CMD_RAMWR, 0, 0, NULL},
-		{ST7789_CMDLIST_END, 0, 0, NULL},
+uint8_t st7789_GetOrientation(const st7789_Device *device) {
+	return device->madctl;
+}
+
+
+// Frame memory row of first scrolling row, MY turns scroll area upside down
+static uint16_t st7789_ScrollMemoryTop(const st7789_Device *device) {
+	if (device->madctl & ST7789_MADCTL_MY) {
+		return ST7789_GRAM_HEIGHT - device->yOffset - device->scrollTop - device->scrollHeight;
+	}
+	return device->yOffset + device->scrollTop;
+}
+
+
+// Display rows [top, height - bottom) scroll, other rows are
+// fixed. Bottom fixed area of frame memory includes rows below the glass.
+// Panel scrolls frame memory rows, orientations with MV can't scroll.
+// Fixed areas have to leave at least one scrolling row.
+void st7789_SetScrollArea(st7789_Device *device, uint16_t top, uint16_t bottom) {
+	if ((device->madctl & ST7789_MADCTL_MV) || (uint32_t)top + bottom >= device->height) {
+		return;
+	}
+	uint16_t height = device->height - top - bottom;
+	st7789_WaitForDMA(device);
+	device->scrollTop = top;
+	device->scrollHeight = height;
+	uint16_t fixedTop = st7789_ScrollMemoryTop(device);
+	uint16_t fixedBottom = ST7789_GRAM_HEIGHT - fixedTop - height;
+	uint8_t params[6] = {
+		(uint8_t)(fixedTop >> 8),
+		(uint8_t)(fixedTop & 0xff),
+		(uint8_t)(height >> 8),
+		(uint8_t)(height & 0xff),
+		(uint8_t)(fixedBottom >> 8),
+		(uint8_t)(fixedBottom & 0xff),
 	};
-	st7789_StartCommand();
-	st7789_RunCommands(sequence);
-	st7789_StartData();
+	st7789_WriteCommand(device, ST7789_CMD_VSCRDEF, params, sizeof(params));
+	st7789_SetScroll(device, 0);
 }
 
 
-void st7789_FillArea(uint16_t color, uint16_t startX, uint16_t startY, uint16_t width, uint16_t height) {
-	uint16_t buf[LCD_FILL_BUFFER_SIZE];
-	for (size_t i = 0; i < LCD_FILL_BUFFER_SIZE; i++) {
-		buf[i] = color;
+// Row at top of scroll area shows content drawn at top + offset
+void st7789_SetScroll(st7789_Device *device, uint16_t offset) {
+	if (device->scrollHeight == 0) {
+		return;
+	}
+	if (device->power != NULL) {
+		st7789_PowerActivity(device);
 	}
-	st7789_SetWindow(startX, startY, startX + width - 1, startY + height - 1);
-	size_t bytestToWrite = width * height * 2;
-	uint16_t transferSize = (uint16_t)LCD_FILL_BUFFER_SIZE * 2;
-	while (bytestToWrite > 0) {
-		if (bytestToWrite < transferSize) {
-			transferSize = bytestToWrite;
+	offset %= device->scrollHeight;
+	// Content moves against memory rows when they are mirrored
+	uint16_t start = st7789_ScrollMemoryTop(device);
+	start += (device->madctl & ST7789_MADCTL_MY) ? (device->scrollHeight - offset) % device->scrollHeight : offset;
+	uint8_t params[2] = {(uint8_t)(start >> 8), (uint8_t)(start & 0xff)};
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_VSCRSADD, params, sizeof(params));
+	device->scrollOffset = offset;
+}
+
+
+uint16_t st7789_GetScroll(const st7789_Device *device) {
+	return device->scrollOffset;
+}
+
+
+// Frame memory row of display row
+uint16_t st7789_TranslateRow(const st7789_Device *device, uint16_t y) {
+	uint16_t offset = y - device->scrollTop;
+	if (y < device->scrollTop || offset >= device->scrollHeight) {
+		return y;
+	}
+	offset += device->scrollOffset;
+	if (offset >= device->scrollHeight) {
+		offset -= device->scrollHeight;
+	}
+	return device->scrollTop + offset;
+}
+
+
+// Number of rows from y (at most height) which stay contiguous in frame
+// memory, windows have to be split there
+uint16_t st7789_ScrollContiguousRows(const st7789_Device *device, uint16_t y, uint16_t height) {
+	uint16_t limit;
+	uint16_t scrollEnd = device->scrollTop + device->scrollHeight;
+	if (device->scrollHeight == 0 || y >= scrollEnd) {
+		return height;
+	}
+	if (y < device->scrollTop) {
+		limit = device->scrollTop - y;
+	}
+	else {
+		uint16_t toWrap = scrollEnd - st7789_TranslateRow(device, y);
+		uint16_t toEnd = scrollEnd - y;
+		limit = (toWrap < toEnd) ? toWrap : toEnd;
+	}
+	return (height < limit) ? height : limit;
+}
+
+
+void st7789_Set16BitMode(st7789_Device *device, bool enable) {
+	st7789_WaitForSpi(device);
+	device->spi->CR1 &= ~(SPI_CR1_SPE);
+	if (enable) {
+		device->spi->CR1 |= SPI_CR1_DFF;
+	}
+	else {
+		device->spi->CR1 &= ~(SPI_CR1_DFF);
+	}
+	device->spi->CR1 |= SPI_CR1_SPE;
+}
+
+
+// RGB444 needs pack buffer of st7789_WritePixels (packSize of at least 6,
+// 2 * ST7789_PACK_BUFFER_SIZE recommended), format is not changed without
+// it. Buffer is used until next format change, RGB565 takes NULL.
+void st7789_SetPixelFormat(st7789_Device *device, st7789_PixelFormat format, uint8_t *packBuffer, uint16_t packSize) {
+	// Even pixel count per half, pairs are packed to 3 bytes
+	uint16_t packPixels = (packBuffer != NULL) ? (uint16_t)(packSize / 2 / 3 * 2) : 0;
+	if (format == ST7789_PIXEL_FORMAT_RGB444 && packPixels == 0) {
+		return;
+	}
+	uint8_t colmod = (uint8_t)format;
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_COLMOD, &colmod, 1);
+	device->pixelFormat = format;
+	device->packBuffer = packBuffer;
+	device->packPixels = packPixels;
+	device->packIndex = 0;
+}
+
+
+st7789_PixelFormat st7789_GetPixelFormat(const st7789_Device *device) {
+	return device->pixelFormat;
+}
+
+
+// Bytes on wire, odd pixel in RGB444 mode is sent in 2 bytes
+uint32_t st7789_PixelBytes(const st7789_Device *device, uint32_t count) {
+	if (device->pixelFormat == ST7789_PIXEL_FORMAT_RGB444) {
+		return (count * 3 + 1) / 2;
+	}
+	return count * 2;
+}
+
+
+// Upper bits of RGB565 channels, result is 0x0RGB
+uint16_t st7789_ColorToRGB444(uint16_t color) {
+	return (uint16_t)(((color >> 4) & 0x0f00) | ((color >> 3) & 0x00f0) | ((color >> 1) & 0x000f));
+}
+
+
+// Packs two pixels to three bytes, odd last pixel uses two bytes
+void st7789_PackRGB444(uint8_t *packed, const uint16_t *pixels, uint32_t count) {
+	while (count >= 2) {
+		uint16_t first = st7789_ColorToRGB444(pixels[0]);
+		uint16_t second = st7789_ColorToRGB444(pixels[1]);
+		packed[0] = (uint8_t)(first >> 4);
+		packed[1] = (uint8_t)((first << 4) | (second >> 8));
+		packed[2] = (uint8_t)second;
+		packed += 3;
+		pixels += 2;
+		count -= 2;
+	}
+	if (count) {
+		uint16_t last = st7789_ColorToRGB444(pixels[0]);
+		packed[0] = (uint8_t)(last >> 4);
+		packed[1] = (uint8_t)(last << 4);
+	}
+}
+
+
+// Starts DMA of pixels in current format and returns without waiting. In
+// RGB565 mode buffer is sent directly and must stay untouched until next
+// call or st7789_WaitForDMA. In RGB444 mode next chunk is packed while
+// previous one is sent, buffer can be reused after return. Count must be
+// even except for last call of memory write.
+void st7789_WritePixels(st7789_Device *device, const uint16_t *pixels, uint32_t count) {
+	if (device->pixelFormat == ST7789_PIXEL_FORMAT_RGB565) {
+		while (count > 0) {
+			uint16_t chunk = (count > 0x7fff) ? 0x7fff : (uint16_t)count;
+			st7789_WaitForDMA(device);
+			st7789_WriteDMA(device, (void *)pixels, chunk * 2);
+			pixels += chunk;
+			count -= chunk;
+		}
+		return;
+	}
+	while (count > 0) {
+		uint16_t chunk = (count > device->packPixels) ? device->packPixels : (uint16_t)count;
+		uint8_t *packed = device->packBuffer + device->packIndex * (device->packPixels * 3 / 2);
+		device->packIndex ^= 1;
+		st7789_PackRGB444(packed, pixels, chunk);
+		st7789_WaitForDMA(device);
+		st7789_WriteDMA(device, packed, (uint16_t)st7789_PixelBytes(device, chunk));
+		pixels += chunk;
+		count -= chunk;
+	}
+}
+
+
+// Three byte pattern of two pixels, single byte without memory increment if
+// all bytes are same (black, white, grays)
+static void st7789_FillDMA444(st7789_Device *device, uint16_t color, uint32_t count) {
+	uint8_t pattern[ST7789_PACK_BUFFER_SIZE];
+	uint16_t packed = st7789_ColorToRGB444(color);
+	uint32_t length = st7789_PixelBytes(device, count);
+	uint32_t flags = DMA_CCR1_DIR;
+	uint16_t maxTransfer = 0xffff;
+	pattern[0] = (uint8_t)(packed >> 4);
+	pattern[1] = (uint8_t)((packed << 4) | (packed >> 8));
+	pattern[2] = (uint8_t)packed;
+	if (pattern[0] != pattern[1] || pattern[1] != pattern[2]) {
+		for (size_t i = 3; i < sizeof(pattern); ++i) {
+			pattern[i] = pattern[i - 3];
 		}
-		bytestToWrite -= transferSize;
-		st7789_WriteDMA(&buf, transferSize);
-		st7789_WaitForDMA();
+		flags |= DMA_CCR1_MINC;
+		maxTransfer = sizeof(pattern);
+	}
+	device->spi->CR2 |= SPI_CR2_TXDMAEN;
+	ST7789_STATS_TICKS(start);
+	while (length > 0) {
+		uint16_t transferSize = (length > maxTransfer) ? maxTransfer : (uint16_t)length;
+		device->dma->CCR = flags;
+		device->dma->CMAR  = (uint32_t)(uintptr_t)pattern;
+		device->dma->CPAR  = (uint32_t)(uintptr_t)&device->spi->DR;
+		device->dma->CNDTR = transferSize;
+		device->dma->CCR |= DMA_CCR1_EN;
+		ST7789_STATS_DMA_START(device, transferSize);
+		while (device->dma->CNDTR);
+		length -= transferSize;
+	}
+	ST7789_STATS_DMA_DONE(device);
+	st7789_WaitForSpi(device);
+	ST7789_STATS_ADD(device, ST7789_STATS_WAIT, start);
+}
+
+
+void st7789_FillDMA(st7789_Device *device, uint16_t color, uint32_t count) {
+	if (device->pixelFormat == ST7789_PIXEL_FORMAT_RGB444) {
+		st7789_FillDMA444(device, color, count);
+		return;
+	}
+	// One word repeated without memory increment, SPI sends 16 bit frames MSB
+	// first and memory is little endian (RAMCTRL), so bytes are swapped
+	uint16_t word = (uint16_t)((color << 8) | (color >> 8));
+	st7789_Set16BitMode(device, true);
+	device->spi->CR2 |= SPI_CR2_TXDMAEN;
+	ST7789_STATS_TICKS(start);
+	while (count > 0) {
+		uint16_t transferSize = (count > 0xffff) ? 0xffff : (uint16_t)count;
+		st7789_StartFillDMA(device, &word, transferSize);
+		while (device->dma->CNDTR);
+		count -= transferSize;
+	}
+	ST7789_STATS_DMA_DONE(device);
+	st7789_Set16BitMode(device, false);
+	ST7789_STATS_ADD(device, ST7789_STATS_WAIT, start);
+}
+
+
+void st7789_FillArea(st7789_Device *device, uint16_t color, uint16_t startX, uint16_t startY, uint16_t width, uint16_t height) {
+	if (width == 0 || height == 0) {
+		return;
+	}
+	while (height > 0) {
+		uint16_t rows = st7789_ScrollContiguousRows(device, startY, height);
+		st7789_SetWindow(device, startX, startY, startX + width - 1, startY + rows - 1);
+		st7789_FillDMA(device, color, (uint32_t)width * rows);
+		startY += rows;
+		height -= rows;
+	}
+}
+
+
+void st7789_DrawHLine(st7789_Device *device, uint16_t color, uint16_t x, uint16_t y, uint16_t length) {
+	st7789_FillArea(device, color, x, y, length, 1);
+}
+
+
+void st7789_DrawVLine(st7789_Device *device, uint16_t color, uint16_t x, uint16_t y, uint16_t length) {
+	st7789_FillArea(device, color, x, y, 1, length);
+}
+
+
+void st7789_DrawRect(st7789_Device *device, uint16_t color, uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+	if (width == 0 || height == 0) {
+		return;
+	}
+	st7789_DrawHLine(device, color, x, y, width);
+	if (height > 1) {
+		st7789_DrawHLine(device, color, x, y + height - 1, width);
+	}
+	if (height > 2) {
+		st7789_DrawVLine(device, color, x, y + 1, height - 2);
+		if (width > 1) {
+			st7789_DrawVLine(device, color, x + width - 1, y + 1, height - 2);
+		}
+	}
+}
+
+
+void st7789_FillRects(st7789_Device *device, uint16_t color, const st7789_Rect *rects, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		st7789_FillArea(device, color, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
 	}
 }
 
 
-void st7789_Clear(uint16_t color) {
-	st7789_FillArea(color, 0, 0, ST7789_LCD_WIDTH, ST7789_LCD_HEIGHT);
+void st7789_Clear(st7789_Device *device, uint16_t color) {
+	st7789_FillArea(device, color, 0, 0, device->width, device->height);
 }
 
 
@@ -1,19 +1,56 @@
+#ifndef ST7789_H
+#define ST7789_H
+
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stm32f10x.h>
 
 
-#define ST7789_RST_PORT              GPIOA
-#define ST7789_RST_PIN               GPIO_ODR_ODR9
-#define ST7789_DC_PORT               GPIOA
-#define ST7789_DC_PIN                GPIO_ODR_ODR8
-#define ST7789_SPI                   SPI1
-#define ST7789_DMA                   DMA1_Channel3
+// SPI and DMA part of st7789_Config, TX and RX requests of SPI are hard
+// wired to DMA channels. Last value is HCLK / PCLK of the SPI bus for clock
+// setup of the examples (SPI1 on APB2, SPI2 on APB1 divided by 2).
+#define ST7789_SPI1_DMA              SPI1, DMA1, DMA1_Channel3, DMA1_Channel3_IRQn, 3, DMA1_Channel2, 1
+#define ST7789_SPI2_DMA              SPI2, DMA1, DMA1_Channel5, DMA1_Channel5_IRQn, 5, DMA1_Channel4, 2
 
 #define ST7789_PRESCALER             16
 #define ST7789_OSC_MHZ               8
+// st7789_Ticks per millisecond (CPU cycles)
+#define ST7789_TICKS_PER_MS          (ST7789_PRESCALER * ST7789_OSC_MHZ * 1000)
 
+// Panel of the examples (panel size is st7789_Config, width and height of
+// landscape orientation are swapped)
 #define ST7789_LCD_WIDTH             240
 #define ST7789_LCD_HEIGHT            240
+// Longest side of any geometry, static buffers hold this many pixels in
+// both directions to work in every orientation
+#define ST7789_MAX_SIZE              320
+// Frame memory size, scroll definition always covers all rows
+#define ST7789_GRAM_WIDTH            240
+#define ST7789_GRAM_HEIGHT           320
+
+// Geometry part of st7789_Config: glass size and its column / row offset
+// in frame memory, all with MADCTL 0
+#define ST7789_GEOMETRY_240X240      240, 240, 0, 0
+#define ST7789_GEOMETRY_135X240      135, 240, 52, 40
+#define ST7789_GEOMETRY_240X320      240, 320, 0, 0
+
+// MADCTL address order bits
+#define ST7789_MADCTL_MY             0x80 // Row address order
+#define ST7789_MADCTL_MX             0x40 // Column address order
+#define ST7789_MADCTL_MV             0x20 // Row / column exchange
+#define ST7789_MADCTL_BGR            0x08
+
+// Clockwise rotation of content, MX mirrors columns without MV and MY with MV
+#define ST7789_ORIENTATION_0         0x00
+#define ST7789_ORIENTATION_90        (ST7789_MADCTL_MV | ST7789_MADCTL_MX)
+#define ST7789_ORIENTATION_180       (ST7789_MADCTL_MX | ST7789_MADCTL_MY)
+#define ST7789_ORIENTATION_270       (ST7789_MADCTL_MV | ST7789_MADCTL_MY)
+
+// RGB444 pack buffer of 2 * ST7789_PACK_BUFFER_SIZE bytes packs this many
+// pixels per transfer (double buffered), fills use patterns of same size
+#define ST7789_PACK_BUFFER_PIXELS    240
+#define ST7789_PACK_BUFFER_SIZE      (ST7789_PACK_BUFFER_PIXELS * 3 / 2)
 
 // System Function Command Table 1
 #define ST7789_CMD_NOP               0x00 // No operation
@@ -109,21 +146,154 @@ typedef struct st7789_Command {
 	const uint8_t *data;
 } st7789_Command;
 
+// COLMOD value of pixel format used for memory writes
+typedef enum st7789_PixelFormat {
+	ST7789_PIXEL_FORMAT_RGB444 = 0x53, // 2 pixels in 3 bytes
+	ST7789_PIXEL_FORMAT_RGB565 = 0x55,
+} st7789_PixelFormat;
+
+typedef struct st7789_Rect {
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+} st7789_Rect;
+
+// Wiring and geometry of one panel
+typedef struct st7789_Config {
+	SPI_TypeDef *spi;
+	DMA_TypeDef *dmaController;
+	DMA_Channel_TypeDef *dma;
+	IRQn_Type dmaIRQn;
+	uint8_t dmaChannel; // Channel number of dma, selects ISR / IFCR flags
+	DMA_Channel_TypeDef *rxDma; // Used only by st7789_ReadWindow
+	uint8_t busPrescaler; // HCLK / PCLK of SPI bus, st7789_Ticks per bus clock
+	GPIO_TypeDef *dcPort;
+	uint16_t dcPin;
+	GPIO_TypeDef *rstPort;
+	uint16_t rstPin;
+	uint16_t width;     // Glass size and offsets with MADCTL 0 (ST7789_GEOMETRY_*)
+	uint16_t height;
+	uint16_t colOffset;
+	uint16_t rowOffset;
+	uint8_t orientation; // MADCTL sent by init (ST7789_ORIENTATION_*)
+} st7789_Config;
+
+struct st7789_Queue;
+struct st7789_Vsync;
+struct st7789_Stats;
+struct st7789_Power;
+
+// State of one panel, devices on different SPI and DMA channels can stream
+// at the same time
+typedef struct st7789_Device {
+	SPI_TypeDef *spi;
+	DMA_TypeDef *dmaController;
+	DMA_Channel_TypeDef *dma;
+	IRQn_Type dmaIRQn;
+	uint32_t dmaFlagTC;
+	uint32_t dmaFlagClear;
+	DMA_Channel_TypeDef *rxDma;
+	uint8_t busPrescaler;
+	GPIO_TypeDef *dcPort;
+	uint16_t dcPin;
+	GPIO_TypeDef *rstPort;
+	uint16_t rstPin;
+	uint16_t width;  // Logical size, swapped by MADCTL MV
+	uint16_t height;
+	uint16_t panelWidth;
+	uint16_t panelHeight;
+	uint16_t colOffset;
+	uint16_t rowOffset;
+	uint8_t madctl;
+	// CASET / RASET address of logical (0, 0), set by st7789_SetOrientation
+	uint16_t xOffset;
+	uint16_t yOffset;
+	st7789_PixelFormat pixelFormat;
+	uint8_t *packBuffer;  // Supplied by st7789_SetPixelFormat for RGB444
+	uint16_t packPixels;  // Pixels packed into one half of packBuffer
+	uint8_t packIndex;
+	// Scrolling rows [scrollTop, scrollTop + scrollHeight), 0 height if not used
+	uint16_t scrollTop;
+	uint16_t scrollHeight;
+	uint16_t scrollOffset;
+	// Address window set on panel (translated rows), see st7789_SetWindow
+	bool windowValid;
+	uint16_t windowXStart;
+	uint16_t windowXEnd;
+	uint16_t windowYStart;
+	uint16_t windowYEnd;
+	uint16_t windowNextRow; // Memory pointer row once last window is written
+	struct st7789_Queue *queue; // Set by st7789_QueueInit
+	struct st7789_Vsync *vsync; // Set by st7789_VsyncInit
+	struct st7789_Power *power; // Set by st7789_PowerInit
+#ifdef ST7789_STATS
+	struct st7789_Stats *stats; // Set by st7789_StatsInit
+#endif
+} st7789_Device;
+
+// Progress of st7789_InitStart / st7789_InitPoll
+typedef struct st7789_InitState {
+	uint8_t stage;
+	uint8_t index;           // Next command of current sequence
+	uint32_t waitStart;      // Delay measured by st7789_Ticks
+	uint32_t waitTicks;
+	uint32_t clearRemaining; // Clear pixels not yet given to DMA
+	uint16_t clearWord;
+} st7789_InitState;
+
+// Glyphs have height rows of (width + 7) / 8 bytes, least significant bit is
+// left pixel (uGUI FONT_TYPE_1BPP layout)
+typedef struct st7789_Font {
+	const uint8_t *data;
+	uint8_t width;
+	uint8_t height;
+	uint8_t firstChar;
+	uint8_t lastChar;
+} st7789_Font;
+
+void st7789_DeviceInit(st7789_Device *device, const st7789_Config *config);
+uint32_t st7789_Ticks(void);
 void st7789_WaitNanosecs(uint32_t nanosecs);
-void st7789_Reset(void);
-void st7789_StartCommand(void);
-void st7789_StartData(void);
-void st7789_WriteSpi(uint8_t data);
-void st7789_ReadSpi(uint8_t *data, size_t length);
-void st7789_WriteDMA(void *data, uint16_t length);
-void st7789_WaitForDMA(void);
-void st7789_ReadCommand(uint8_t command, void *data, size_t length);
-void st7789_WriteCommand(uint8_t command, const void *data, size_t length);
-void st7789_RunCommand(const st7789_Command *command);
-void st7789_RunCommands(const st7789_Command *sequence);
-void st7789_Init_1_3_LCD(void);
-void st7789_StartMemoryWrite(void);
-void st7789_SetWindow(uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd);
-void st7789_FillArea(uint16_t color, uint16_t startX, uint16_t startY, uint16_t width, uint16_t height);
-void st7789_Clear(uint16_t color);
+void st7789_Reset(st7789_Device *device);
+void st7789_StartCommand(st7789_Device *device);
+void st7789_StartData(st7789_Device *device);
+void st7789_WriteSpi(st7789_Device *device, uint8_t data);
+void st7789_ReadSpi(st7789_Device *device, uint8_t *data, size_t length);
+void st7789_WriteDMA(st7789_Device *device, void *data, uint16_t length);
+void st7789_WaitForDMA(st7789_Device *device);
+void st7789_WaitForSpi(st7789_Device *device);
+void st7789_ReadCommand(st7789_Device *device, uint8_t command, void *data, size_t length);
+void st7789_WriteCommand(st7789_Device *device, uint8_t command, const void *data, size_t length);
+void st7789_RunCommand(st7789_Device *device, const st7789_Command *command);
+void st7789_RunCommands(st7789_Device *device, const st7789_Command *sequence);
+void st7789_Init_1_3_LCD(st7789_Device *device);
+void st7789_InitStart(st7789_Device *device, st7789_InitState *state);
+bool st7789_InitPoll(st7789_Device *device, st7789_InitState *state);
+void st7789_StartMemoryWrite(st7789_Device *device);
+void st7789_SetWindow(st7789_Device *device, uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd);
+void st7789_InvalidateWindow(st7789_Device *device);
+void st7789_SetOrientation(st7789_Device *device, uint8_t madctl);
+uint8_t st7789_GetOrientation(const st7789_Device *device);
+void st7789_Set16BitMode(st7789_Device *device, bool enable);
+void st7789_SetPixelFormat(st7789_Device *device, st7789_PixelFormat format, uint8_t *packBuffer, uint16_t packSize);
+st7789_PixelFormat st7789_GetPixelFormat(const st7789_Device *device);
+uint32_t st7789_PixelBytes(const st7789_Device *device, uint32_t count);
+uint16_t st7789_ColorToRGB444(uint16_t color);
+void st7789_PackRGB444(uint8_t *packed, const uint16_t *pixels, uint32_t count);
+void st7789_WritePixels(st7789_Device *device, const uint16_t *pixels, uint32_t count);
+void st7789_SetScrollArea(st7789_Device *device, uint16_t top, uint16_t bottom);
+void st7789_SetScroll(st7789_Device *device, uint16_t offset);
+uint16_t st7789_GetScroll(const st7789_Device *device);
+uint16_t st7789_TranslateRow(const st7789_Device *device, uint16_t y);
+uint16_t st7789_ScrollContiguousRows(const st7789_Device *device, uint16_t y, uint16_t height);
+void st7789_FillDMA(st7789_Device *device, uint16_t color, uint32_t count);
+void st7789_FillArea(st7789_Device *device, uint16_t color, uint16_t startX, uint16_t startY, uint16_t width, uint16_t height);
+void st7789_DrawHLine(st7789_Device *device, uint16_t color, uint16_t x, uint16_t y, uint16_t length);
+void st7789_DrawVLine(st7789_Device *device, uint16_t color, uint16_t x, uint16_t y, uint16_t length);
+void st7789_DrawRect(st7789_Device *device, uint16_t color, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+void st7789_FillRects(st7789_Device *device, uint16_t color, const st7789_Rect *rects, size_t count);
+void st7789_Clear(st7789_Device *device, uint16_t color);
 uint16_t st7789_RGBToColor(uint8_t r, uint8_t g, uint8_t b);
+
+#endif
@@ -0,0 +1,469 @@
+#ifndef ST7789_HPP
+#define ST7789_HPP
+
+// Header only C++17 variant of lib/st7789.c for a single panel known at
+// compile time. Peripherals, geometry and pixel format are template
+// parameters, so register addresses, MADCTL offsets, COLMOD and DMA flags
+// are constants and window / fill / band writes inline to plain register
+// accesses. No queue, scrolling, vsync or statistics, use st7789_Device for
+// those. Commands and types are shared with st7789.h.
+//
+// typedef st7789::St7789<
+// 	st7789::Spi<1>,
+// 	st7789::DmaChannel<3>,
+// 	st7789::Pin<st7789::PortA, 8>,  // D/CX
+// 	st7789::Pin<st7789::PortA, 9>,  // RESX
+// 	st7789::Geometry<ST7789_GEOMETRY_240X240, ST7789_ORIENTATION_0>,
+// 	ST7789_PIXEL_FORMAT_RGB565
+// > Display;
+// Display::Init();
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+
+
+namespace st7789 {
+
+
+// CR1 of master in bidirectional transmit mode, SPI mode 2, fPCLK / 2.
+// SPE and DFF are driven by the driver.
+#define ST7789_SPI_CR1 (SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_MSTR | SPI_CR1_CPOL | SPI_CR1_BIDIMODE | SPI_CR1_BIDIOE)
+
+
+template <uint8_t Number, uint16_t Cr1 = ST7789_SPI_CR1>
+struct Spi {
+	static_assert(Number == 1 || Number == 2, "Only SPI1 and SPI2 have TX DMA on DMA1");
+	static constexpr uint16_t cr1 = Cr1 & ~(SPI_CR1_SPE | SPI_CR1_DFF);
+	static constexpr uint8_t txDmaChannel = (Number == 1) ? 3 : 5;
+
+	static SPI_TypeDef *Regs() {
+		if constexpr (Number == 1) {
+			return SPI1;
+		}
+		else {
+			return SPI2;
+		}
+	}
+};
+
+
+template <uint8_t Number>
+struct DmaChannel {
+	static_assert(Number >= 1 && Number <= 7, "DMA1 has channels 1 to 7");
+	static constexpr uint8_t number = Number;
+	static constexpr IRQn_Type irqn = (IRQn_Type)(DMA1_Channel1_IRQn + Number - 1);
+	static constexpr uint32_t flagTC = (uint32_t)DMA_ISR_TCIF1 << ((Number - 1) * 4);
+	static constexpr uint32_t flagClear = (uint32_t)DMA_IFCR_CGIF1 << ((Number - 1) * 4);
+
+	static DMA_Channel_TypeDef *Regs() {
+		DMA_Channel_TypeDef *const channels[] = {
+			DMA1_Channel1,
+			DMA1_Channel2,
+			DMA1_Channel3,
+			DMA1_Channel4,
+			DMA1_Channel5,
+			DMA1_Channel6,
+			DMA1_Channel7,
+		};
+		return channels[Number - 1];
+	}
+};
+
+
+struct PortA {
+	static GPIO_TypeDef *Regs() { return GPIOA; }
+};
+
+struct PortB {
+	static GPIO_TypeDef *Regs() { return GPIOB; }
+};
+
+#ifdef GPIOC
+struct PortC {
+	static GPIO_TypeDef *Regs() { return GPIOC; }
+};
+#endif
+
+
+// Output pin, single BSRR / BRR store instead of ODR read-modify-write
+template <typename Port, uint8_t Number>
+struct Pin {
+	static_assert(Number < 16, "GPIO port has 16 pins");
+	static constexpr uint16_t mask = (uint16_t)(1u << Number);
+
+	static void Set() {
+		Port::Regs()->BSRR = mask;
+	}
+
+	static void Clear() {
+		Port::Regs()->BRR = mask;
+	}
+};
+
+
+// Glass size and offsets with MADCTL 0 (ST7789_GEOMETRY_*) and fixed
+// orientation, logical size and CASET / RASET offsets as st7789_UpdateGeometry
+template <uint16_t PanelWidth, uint16_t PanelHeight, uint16_t ColOffset, uint16_t RowOffset, uint8_t Madctl = ST7789_ORIENTATION_0>
+struct Geometry {
+	static_assert(ColOffset + PanelWidth <= ST7789_GRAM_WIDTH, "Glass outside of frame memory columns");
+	static_assert(RowOffset + PanelHeight <= ST7789_GRAM_HEIGHT, "Glass outside of frame memory rows");
+	static constexpr uint8_t madctl = Madctl;
+	static constexpr bool swap = (Madctl & ST7789_MADCTL_MV) != 0;
+	static constexpr uint16_t column = (Madctl & ST7789_MADCTL_MX) ? ST7789_GRAM_WIDTH - ColOffset - PanelWidth : ColOffset;
+	static constexpr uint16_t row = (Madctl & ST7789_MADCTL_MY) ? ST7789_GRAM_HEIGHT - RowOffset - PanelHeight : RowOffset;
+	static constexpr uint16_t width = swap ? PanelHeight : PanelWidth;
+	static constexpr uint16_t height = swap ? PanelWidth : PanelHeight;
+	static constexpr uint16_t xOffset = swap ? row : column;
+	static constexpr uint16_t yOffset = swap ? column : row;
+};
+
+
+// Packed command stream: command, wait in ms, parameter count, parameters,
+// terminated by ST7789_CMDLIST_END
+template <uint8_t... Bytes>
+struct ByteStream {
+	static constexpr uint8_t data[sizeof...(Bytes)] = {Bytes...};
+};
+
+template <uint8_t Code, uint8_t WaitMs, uint8_t... Data>
+using Command = ByteStream<Code, WaitMs, (uint8_t)sizeof...(Data), Data...>;
+
+template <typename... Streams>
+struct Concat;
+
+template <uint8_t... Bytes>
+struct Concat<ByteStream<Bytes...>> {
+	typedef ByteStream<Bytes...> type;
+};
+
+template <uint8_t... First, uint8_t... Second, typename... Rest>
+struct Concat<ByteStream<First...>, ByteStream<Second...>, Rest...> {
+	typedef typename Concat<ByteStream<First..., Second...>, Rest...>::type type;
+};
+
+template <typename... Commands>
+using Sequence = typename Concat<Commands..., ByteStream<ST7789_CMDLIST_END>>::type;
+
+
+// st7789_initSequence of st7789_Init_1_3_LCD with pixel format and MADCTL
+// of template
+template <st7789_PixelFormat Format, uint8_t Madctl>
+using InitSequence_1_3_LCD = Sequence<
+	Command<ST7789_CMD_SLPIN, 10>,
+	Command<ST7789_CMD_SWRESET, 200>,
+	Command<ST7789_CMD_SLPOUT, 120>,
+	Command<ST7789_CMD_COLMOD, 0, (uint8_t)Format>,
+	Command<ST7789_CMD_INVON, 0>,
+	Command<ST7789_CMD_PORCTRL, 0, 0x0c, 0x0c, 0x00, 0x33, 0x33>,
+	Command<ST7789_CMD_GCTRL, 0, 0x35>,
+	Command<ST7789_CMD_VCOMS, 0, 0x1f>,
+	Command<ST7789_CMD_LCMCTRL, 0, 0x2c>,
+	Command<ST7789_CMD_VDVVRHEN, 0, 0x01, 0xc3>,
+	Command<ST7789_CMD_VDVSET, 0, 0x20>,
+	Command<ST7789_CMD_FRCTR2, 0, 0x0f>,
+	Command<ST7789_CMD_PWCTRL1, 0, 0xa4, 0xa1>,
+	Command<ST7789_CMD_RAMCTRL, 0, 0x00, 0x08>,
+	Command<ST7789_CMD_MADCTL, 0, Madctl>
+>;
+
+using DisplaySequence_1_3_LCD = Sequence<
+	Command<ST7789_CMD_DISPON, 100>,
+	Command<ST7789_CMD_SLPOUT, 100>,
+	Command<ST7789_CMD_TEON, 0>
+>;
+
+
+// Upper bits of RGB565 channels, result is 0x0RGB
+constexpr uint16_t ColorToRGB444(uint16_t color) {
+	return (uint16_t)(((color >> 4) & 0x0f00) | ((color >> 3) & 0x00f0) | ((color >> 1) & 0x000f));
+}
+
+
+// Two pixels in three bytes, odd last pixel uses two bytes
+inline void PackRGB444(uint8_t *packed, const uint16_t *pixels, uint32_t count) {
+	while (count >= 2) {
+		uint16_t first = ColorToRGB444(pixels[0]);
+		uint16_t second = ColorToRGB444(pixels[1]);
+		packed[0] = (uint8_t)(first >> 4);
+		packed[1] = (uint8_t)((first << 4) | (second >> 8));
+		packed[2] = (uint8_t)second;
+		packed += 3;
+		pixels += 2;
+		count -= 2;
+	}
+	if (count) {
+		uint16_t last = ColorToRGB444(pixels[0]);
+		packed[0] = (uint8_t)(last >> 4);
+		packed[1] = (uint8_t)(last << 4);
+	}
+}
+
+
+// All state is static, one instantiation drives one panel. SPI, DMA and
+// GPIO clocks and pin modes are set up by application.
+template <typename SpiT, typename DmaT, typename DcPin, typename RstPin, typename GeometryT, st7789_PixelFormat Format>
+class St7789 {
+public:
+	typedef GeometryT Geometry;
+
+	static_assert(DmaT::number == SpiT::txDmaChannel, "DMA channel is not wired to TX of SPI");
+	static_assert(Format == ST7789_PIXEL_FORMAT_RGB565 || Format == ST7789_PIXEL_FORMAT_RGB444, "Unsupported pixel format");
+
+	static constexpr uint16_t width = Geometry::width;
+	static constexpr uint16_t height = Geometry::height;
+
+	// Bytes on wire, odd pixel in RGB444 mode is sent in 2 bytes
+	static constexpr uint32_t PixelBytes(uint32_t count) {
+		return (Format == ST7789_PIXEL_FORMAT_RGB444) ? (count * 3 + 1) / 2 : count * 2;
+	}
+
+	// SPI mode, TX DMA request and DMA destination are set once, panel
+	// keeps its state. Enables DWT cycle counter used by delays.
+	static void Configure() {
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+		SpiT::Regs()->CR1 = SpiT::cr1;
+		SpiT::Regs()->CR2 = SPI_CR2_TXDMAEN;
+		SpiT::Regs()->CR1 = SpiT::cr1 | SPI_CR1_SPE;
+		DmaT::Regs()->CCR = 0;
+		DmaT::Regs()->CPAR = (uint32_t)(uintptr_t)&SpiT::Regs()->DR;
+		windowValid = false;
+	}
+
+	// Configure, hardware reset and st7789_Init_1_3_LCD sequence
+	static void Init() {
+		Configure();
+		RstPin::Clear();
+		WaitTicks(ST7789_TICKS_PER_MS / 100); // Reset pulse time
+		RstPin::Set();
+		WaitTicks(120 * ST7789_TICKS_PER_MS); // Maximum time of blanking sequence
+		RunCommands(InitSequence_1_3_LCD<Format, Geometry::madctl>::data);
+		Clear(0x0000);
+		RunCommands(DisplaySequence_1_3_LCD::data);
+	}
+
+	static void RunCommands(const uint8_t *sequence) {
+		while (sequence[0] != ST7789_CMDLIST_END) {
+			WriteCommand(sequence[0], sequence + 3, sequence[2]);
+			if (sequence[1] > 0) {
+				WaitTicks(sequence[1] * ST7789_TICKS_PER_MS);
+			}
+			sequence += 3 + sequence[2];
+		}
+		windowValid = false;
+	}
+
+	static void WriteCommand(uint8_t command, const uint8_t *data, size_t length) {
+		SendCommand(command);
+		if (length > 0) {
+			DcPin::Set();
+			while (length--) {
+				SendData(*data++);
+			}
+			WaitForSpi();
+		}
+	}
+
+	// Same window rules as st7789_SetWindow without scrolling: CASET /
+	// RASET already on panel are skipped, window continuing at next row
+	// only sends RAMWRC
+	static void SetWindow(uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd) {
+		xStart += Geometry::xOffset;
+		xEnd += Geometry::xOffset;
+		yStart += Geometry::yOffset;
+		yEnd += Geometry::yOffset;
+		bool columns = windowValid && xStart == windowXStart && xEnd == windowXEnd;
+		bool rows = windowValid && yEnd <= windowYEnd;
+		uint8_t command = ST7789_CMD_RAMWR;
+		if (columns && rows && yStart == windowNextRow) {
+			command = ST7789_CMD_RAMWRC;
+		}
+		else {
+			if (!columns) {
+				SendCommand(ST7789_CMD_CASET);
+				DcPin::Set();
+				SendWord(xStart);
+				SendWord(xEnd);
+				WaitForSpi();
+				windowXStart = xStart;
+				windowXEnd = xEnd;
+			}
+			if (!rows || yStart != windowYStart) {
+				// Window ends at last row to allow continuation of rows below
+				constexpr uint16_t bottom = Geometry::yOffset + height - 1;
+				uint16_t lastRow = (yEnd > bottom) ? yEnd : bottom;
+				SendCommand(ST7789_CMD_RASET);
+				DcPin::Set();
+				SendWord(yStart);
+				SendWord(lastRow);
+				WaitForSpi();
+				windowYStart = yStart;
+				windowYEnd = lastRow;
+			}
+			windowValid = true;
+		}
+		SendCommand(command);
+		DcPin::Set();
+		// Odd RGB444 window leaves half of pixel pair in panel
+		uint32_t pixels = (uint32_t)(xEnd - xStart + 1) * (yEnd - yStart + 1);
+		windowNextRow = (Format == ST7789_PIXEL_FORMAT_RGB444 && (pixels & 1)) ? 0xffff : yEnd + 1;
+	}
+
+	static void InvalidateWindow() {
+		windowValid = false;
+	}
+
+	static void Fill(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+		if (w == 0 || h == 0) {
+			return;
+		}
+		SetWindow(x, y, x + w - 1, y + h - 1);
+		FillPixels(color, (uint32_t)w * h);
+	}
+
+	static void Clear(uint16_t color) {
+		Fill(color, 0, 0, width, height);
+	}
+
+	// Repeats color after SetWindow and waits for end
+	static void FillPixels(uint16_t color, uint32_t count) {
+		if constexpr (Format == ST7789_PIXEL_FORMAT_RGB565) {
+			// SPI sends 16 bit frames MSB first and memory is little endian
+			uint16_t word = (uint16_t)((color << 8) | (color >> 8));
+			SetFrameSize(SPI_CR1_DFF);
+			while (count > 0) {
+				uint16_t transferSize = (count > 0xffff) ? 0xffff : (uint16_t)count;
+				StartDMA(DMA_CCR1_DIR | DMA_CCR1_MSIZE_0 | DMA_CCR1_PSIZE_0, &word, transferSize);
+				while (DmaT::Regs()->CNDTR);
+				count -= transferSize;
+			}
+			SetFrameSize(0);
+		}
+		else {
+			// Three byte pattern of two pixels, single byte if all are same
+			uint8_t pattern[ST7789_PACK_BUFFER_SIZE];
+			uint16_t packed = ColorToRGB444(color);
+			uint32_t length = PixelBytes(count);
+			uint32_t flags = DMA_CCR1_DIR;
+			uint16_t maxTransfer = 0xffff;
+			pattern[0] = (uint8_t)(packed >> 4);
+			pattern[1] = (uint8_t)((packed << 4) | (packed >> 8));
+			pattern[2] = (uint8_t)packed;
+			if (pattern[0] != pattern[1] || pattern[1] != pattern[2]) {
+				for (size_t i = 3; i < sizeof(pattern); ++i) {
+					pattern[i] = pattern[i - 3];
+				}
+				flags |= DMA_CCR1_MINC;
+				maxTransfer = sizeof(pattern);
+			}
+			while (length > 0) {
+				uint16_t transferSize = (length > maxTransfer) ? maxTransfer : (uint16_t)length;
+				StartDMA(flags, pattern, transferSize);
+				while (DmaT::Regs()->CNDTR);
+				length -= transferSize;
+			}
+			WaitForSpi();
+		}
+	}
+
+	// Starts DMA of pixels and returns without waiting, like
+	// st7789_WritePixels. RGB565 buffer must stay untouched until next call
+	// or WaitForDMA, RGB444 pixels are packed to alternating buffers.
+	static void WritePixels(const uint16_t *pixels, uint32_t count) {
+		if constexpr (Format == ST7789_PIXEL_FORMAT_RGB565) {
+			while (count > 0) {
+				uint16_t chunk = (count > 0x7fff) ? 0x7fff : (uint16_t)count;
+				WaitForDMA();
+				StartDMA(DMA_CCR1_MINC | DMA_CCR1_DIR, pixels, chunk * 2);
+				pixels += chunk;
+				count -= chunk;
+			}
+		}
+		else {
+			while (count > 0) {
+				uint16_t chunk = (count > ST7789_PACK_BUFFER_PIXELS) ? ST7789_PACK_BUFFER_PIXELS : (uint16_t)count;
+				uint8_t *packed = packBuffers[packIndex];
+				packIndex ^= 1;
+				PackRGB444(packed, pixels, chunk);
+				WaitForDMA();
+				StartDMA(DMA_CCR1_MINC | DMA_CCR1_DIR, packed, (uint16_t)PixelBytes(chunk));
+				pixels += chunk;
+				count -= chunk;
+			}
+		}
+	}
+
+	// Band of rendered pixels, previous band may still be in DMA
+	static void WriteBand(const st7789_Rect &band, const uint16_t *pixels) {
+		WaitForDMA();
+		SetWindow(band.x, band.y, band.x + band.width - 1, band.y + band.height - 1);
+		WritePixels(pixels, (uint32_t)band.width * band.height);
+	}
+
+	static void WaitForDMA() {
+		while (DmaT::Regs()->CNDTR);
+		WaitForSpi();
+	}
+
+private:
+	static inline bool windowValid = false;
+	static inline uint16_t windowXStart;
+	static inline uint16_t windowXEnd;
+	static inline uint16_t windowYStart;
+	static inline uint16_t windowYEnd;
+	static inline uint16_t windowNextRow;
+	static inline uint8_t packBuffers[2][ST7789_PACK_BUFFER_SIZE];
+	static inline uint8_t packIndex;
+
+	static void WaitTicks(uint32_t ticks) {
+		uint32_t start = DWT->CYCCNT;
+		while (DWT->CYCCNT - start < ticks);
+	}
+
+	// SPI is idle after every operation, BSY is checked only before D/CX
+	// changes
+	static void WaitForSpi() {
+		while (!(SpiT::Regs()->SR & SPI_SR_TXE));
+		while (SpiT::Regs()->SR & SPI_SR_BSY);
+	}
+
+	// D/CX stays low, parameters and pixels raise it
+	static void SendCommand(uint8_t command) {
+		DcPin::Clear();
+		SpiT::Regs()->DR = command;
+		while (SpiT::Regs()->SR & SPI_SR_BSY);
+	}
+
+	static void SendData(uint8_t data) {
+		while (!(SpiT::Regs()->SR & SPI_SR_TXE));
+		SpiT::Regs()->DR = data;
+	}
+
+	static void SendWord(uint16_t data) {
+		SendData((uint8_t)(data >> 8));
+		SendData((uint8_t)(data & 0xff));
+	}
+
+	// DFF can change only with SPE cleared
+	static void SetFrameSize(uint16_t dff) {
+		WaitForSpi();
+		SpiT::Regs()->CR1 = SpiT::cr1 | dff;
+		SpiT::Regs()->CR1 = SpiT::cr1 | dff | SPI_CR1_SPE;
+	}
+
+	// Destination and TX DMA request are set by Configure
+	static void StartDMA(uint32_t flags, const void *data, uint16_t length) {
+		DmaT::Regs()->CCR = flags;
+		DmaT::Regs()->CMAR = (uint32_t)(uintptr_t)data;
+		DmaT::Regs()->CNDTR = length;
+		DmaT::Regs()->CCR = flags | DMA_CCR1_EN;
+	}
+};
+
+
+} // namespace st7789
+
+#endif
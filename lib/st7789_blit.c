@@ -0,0 +1,109 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "st7789.h"
+#include "st7789_blit.h"
+
+
+// Little endian word from unaligned address, single LDR on Cortex-M3
+static inline uint32_t st7789_BlitLoad(const uint8_t *data) {
+	uint32_t word;
+	memcpy(&word, data, sizeof(word));
+	return word;
+}
+
+
+// Expands width pixels starting at bit firstBit of row. Source is read by
+// words while whole word belongs to row, tail bytes are assembled so that
+// reads never pass end of row.
+static void st7789_BlitRow(uint16_t *out, const uint8_t *row, uint32_t firstBit, uint16_t width, uint8_t bpp, const uint16_t *colors, const uint32_t *transparent) {
+	const uint8_t *src = row + (firstBit >> 3);
+	uint32_t shift = firstBit & 7;
+	uint32_t pixelMask = (1u << bpp) - 1;
+	uint32_t bytes = (shift + (uint32_t)width * bpp + 7) >> 3;
+	while (width > 0) {
+		uint32_t word;
+		uint32_t available;
+		if (bytes >= 4) {
+			word = st7789_BlitLoad(src);
+			src += 4;
+			bytes -= 4;
+			available = 32;
+		}
+		else {
+			word = 0;
+			for (uint32_t i = 0; i < bytes; ++i) {
+				word |= (uint32_t)src[i] << (i * 8);
+			}
+			available = bytes * 8;
+			bytes = 0;
+		}
+		word >>= shift;
+		available -= shift;
+		shift = 0;
+		uint32_t count = available / bpp;
+		if (count > width) {
+			count = width;
+		}
+		width -= (uint16_t)count;
+		if (transparent == NULL) {
+			while (count--) {
+				*out++ = colors[word & pixelMask];
+				word >>= bpp;
+			}
+		}
+		else {
+			while (count--) {
+				uint32_t index = word & pixelMask;
+				if (!((transparent[index >> 5] >> (index & 31)) & 1)) {
+					*out = colors[index];
+				}
+				out++;
+				word >>= bpp;
+			}
+		}
+	}
+}
+
+
+// Expands source area of bitmap (whole bitmap if NULL) to out, rows of out
+// are stride pixels apart. Transparent pixels keep content of out.
+void st7789_BlitIndexed(uint16_t *out, uint16_t stride, const st7789_Bitmap *bitmap, const st7789_Palette *palette, const st7789_Rect *source) {
+	st7789_Rect whole = {0, 0, bitmap->width, bitmap->height};
+	if (source == NULL) {
+		source = &whole;
+	}
+	uint32_t rowBytes = ST7789_BITMAP_STRIDE(bitmap);
+	const uint8_t *row = bitmap->data + source->y * rowBytes;
+	uint32_t firstBit = (uint32_t)source->x * bitmap->bpp;
+	for (uint16_t y = 0; y < source->height; ++y, row += rowBytes, out += stride) {
+		st7789_BlitRow(out, row, firstBit, source->width, bitmap->bpp, palette->colors, palette->transparent);
+	}
+}
+
+
+// Opaque blit straight to screen in one window, rows go through halves of
+// band buffer. Transparency is ignored, there is no background to keep.
+bool st7789_DrawIndexed(st7789_Device *device, uint16_t x, uint16_t y, const st7789_Bitmap *bitmap, const st7789_Palette *palette, uint16_t *band, uint32_t bandPixels) {
+	st7789_Palette opaque = {palette->colors, NULL};
+	uint16_t stripRows = (uint16_t)((bandPixels / 2) / bitmap->width);
+	uint8_t bufferIndex = 0;
+	if (stripRows == 0 || x + bitmap->width > device->width || y + bitmap->height > device->height) {
+		return false;
+	}
+	// Even strip rows keep RGB444 pixel pairs inside one transfer
+	if (stripRows > 1) {
+		stripRows &= ~1;
+	}
+	uint32_t half = (bandPixels / 2) & ~1u;
+	st7789_SetWindow(device, x, y, x + bitmap->width - 1, y + bitmap->height - 1);
+	for (uint16_t top = 0; top < bitmap->height; top += stripRows) {
+		uint16_t *pixels = band + bufferIndex * half;
+		st7789_Rect strip = {0, top, bitmap->width, (uint16_t)((bitmap->height - top < stripRows) ? bitmap->height - top : stripRows)};
+		st7789_BlitIndexed(pixels, bitmap->width, bitmap, &opaque, &strip);
+		st7789_WritePixels(device, pixels, (uint32_t)strip.width * strip.height);
+		bufferIndex ^= 1;
+	}
+	st7789_WaitForDMA(device);
+	return true;
+}
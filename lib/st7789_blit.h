@@ -0,0 +1,30 @@
+#ifndef ST7789_BLIT_H
+#define ST7789_BLIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Indexed bitmap, rows start on byte boundary, first pixel is in least
+// significant bits of byte (same order as 1bpp fonts)
+typedef struct st7789_Bitmap {
+	const uint8_t *data;
+	uint16_t width;
+	uint16_t height;
+	uint8_t bpp;              // 1, 2, 4 or 8
+} st7789_Bitmap;
+
+// Colour key is a mask with single bit set
+typedef struct st7789_Palette {
+	const uint16_t *colors;   // 1 << bpp RGB565 entries
+	const uint32_t *transparent; // Bit per entry, pixel is skipped if set, NULL if opaque
+} st7789_Palette;
+
+#define ST7789_BITMAP_STRIDE(bitmap) (((uint32_t)(bitmap)->width * (bitmap)->bpp + 7) / 8)
+
+void st7789_BlitIndexed(uint16_t *out, uint16_t stride, const st7789_Bitmap *bitmap, const st7789_Palette *palette, const st7789_Rect *source);
+bool st7789_DrawIndexed(st7789_Device *device, uint16_t x, uint16_t y, const st7789_Bitmap *bitmap, const st7789_Palette *palette, uint16_t *band, uint32_t bandPixels);
+
+#endif
@@ -0,0 +1,234 @@
+#include <stddef.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_bridge.h"
+#include "st7789_queue.h"
+
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021), nibble table instead of 512 byte one
+static const uint16_t st7789_bridgeCrcTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+
+uint16_t st7789_BridgeCrc(uint16_t crc, const uint8_t *data, uint32_t length) {
+	for (uint32_t i = 0; i < length; ++i) {
+		crc = (uint16_t)((crc << 4) ^ st7789_bridgeCrcTable[(crc >> 12) ^ (data[i] >> 4)]);
+		crc = (uint16_t)((crc << 4) ^ st7789_bridgeCrcTable[(crc >> 12) ^ (data[i] & 0x0f)]);
+	}
+	return crc;
+}
+
+
+static uint16_t st7789_BridgeField(const uint8_t *frame, uint8_t offset) {
+	return (uint16_t)(frame[offset] | (frame[offset + 1] << 8));
+}
+
+
+static uint16_t st7789_BridgeRingSize(const st7789_Bridge *bridge) {
+	return (uint16_t)(bridge->slotCount * bridge->slotSize);
+}
+
+
+// Bytes written by RX DMA into ring, weak attribute to allow override
+uint16_t __attribute__((weak)) st7789_BridgeRxPosition(st7789_Bridge *bridge) {
+	uint16_t size = st7789_BridgeRingSize(bridge);
+	return (uint16_t)((size - bridge->rxDma->CNDTR) % size);
+}
+
+
+// Weak attribute to allow override
+void __attribute__((weak)) st7789_BridgeTransmit(st7789_Bridge *bridge, uint8_t reply) {
+	while (!(bridge->usart->SR & USART_SR_TXE));
+	bridge->usart->DR = reply;
+}
+
+
+static void st7789_BridgeStartRx(st7789_Bridge *bridge) {
+	bridge->rxDma->CCR = 0;
+	bridge->rxDma->CPAR = (uint32_t)(uintptr_t)&bridge->usart->DR;
+	bridge->rxDma->CMAR = (uint32_t)(uintptr_t)bridge->slots;
+	bridge->rxDma->CNDTR = st7789_BridgeRingSize(bridge);
+	// SR read followed by DR read clears overrun left by dropped bytes
+	uint32_t error = bridge->usart->SR;
+	error = bridge->usart->DR;
+	(void)error;
+	bridge->usart->CR3 |= USART_CR3_DMAR;
+	bridge->rxDma->CCR = DMA_CCR1_MINC | DMA_CCR1_CIRC | DMA_CCR1_EN;
+	bridge->head = 0;
+	bridge->credits = 0;
+}
+
+
+// Head slot is complete, at most slotCount - 1 slots are granted so
+// distance of DMA from head is not ambiguous
+static bool st7789_BridgeSlotReceived(st7789_Bridge *bridge) {
+	uint16_t size = st7789_BridgeRingSize(bridge);
+	uint16_t start = (uint16_t)(bridge->head * bridge->slotSize);
+	uint16_t position = st7789_BridgeRxPosition(bridge);
+	return (uint16_t)((position + size - start) % size) >= bridge->slotSize;
+}
+
+
+// Slots are granted in ring order once SPI is done with them
+static void st7789_BridgeGrant(st7789_Bridge *bridge) {
+	while (bridge->credits < bridge->slotCount - 1) {
+		uint8_t slot = (bridge->head + bridge->credits) % bridge->slotCount;
+		if (bridge->busy[slot]) {
+			break;
+		}
+		bridge->credits++;
+		st7789_BridgeTransmit(bridge, bridge->expected);
+	}
+}
+
+
+// Queue callback, runs in DMA interrupt
+static void st7789_BridgeSlotDone(void *context) {
+	*(volatile bool *)context = false;
+}
+
+
+static bool st7789_BridgeCheck(const st7789_Bridge *bridge, const uint8_t *frame) {
+	uint16_t length = st7789_BridgeField(frame, 12);
+	if (frame[0] != ST7789_BRIDGE_MAGIC || frame[2] != bridge->expected || length > bridge->slotSize - ST7789_BRIDGE_HEADER_SIZE) {
+		return false;
+	}
+	uint16_t crc = st7789_BridgeCrc(ST7789_BRIDGE_CRC_INIT, frame, 14);
+	crc = st7789_BridgeCrc(crc, frame + ST7789_BRIDGE_HEADER_SIZE, length);
+	return crc == st7789_BridgeField(frame, 14);
+}
+
+
+// Sender stops when granted slots are used, line is quiet once they arrive
+// or after lost bytes. Ring restarts empty and the NAK reply tells sender
+// where to continue.
+static void st7789_BridgeResync(st7789_Device *device, st7789_Bridge *bridge) {
+	uint16_t position = st7789_BridgeRxPosition(bridge);
+	uint32_t quietStart = st7789_Ticks();
+	while (bridge->credits > 0 && st7789_Ticks() - quietStart < ST7789_BRIDGE_IDLE_TICKS) {
+		if (st7789_BridgeSlotReceived(bridge)) {
+			bridge->head = (bridge->head + 1) % bridge->slotCount;
+			bridge->credits--;
+		}
+		uint16_t current = st7789_BridgeRxPosition(bridge);
+		if (current != position) {
+			position = current;
+			quietStart = st7789_Ticks();
+		}
+	}
+	st7789_QueueFlush(device);
+	st7789_BridgeStartRx(bridge);
+	bridge->stats.resyncs++;
+	st7789_BridgeTransmit(bridge, ST7789_BRIDGE_NAK | bridge->expected);
+}
+
+
+// Payload is sent from slot, slot is granted again after DMA is done
+static bool st7789_BridgeShow(st7789_Device *device, st7789_Bridge *bridge, uint8_t slot, const uint8_t *frame) {
+	uint16_t x = st7789_BridgeField(frame, 4);
+	uint16_t y = st7789_BridgeField(frame, 6);
+	uint16_t width = st7789_BridgeField(frame, 8);
+	uint16_t height = st7789_BridgeField(frame, 10);
+	uint16_t length = st7789_BridgeField(frame, 12);
+	if (width == 0 || height == 0 || length == 0 || x + width > device->width || y + height > device->height) {
+		return false;
+	}
+	bridge->busy[slot] = true;
+	st7789_QueueWindow(device, x, y, x + width - 1, y + height - 1);
+	st7789_QueuePixels(device, frame + ST7789_BRIDGE_HEADER_SIZE, length, st7789_BridgeSlotDone, (void *)&bridge->busy[slot]);
+	return true;
+}
+
+
+// Parameters stay in slot until command is sent
+static bool st7789_BridgeCommand(st7789_Device *device, st7789_Bridge *bridge, uint8_t slot, const uint8_t *frame) {
+	uint16_t length = st7789_BridgeField(frame, 12);
+	if (length == 0) {
+		return false;
+	}
+	bridge->busy[slot] = true;
+	st7789_QueueCommand(device, frame[ST7789_BRIDGE_HEADER_SIZE], frame + ST7789_BRIDGE_HEADER_SIZE + 1, length - 1);
+	st7789_QueueFence(device, st7789_BridgeSlotDone, (void *)&bridge->busy[slot]);
+	// Command can move address window or change its meaning
+	st7789_InvalidateWindow(device);
+	return true;
+}
+
+
+void st7789_BridgeInit(st7789_Bridge *bridge, USART_TypeDef *usart, DMA_Channel_TypeDef *rxDma, uint8_t *slots, uint8_t slotCount, uint16_t slotSize) {
+	bridge->usart = usart;
+	bridge->rxDma = rxDma;
+	bridge->slots = slots;
+	bridge->slotSize = slotSize;
+	bridge->slotCount = (slotCount > ST7789_BRIDGE_MAX_SLOTS) ? ST7789_BRIDGE_MAX_SLOTS : slotCount;
+	// Whole ring has to fit to one circular transfer
+	while (bridge->slotCount > 1 && (uint32_t)bridge->slotCount * slotSize > ST7789_BRIDGE_MAX_RING) {
+		bridge->slotCount--;
+	}
+	bridge->head = 0;
+	bridge->credits = 0;
+	bridge->expected = 0;
+	for (uint8_t slot = 0; slot < ST7789_BRIDGE_MAX_SLOTS; ++slot) {
+		bridge->busy[slot] = false;
+	}
+	bridge->stats.frames = 0;
+	bridge->stats.skipped = 0;
+	bridge->stats.resyncs = 0;
+}
+
+
+void st7789_BridgeStart(st7789_Bridge *bridge) {
+	st7789_BridgeStartRx(bridge);
+	bridge->expected = 0;
+	st7789_BridgeTransmit(bridge, ST7789_BRIDGE_NAK | bridge->expected);
+	st7789_BridgeGrant(bridge);
+}
+
+
+// Queued payloads are still read from slots, flush queue before reusing them
+void st7789_BridgeStop(st7789_Bridge *bridge) {
+	bridge->rxDma->CCR = 0;
+	bridge->usart->CR3 &= ~USART_CR3_DMAR;
+	bridge->credits = 0;
+}
+
+
+st7789_BridgeStatus st7789_BridgePoll(st7789_Device *device, st7789_Bridge *bridge) {
+	st7789_BridgeGrant(bridge);
+	if (bridge->credits == 0 || !st7789_BridgeSlotReceived(bridge)) {
+		return ST7789_BRIDGE_WAITING;
+	}
+	uint8_t slot = bridge->head;
+	const uint8_t *frame = bridge->slots + slot * bridge->slotSize;
+	bridge->head = (slot + 1) % bridge->slotCount;
+	bridge->credits--;
+	if (!st7789_BridgeCheck(bridge, frame)) {
+		st7789_BridgeResync(device, bridge);
+		return ST7789_BRIDGE_FRAME;
+	}
+	bridge->expected = (bridge->expected + 1) & ST7789_BRIDGE_SEQUENCE_MASK;
+	bridge->stats.frames++;
+	bool shown = false;
+	switch (frame[1]) {
+		case ST7789_BRIDGE_PIXELS:
+			shown = st7789_BridgeShow(device, bridge, slot, frame);
+			break;
+		case ST7789_BRIDGE_COMMAND:
+			shown = st7789_BridgeCommand(device, bridge, slot, frame);
+			break;
+		case ST7789_BRIDGE_END:
+			// Sender is done when reply carries sequence after end frame
+			st7789_QueueFlush(device);
+			st7789_BridgeGrant(bridge);
+			return ST7789_BRIDGE_DONE;
+		default:
+			break;
+	}
+	if (!shown) {
+		bridge->stats.skipped++;
+	}
+	return ST7789_BRIDGE_FRAME;
+}
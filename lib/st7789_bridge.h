@@ -0,0 +1,91 @@
+#ifndef ST7789_BRIDGE_H
+#define ST7789_BRIDGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_queue.h"
+
+
+// Remote display over UART. RX DMA runs in circular mode over a ring of
+// fixed size slots, every slot holds one frame and its payload is queued to
+// SPI DMA from where it was received. Sender may only fill slots granted by
+// reply bytes, so ring is never overwritten while SPI reads it.
+//
+// Frame, multi byte fields little endian, slot is padded after payload:
+//   0  magic 'S'
+//   1  type (st7789_BridgeFrameType)
+//   2  sequence 0..127
+//   3  reserved, 0
+//   4  x, y, width, height of window (uint16_t each, ST7789_BRIDGE_PIXELS)
+//   12 payload length
+//   14 CRC-16/CCITT-FALSE of bytes 0..13 and payload
+//   16 payload: pixel bytes as sent to RAMWR or command byte and parameters
+//
+// Every reply byte grants one slot and holds sequence expected next. Reply
+// with ST7789_BRIDGE_NAK is sent after bad frame: device dropped all slots,
+// restarted ring and sender continues from that sequence without credit.
+
+#define ST7789_BRIDGE_MAGIC          0x53
+#define ST7789_BRIDGE_HEADER_SIZE    16
+#define ST7789_BRIDGE_NAK            0x80
+#define ST7789_BRIDGE_SEQUENCE_MASK  0x7f
+#define ST7789_BRIDGE_MAX_SLOTS      8
+#define ST7789_BRIDGE_MAX_RING       0xffff // Circular RX DMA, CNDTR is 16 bit
+#define ST7789_BRIDGE_CRC_INIT       0xffff
+#define ST7789_BRIDGE_IDLE_TICKS     (10 * ST7789_TICKS_PER_MS) // Quiet line after bad frame
+#define ST7789_BRIDGE_SLOT_SIZE(pixels) (ST7789_BRIDGE_HEADER_SIZE + (pixels) * 2)
+
+
+typedef enum st7789_BridgeFrameType {
+	ST7789_BRIDGE_PIXELS = 1,  // Window and its pixels
+	ST7789_BRIDGE_COMMAND = 2, // Raw command, window cache is invalidated
+	ST7789_BRIDGE_END = 3,     // Stream finished
+} st7789_BridgeFrameType;
+
+typedef enum st7789_BridgeStatus {
+	ST7789_BRIDGE_WAITING, // No complete frame in ring
+	ST7789_BRIDGE_FRAME,   // Frame received (valid or not)
+	ST7789_BRIDGE_DONE,    // End frame received, queue is flushed
+} st7789_BridgeStatus;
+
+typedef struct st7789_BridgeStats {
+	uint32_t frames;   // Accepted frames
+	uint32_t skipped;  // Intact frames with window outside panel or unknown type
+	uint32_t resyncs;  // Bad frames (magic, CRC, sequence) and ring restarts
+} st7789_BridgeStats;
+
+typedef struct st7789_Bridge {
+	USART_TypeDef *usart;
+	DMA_Channel_TypeDef *rxDma;
+	uint8_t *slots;
+	uint16_t slotSize;
+	uint8_t slotCount;
+	uint8_t head;         // Slot completed next by RX DMA
+	uint8_t credits;      // Granted slots from head on, at most slotCount - 1
+	uint8_t expected;     // Next sequence
+	volatile bool busy[ST7789_BRIDGE_MAX_SLOTS]; // Payload queued to SPI
+	st7789_BridgeStats stats;
+} st7789_Bridge;
+
+// USART is configured by application (pins, baud rate, RE and TE), rxDma
+// has to be its RX channel (USART1: DMA1 channel 5, USART2: 6, USART3: 3)
+// and must not be shared with SPI of display. Slots hold slotCount *
+// slotSize bytes, slotSize is ST7789_BRIDGE_SLOT_SIZE of band pixels.
+// Slots beyond ST7789_BRIDGE_MAX_RING bytes are not used. Needs
+// st7789_QueueInit.
+void st7789_BridgeInit(st7789_Bridge *bridge, USART_TypeDef *usart, DMA_Channel_TypeDef *rxDma, uint8_t *slots, uint8_t slotCount, uint16_t slotSize);
+// Restarts ring and sends ST7789_BRIDGE_NAK of sequence 0 with credits
+void st7789_BridgeStart(st7789_Bridge *bridge);
+void st7789_BridgeStop(st7789_Bridge *bridge);
+// Handles at most one frame, returns immediately when nothing was received
+st7789_BridgeStatus st7789_BridgePoll(st7789_Device *device, st7789_Bridge *bridge);
+uint16_t st7789_BridgeCrc(uint16_t crc, const uint8_t *data, uint32_t length);
+
+// Transport, weak to allow override (host tests on pseudo terminal)
+uint16_t st7789_BridgeRxPosition(st7789_Bridge *bridge);
+void st7789_BridgeTransmit(st7789_Bridge *bridge, uint8_t reply);
+
+#endif
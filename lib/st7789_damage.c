@@ -0,0 +1,221 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "st7789.h"
+#include "st7789_damage.h"
+
+
+static uint32_t st7789_DamageCost(const st7789_Rect *rect) {
+	return ST7789_DAMAGE_WINDOW_COST + (uint32_t)rect->width * rect->height * ST7789_DAMAGE_PIXEL_COST;
+}
+
+
+static void st7789_DamageUnion(st7789_Rect *rect, const st7789_Rect *other) {
+	uint16_t x1 = (rect->x + rect->width > other->x + other->width) ? rect->x + rect->width : other->x + other->width;
+	uint16_t y1 = (rect->y + rect->height > other->y + other->height) ? rect->y + rect->height : other->y + other->height;
+	rect->x = (rect->x < other->x) ? rect->x : other->x;
+	rect->y = (rect->y < other->y) ? rect->y : other->y;
+	rect->width = x1 - rect->x;
+	rect->height = y1 - rect->y;
+}
+
+
+static bool st7789_DamageIntersects(const st7789_Rect *a, const st7789_Rect *b) {
+	return a->x < b->x + b->width && b->x < a->x + a->width && a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+
+// Bounding box of rects i and j grown over every rect it overlaps, returns
+// mask of covered rects and their total cost
+static uint32_t st7789_DamageCover(const st7789_Rect *rects, uint16_t count, uint16_t i, uint16_t j, st7789_Rect *bounds, uint32_t *cost) {
+	uint32_t covered = (1u << i) | (1u << j);
+	*bounds = rects[i];
+	st7789_DamageUnion(bounds, &rects[j]);
+	*cost = st7789_DamageCost(&rects[i]) + st7789_DamageCost(&rects[j]);
+	uint16_t k = 0;
+	while (k < count) {
+		if (!(covered & (1u << k)) && st7789_DamageIntersects(bounds, &rects[k])) {
+			covered |= 1u << k;
+			*cost += st7789_DamageCost(&rects[k]);
+			st7789_DamageUnion(bounds, &rects[k]);
+			k = 0;
+			continue;
+		}
+		k++;
+	}
+	return covered;
+}
+
+
+// Greedy merge while one window is not more expensive than the windows it
+// replaces (overdraw is paid as pixels, saved window setup as overhead)
+static uint16_t st7789_DamageMerge(st7789_Rect *rects, uint16_t count) {
+	while (count > 1) {
+		int32_t bestGain = -1;
+		uint32_t bestCovered = 0;
+		st7789_Rect best = {0, 0, 0, 0};
+		for (uint16_t i = 0; i < count; ++i) {
+			for (uint16_t j = i + 1; j < count; ++j) {
+				st7789_Rect bounds;
+				uint32_t cost;
+				uint32_t covered = st7789_DamageCover(rects, count, i, j, &bounds, &cost);
+				int32_t gain = (int32_t)cost - (int32_t)st7789_DamageCost(&bounds);
+				if (gain > bestGain) {
+					bestGain = gain;
+					bestCovered = covered;
+					best = bounds;
+				}
+			}
+		}
+		if (bestGain < 0) {
+			break;
+		}
+		uint16_t output = 0;
+		bool placed = false;
+		for (uint16_t i = 0; i < count; ++i) {
+			if (!(bestCovered & (1u << i))) {
+				rects[output++] = rects[i];
+			}
+			else if (!placed) {
+				rects[output++] = best;
+				placed = true;
+			}
+		}
+		count = output;
+	}
+	return count;
+}
+
+
+// Adds run to the rect which grows least, used when rect list is full
+static void st7789_DamageAbsorb(st7789_Rect *rects, uint16_t count, const st7789_Rect *run) {
+	uint16_t bestIndex = 0;
+	uint32_t bestCost = UINT32_MAX;
+	for (uint16_t i = 0; i < count; ++i) {
+		st7789_Rect bounds = rects[i];
+		st7789_DamageUnion(&bounds, run);
+		uint32_t cost = st7789_DamageCost(&bounds) - st7789_DamageCost(&rects[i]);
+		if (cost < bestCost) {
+			bestCost = cost;
+			bestIndex = i;
+		}
+	}
+	st7789_DamageUnion(&rects[bestIndex], run);
+}
+
+
+void st7789_DamageInit(st7789_Damage *damage, uint16_t width, uint16_t height) {
+	memset(damage->tiles, 0, sizeof(damage->tiles));
+	// Tile map does not cover larger area
+	damage->width = (width > ST7789_MAX_SIZE) ? ST7789_MAX_SIZE : width;
+	damage->height = (height > ST7789_MAX_SIZE) ? ST7789_MAX_SIZE : height;
+	damage->windows = 0;
+	damage->pixels = 0;
+}
+
+
+void st7789_DamageAdd(st7789_Damage *damage, uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+	if (x >= damage->width || y >= damage->height || width == 0 || height == 0) {
+		return;
+	}
+	if (width > damage->width - x) {
+		width = damage->width - x;
+	}
+	if (height > damage->height - y) {
+		height = damage->height - y;
+	}
+	uint16_t column0 = x >> ST7789_DAMAGE_TILE_SHIFT;
+	uint16_t column1 = (x + width - 1) >> ST7789_DAMAGE_TILE_SHIFT;
+	uint16_t row0 = y >> ST7789_DAMAGE_TILE_SHIFT;
+	uint16_t row1 = (y + height - 1) >> ST7789_DAMAGE_TILE_SHIFT;
+	uint64_t mask = ((column1 == 63) ? UINT64_MAX : ((1ull << (column1 + 1)) - 1)) & ~((1ull << column0) - 1);
+	for (uint16_t row = row0; row <= row1; ++row) {
+		damage->tiles[row] |= mask;
+	}
+}
+
+
+void st7789_DamageAll(st7789_Damage *damage) {
+	st7789_DamageAdd(damage, 0, 0, damage->width, damage->height);
+}
+
+
+bool st7789_DamageEmpty(const st7789_Damage *damage) {
+	for (uint16_t row = 0; row < ST7789_DAMAGE_ROWS; ++row) {
+		if (damage->tiles[row]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Converts dirty tiles to at most ST7789_DAMAGE_MAX_RECTS windows in pixel
+// coordinates and clears the tile map
+uint16_t st7789_DamageCollect(st7789_Damage *damage, st7789_Rect *rects) {
+	uint16_t count = 0;
+	// Runs of dirty tiles in a row, extending rect from previous row if it
+	// has the same columns
+	for (uint16_t row = 0; row < ST7789_DAMAGE_ROWS; ++row) {
+		uint64_t mask = damage->tiles[row];
+		damage->tiles[row] = 0;
+		while (mask) {
+			uint16_t start = (uint16_t)__builtin_ctzll(mask);
+			uint64_t rest = ~(mask >> start);
+			uint16_t length = rest ? (uint16_t)__builtin_ctzll(rest) : (uint16_t)(64 - start);
+			mask &= (start + length >= 64) ? 0 : (UINT64_MAX << (start + length));
+
+			st7789_Rect run = {start, row, length, 1};
+			bool extended = false;
+			for (uint16_t i = 0; i < count; ++i) {
+				if (rects[i].y + rects[i].height == row && rects[i].x == start && rects[i].width == length) {
+					rects[i].height++;
+					extended = true;
+					break;
+				}
+			}
+			if (extended) {
+				continue;
+			}
+			if (count < ST7789_DAMAGE_MAX_RECTS) {
+				rects[count++] = run;
+			}
+			else {
+				st7789_DamageAbsorb(rects, count, &run);
+			}
+		}
+	}
+
+	for (uint16_t i = 0; i < count; ++i) {
+		st7789_Rect *rect = &rects[i];
+		uint16_t x1 = (rect->x + rect->width) << ST7789_DAMAGE_TILE_SHIFT;
+		uint16_t y1 = (rect->y + rect->height) << ST7789_DAMAGE_TILE_SHIFT;
+		rect->x <<= ST7789_DAMAGE_TILE_SHIFT;
+		rect->y <<= ST7789_DAMAGE_TILE_SHIFT;
+		rect->width = ((x1 > damage->width) ? damage->width : x1) - rect->x;
+		rect->height = ((y1 > damage->height) ? damage->height : y1) - rect->y;
+	}
+
+	count = st7789_DamageMerge(rects, count);
+
+	damage->windows = count;
+	damage->pixels = 0;
+	for (uint16_t i = 0; i < count; ++i) {
+		damage->pixels += (uint32_t)rects[i].width * rects[i].height;
+	}
+	return count;
+}
+
+
+// Render callback writes rect->width * rect->height pixels and waits for
+// the transfer before returning
+uint16_t st7789_DamageFlush(st7789_Device *device, st7789_Damage *damage, st7789_DamageRender render, void *context) {
+	st7789_Rect rects[ST7789_DAMAGE_MAX_RECTS];
+	uint16_t count = st7789_DamageCollect(damage, rects);
+	for (uint16_t i = 0; i < count; ++i) {
+		const st7789_Rect *rect = &rects[i];
+		st7789_SetWindow(device, rect->x, rect->y, rect->x + rect->width - 1, rect->y + rect->height - 1);
+		render(rect, context);
+	}
+	return count;
+}
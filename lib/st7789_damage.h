@@ -0,0 +1,46 @@
+#ifndef ST7789_DAMAGE_H
+#define ST7789_DAMAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Tile size is 1 << ST7789_DAMAGE_TILE_SHIFT pixels, one row of tiles is
+// stored in 64 bit mask
+#define ST7789_DAMAGE_TILE_SHIFT     3
+#define ST7789_DAMAGE_TILE_SIZE      (1 << ST7789_DAMAGE_TILE_SHIFT)
+#define ST7789_DAMAGE_COLUMNS        ((ST7789_MAX_SIZE + ST7789_DAMAGE_TILE_SIZE - 1) >> ST7789_DAMAGE_TILE_SHIFT)
+#define ST7789_DAMAGE_ROWS           ((ST7789_MAX_SIZE + ST7789_DAMAGE_TILE_SIZE - 1) >> ST7789_DAMAGE_TILE_SHIFT)
+// Maximum number of windows emitted by one flush
+#define ST7789_DAMAGE_MAX_RECTS      16
+// Cost of one window in byte times: CASET, RASET, RAMWR (11 bytes) and
+// polling / DMA setup overhead
+#define ST7789_DAMAGE_WINDOW_COST    24
+#define ST7789_DAMAGE_PIXEL_COST     2
+
+#if ST7789_DAMAGE_COLUMNS > 64
+#error "ST7789_DAMAGE_TILE_SHIFT too small for ST7789_MAX_SIZE"
+#endif
+
+
+// Called for every window after st7789_SetWindow, must write all pixels
+typedef void (*st7789_DamageRender)(const st7789_Rect *rect, void *context);
+
+typedef struct st7789_Damage {
+	uint64_t tiles[ST7789_DAMAGE_ROWS];
+	uint16_t width;
+	uint16_t height;
+	uint16_t windows;  // Windows emitted by last flush
+	uint32_t pixels;   // Pixels rendered by last flush
+} st7789_Damage;
+
+void st7789_DamageInit(st7789_Damage *damage, uint16_t width, uint16_t height);
+void st7789_DamageAdd(st7789_Damage *damage, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+void st7789_DamageAll(st7789_Damage *damage);
+bool st7789_DamageEmpty(const st7789_Damage *damage);
+uint16_t st7789_DamageCollect(st7789_Damage *damage, st7789_Rect *rects);
+uint16_t st7789_DamageFlush(st7789_Device *device, st7789_Damage *damage, st7789_DamageRender render, void *context);
+
+#endif
@@ -0,0 +1,272 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "st7789.h"
+#include "st7789_display_list.h"
+#include "st7789_pixels.h"
+#include "st7789_stats.h"
+
+
+// Band being rasterised, rows [y, y + height) and columns [x, x + width) of screen
+typedef struct st7789_Band {
+	uint16_t *pixels;
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+} st7789_Band;
+
+
+// Intersection of item with band, returns false if empty
+static bool st7789_DisplayListClip(const st7789_DisplayItem *item, const st7789_Band *band, st7789_Rect *clip) {
+	uint16_t x0 = (item->x > band->x) ? item->x : band->x;
+	uint16_t y0 = (item->y > band->y) ? item->y : band->y;
+	uint32_t x1 = (uint32_t)item->x + item->width;
+	uint32_t y1 = (uint32_t)item->y + item->height;
+	if (x1 > (uint32_t)band->x + band->width) {
+		x1 = (uint32_t)band->x + band->width;
+	}
+	if (y1 > (uint32_t)band->y + band->height) {
+		y1 = (uint32_t)band->y + band->height;
+	}
+	if (x0 >= x1 || y0 >= y1) {
+		return false;
+	}
+	clip->x = x0;
+	clip->y = y0;
+	clip->width = (uint16_t)(x1 - x0);
+	clip->height = (uint16_t)(y1 - y0);
+	return true;
+}
+
+
+static void st7789_DisplayListDrawText(const st7789_DisplayItem *item, const st7789_Band *band, const st7789_Rect *clip) {
+	const st7789_Font *font = item->font;
+	const char *text = (const char *)item->data;
+	uint16_t rowBytes = (font->width + 7) / 8;
+	uint16_t glyphSize = rowBytes * font->height;
+	for (uint16_t y = clip->y; y < clip->y + clip->height; ++y) {
+		uint16_t *out = band->pixels + (y - band->y) * band->width + (clip->x - band->x);
+		uint16_t glyphRow = y - item->y;
+		for (uint16_t x = clip->x; x < clip->x + clip->width; ++x, ++out) {
+			uint16_t offset = x - item->x;
+			uint8_t character = (uint8_t)text[offset / font->width];
+			uint16_t column = offset % font->width;
+			bool set = false;
+			if (character >= font->firstChar && character <= font->lastChar) {
+				const uint8_t *row = font->data + (character - font->firstChar) * glyphSize + glyphRow * rowBytes;
+				set = (row[column >> 3] >> (column & 7)) & 1;
+			}
+			if (set) {
+				*out = item->color;
+			}
+			else if (!item->transparent) {
+				*out = item->background;
+			}
+		}
+	}
+}
+
+
+static void st7789_DisplayListDraw(const st7789_DisplayItem *item, const st7789_Band *band) {
+	st7789_Rect clip;
+	if (!st7789_DisplayListClip(item, band, &clip)) {
+		return;
+	}
+	uint16_t *out = band->pixels + (clip.y - band->y) * band->width + (clip.x - band->x);
+	switch (item->type) {
+		case ST7789_DISPLAY_RECT:
+			for (uint16_t row = 0; row < clip.height; ++row, out += band->width) {
+				st7789_PixelFill(out, item->color, clip.width);
+			}
+			break;
+		case ST7789_DISPLAY_BLIT: {
+			const uint16_t *in = (const uint16_t *)item->data + (clip.y - item->y) * item->width + (clip.x - item->x);
+			for (uint16_t row = 0; row < clip.height; ++row, out += band->width, in += item->width) {
+				st7789_PixelCopy(out, in, clip.width);
+			}
+			break;
+		}
+		case ST7789_DISPLAY_SPRITE: {
+			st7789_Rect source = {(uint16_t)(clip.x - item->x), (uint16_t)(clip.y - item->y), clip.width, clip.height};
+			st7789_BlitIndexed(out, band->width, (const st7789_Bitmap *)item->data, item->palette, &source);
+			break;
+		}
+		case ST7789_DISPLAY_TEXT:
+			st7789_DisplayListDrawText(item, band, &clip);
+			break;
+		default:
+			break;
+	}
+}
+
+
+static st7789_DisplayItem *st7789_DisplayListAdd(st7789_DisplayList *list, uint8_t type, uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+	if (list->count >= list->capacity || width == 0 || height == 0 || x >= ST7789_MAX_SIZE || y >= ST7789_MAX_SIZE) {
+		return NULL;
+	}
+	uint16_t index = list->count++;
+	uint16_t band = y / ST7789_DISPLAY_LIST_BUCKET_ROWS;
+	st7789_DisplayItem *item = &list->items[index];
+	item->type = type;
+	item->transparent = false;
+	item->next = ST7789_DISPLAY_LIST_NONE;
+	item->nextActive = ST7789_DISPLAY_LIST_NONE;
+	item->x = x;
+	item->y = y;
+	item->width = width;
+	item->height = height;
+	item->color = 0;
+	item->background = 0;
+	item->data = NULL;
+	item->font = NULL;
+	item->palette = NULL;
+	// Buckets keep items in drawing order
+	if (list->bucketHead[band] == ST7789_DISPLAY_LIST_NONE) {
+		list->bucketHead[band] = index;
+	}
+	else {
+		list->items[list->bucketTail[band]].next = index;
+	}
+	list->bucketTail[band] = index;
+	return item;
+}
+
+
+// Band buffers hold two bands of full screen width, band height is rounded
+// up to even to keep RGB444 pixel pairs inside one band
+void st7789_DisplayListInit(st7789_DisplayList *list, st7789_DisplayItem *items, uint16_t capacity, uint16_t *bandBuffers, uint16_t bandHeight) {
+	list->items = items;
+	list->capacity = capacity;
+	list->bandBuffers = bandBuffers;
+	list->bandHeight = (bandHeight < 2) ? 2 : (bandHeight + 1) & ~1;
+	st7789_DisplayListClear(list, 0x0000);
+}
+
+
+void st7789_DisplayListClear(st7789_DisplayList *list, uint16_t background) {
+	list->count = 0;
+	list->background = background;
+	for (uint16_t band = 0; band < ST7789_DISPLAY_LIST_MAX_BANDS; ++band) {
+		list->bucketHead[band] = ST7789_DISPLAY_LIST_NONE;
+		list->bucketTail[band] = ST7789_DISPLAY_LIST_NONE;
+	}
+}
+
+
+bool st7789_DisplayListRect(st7789_DisplayList *list, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color) {
+	st7789_DisplayItem *item = st7789_DisplayListAdd(list, ST7789_DISPLAY_RECT, x, y, width, height);
+	if (item == NULL) {
+		return false;
+	}
+	item->color = color;
+	return true;
+}
+
+
+bool st7789_DisplayListSpan(st7789_DisplayList *list, uint16_t x, uint16_t y, uint16_t length, uint16_t color) {
+	return st7789_DisplayListRect(list, x, y, length, 1, color);
+}
+
+
+// Text is not copied
+bool st7789_DisplayListText(st7789_DisplayList *list, uint16_t x, uint16_t y, const st7789_Font *font, const char *text, uint16_t color, uint16_t background, bool transparent) {
+	st7789_DisplayItem *item = st7789_DisplayListAdd(list, ST7789_DISPLAY_TEXT, x, y, (uint16_t)(strlen(text) * font->width), font->height);
+	if (item == NULL) {
+		return false;
+	}
+	item->transparent = transparent;
+	item->color = color;
+	item->background = background;
+	item->data = text;
+	item->font = font;
+	return true;
+}
+
+
+bool st7789_DisplayListBlit(st7789_DisplayList *list, uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint16_t *pixels) {
+	st7789_DisplayItem *item = st7789_DisplayListAdd(list, ST7789_DISPLAY_BLIT, x, y, width, height);
+	if (item == NULL) {
+		return false;
+	}
+	item->data = pixels;
+	return true;
+}
+
+
+// Sprite is composited over items added before it
+bool st7789_DisplayListSprite(st7789_DisplayList *list, uint16_t x, uint16_t y, const st7789_Bitmap *bitmap, const st7789_Palette *palette) {
+	st7789_DisplayItem *item = st7789_DisplayListAdd(list, ST7789_DISPLAY_SPRITE, x, y, bitmap->width, bitmap->height);
+	if (item == NULL) {
+		return false;
+	}
+	item->data = bitmap;
+	item->palette = palette;
+	return true;
+}
+
+
+// Streams area (whole screen if NULL) band by band, next band is rasterised
+// while previous one is sent by DMA. Bands start at top of area, so all but
+// the last one have even number of rows.
+void st7789_DisplayListRender(st7789_Device *device, st7789_DisplayList *list, const st7789_Rect *area) {
+	st7789_Rect screen = {0, 0, device->width, device->height};
+	if (area == NULL) {
+		area = &screen;
+	}
+	if (area->width == 0 || area->height == 0) {
+		return;
+	}
+	st7789_DisplayItem *items = list->items;
+	uint16_t active = ST7789_DISPLAY_LIST_NONE;
+	uint16_t areaBottom = area->y + area->height;
+	uint16_t bucket = 0;
+	uint8_t bufferIndex = 0;
+
+	st7789_SetWindow(device, area->x, area->y, area->x + area->width - 1, areaBottom - 1);
+	for (uint16_t bandTop = area->y; bandTop < areaBottom; bandTop += list->bandHeight) {
+		uint16_t bandBottom = (areaBottom - bandTop < list->bandHeight) ? areaBottom : bandTop + list->bandHeight;
+		// Merge buckets of items starting above band bottom into active list,
+		// both are ordered by item index. Items of bucket starting below the
+		// band are clipped out and stay active.
+		uint16_t *link;
+		for (; bucket <= (bandBottom - 1) / ST7789_DISPLAY_LIST_BUCKET_ROWS && bucket < ST7789_DISPLAY_LIST_MAX_BANDS; ++bucket) {
+			link = &active;
+			uint16_t incoming = list->bucketHead[bucket];
+			while (incoming != ST7789_DISPLAY_LIST_NONE) {
+				while (*link != ST7789_DISPLAY_LIST_NONE && *link < incoming) {
+					link = &items[*link].nextActive;
+				}
+				items[incoming].nextActive = *link;
+				*link = incoming;
+				link = &items[incoming].nextActive;
+				incoming = items[incoming].next;
+			}
+		}
+
+		st7789_Band raster;
+		raster.pixels = list->bandBuffers + bufferIndex * area->width * list->bandHeight;
+		raster.x = area->x;
+		raster.y = bandTop;
+		raster.width = area->width;
+		raster.height = bandBottom - bandTop;
+
+		ST7789_STATS_TICKS(renderStart);
+		st7789_PixelFill(raster.pixels, list->background, raster.width * raster.height);
+		link = &active;
+		while (*link != ST7789_DISPLAY_LIST_NONE) {
+			st7789_DisplayItem *item = &items[*link];
+			st7789_DisplayListDraw(item, &raster);
+			if (item->y + item->height <= bandBottom) {
+				*link = item->nextActive;
+			}
+			else {
+				link = &item->nextActive;
+			}
+		}
+		ST7789_STATS_ADD(device, ST7789_STATS_RENDER, renderStart);
+		st7789_WritePixels(device, raster.pixels, (uint32_t)raster.width * raster.height);
+		bufferIndex ^= 1;
+	}
+	st7789_WaitForDMA(device);
+}
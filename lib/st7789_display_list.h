@@ -0,0 +1,61 @@
+#ifndef ST7789_DISPLAY_LIST_H
+#define ST7789_DISPLAY_LIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+#include "st7789_blit.h"
+
+
+// Items are sorted to buckets of ST7789_DISPLAY_LIST_BUCKET_ROWS rows by
+// their first row, independently of band height
+#define ST7789_DISPLAY_LIST_MAX_BANDS    40
+#define ST7789_DISPLAY_LIST_BUCKET_ROWS  ((ST7789_MAX_SIZE + ST7789_DISPLAY_LIST_MAX_BANDS - 1) / ST7789_DISPLAY_LIST_MAX_BANDS)
+#define ST7789_DISPLAY_LIST_NONE         0xffff
+
+
+typedef enum st7789_DisplayItemType {
+	ST7789_DISPLAY_RECT,  // Filled rectangle
+	ST7789_DISPLAY_TEXT,  // Run of 1bpp glyphs
+	ST7789_DISPLAY_BLIT,  // RGB565 pixels, usually from flash
+	ST7789_DISPLAY_SPRITE, // Indexed bitmap with optional transparency
+} st7789_DisplayItemType;
+
+typedef struct st7789_DisplayItem {
+	uint8_t type;
+	bool transparent;     // Text background is not drawn
+	uint16_t next;        // Next item in bucket of first row
+	uint16_t nextActive;  // Next item overlapping current band
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+	uint16_t color;
+	uint16_t background;
+	const void *data;     // Text, pixels or bitmap, must stay valid until render
+	const st7789_Font *font;
+	const st7789_Palette *palette;
+} st7789_DisplayItem;
+
+typedef struct st7789_DisplayList {
+	st7789_DisplayItem *items;
+	uint16_t capacity;
+	uint16_t count;
+	uint16_t bandHeight;
+	uint16_t background;
+	uint16_t *bandBuffers; // 2 * screen width * bandHeight pixels (even band height)
+	uint16_t bucketHead[ST7789_DISPLAY_LIST_MAX_BANDS];
+	uint16_t bucketTail[ST7789_DISPLAY_LIST_MAX_BANDS];
+} st7789_DisplayList;
+
+void st7789_DisplayListInit(st7789_DisplayList *list, st7789_DisplayItem *items, uint16_t capacity, uint16_t *bandBuffers, uint16_t bandHeight);
+void st7789_DisplayListClear(st7789_DisplayList *list, uint16_t background);
+bool st7789_DisplayListRect(st7789_DisplayList *list, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color);
+bool st7789_DisplayListSpan(st7789_DisplayList *list, uint16_t x, uint16_t y, uint16_t length, uint16_t color);
+bool st7789_DisplayListText(st7789_DisplayList *list, uint16_t x, uint16_t y, const st7789_Font *font, const char *text, uint16_t color, uint16_t background, bool transparent);
+bool st7789_DisplayListBlit(st7789_DisplayList *list, uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint16_t *pixels);
+bool st7789_DisplayListSprite(st7789_DisplayList *list, uint16_t x, uint16_t y, const st7789_Bitmap *bitmap, const st7789_Palette *palette);
+void st7789_DisplayListRender(st7789_Device *device, st7789_DisplayList *list, const st7789_Rect *area);
+
+#endif
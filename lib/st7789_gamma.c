@@ -0,0 +1,47 @@
+#include <stddef.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_gamma.h"
+
+
+#define ST7789_GAMMA_IDENTITY \
+	{ \
+		 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, \
+		16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, \
+		32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, \
+		48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, \
+	}
+
+
+const st7789_Gamma st7789_Gamma_1_3_LCD = {
+	ST7789_GAMMA_CURVE_2_2,
+	{0xd0, 0x08, 0x11, 0x08, 0x0c, 0x15, 0x39, 0x33, 0x50, 0x36, 0x13, 0x14, 0x29, 0x2d},
+	{0xd0, 0x08, 0x10, 0x08, 0x06, 0x06, 0x39, 0x44, 0x51, 0x0b, 0x16, 0x14, 0x2f, 0x31},
+	false,
+	ST7789_GAMMA_IDENTITY,
+	ST7789_GAMMA_IDENTITY,
+};
+
+
+// DGMEN is cleared while tables are written, panel never shows half
+// updated table
+void st7789_SetGamma(st7789_Device *device, const st7789_Gamma *gamma) {
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_GAMSET, &gamma->curve, 1);
+	st7789_WriteCommand(device, ST7789_CMD_PVGAMCTRL, gamma->positive, ST7789_GAMMA_CURVE_SIZE);
+	st7789_WriteCommand(device, ST7789_CMD_NVGAMCTRL, gamma->negative, ST7789_GAMMA_CURVE_SIZE);
+	st7789_SetDigitalGamma(device, false);
+	if (gamma->digital) {
+		st7789_WriteCommand(device, ST7789_CMD_DGMLUTR, gamma->red, ST7789_GAMMA_LUT_SIZE);
+		st7789_WriteCommand(device, ST7789_CMD_DGMLUTB, gamma->blue, ST7789_GAMMA_LUT_SIZE);
+		st7789_SetDigitalGamma(device, true);
+	}
+}
+
+
+void st7789_SetDigitalGamma(st7789_Device *device, bool enable) {
+	uint8_t dgmen = enable ? 0x04 : 0x00;
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_DGMEN, &dgmen, 1);
+}
@@ -0,0 +1,45 @@
+#ifndef ST7789_GAMMA_H
+#define ST7789_GAMMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Colour calibration done by panel: GAMSET selects one of predefined analog
+// curves, PVGAMCTRL / NVGAMCTRL tune its voltage taps and digital gamma
+// (DGMEN) remaps 6 bit red and blue levels before they reach the source
+// driver. Green has no digital table, it is the reference channel.
+// Tables are generated from measured response by
+// example/blue_pill/speed_demo/gamma_tables.py.
+
+#define ST7789_GAMMA_CURVE_SIZE      14
+#define ST7789_GAMMA_LUT_SIZE        64
+
+// GAMSET parameter
+#define ST7789_GAMMA_CURVE_2_2       0x01
+#define ST7789_GAMMA_CURVE_1_8       0x02
+#define ST7789_GAMMA_CURVE_2_5       0x04
+#define ST7789_GAMMA_CURVE_1_0       0x08
+
+
+typedef struct st7789_Gamma {
+	uint8_t curve;                              // GAMSET
+	uint8_t positive[ST7789_GAMMA_CURVE_SIZE];  // PVGAMCTRL
+	uint8_t negative[ST7789_GAMMA_CURVE_SIZE];  // NVGAMCTRL
+	bool digital;                               // DGMEN, tables are not sent when false
+	uint8_t red[ST7789_GAMMA_LUT_SIZE];         // DGMLUTR, 6 bit output of 6 bit level
+	uint8_t blue[ST7789_GAMMA_LUT_SIZE];        // DGMLUTB
+} st7789_Gamma;
+
+
+// Analog curves of 1.3" 240x240 module, identity digital tables
+extern const st7789_Gamma st7789_Gamma_1_3_LCD;
+
+// Waits for DMA, sends curve, tap voltages and digital tables (about 170
+// bytes) once after init instead of correcting pixels on CPU
+void st7789_SetGamma(st7789_Device *device, const st7789_Gamma *gamma);
+void st7789_SetDigitalGamma(st7789_Device *device, bool enable);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "st7789.h"
+#include "st7789_image.h"
+#include "st7789_stats.h"
+
+
+// Longest op: tag and two bytes
+#define ST7789_IMAGE_MAX_OP 3
+
+
+static uint8_t st7789_ImageHash(uint16_t pixel) {
+	return (uint8_t)(((pixel >> 11) * 3 + ((pixel >> 5) & 0x3f) * 5 + (pixel & 0x1f) * 7) & (ST7789_IMAGE_INDEX_SIZE - 1));
+}
+
+
+// Makes at least need bytes available if stream has them, returns available
+// byte count
+static uint32_t st7789_ImageRefill(st7789_Image *image, uint32_t need) {
+	uint32_t available = (uint32_t)(image->inputEnd - image->input);
+	if (available >= need || image->read == NULL) {
+		return available;
+	}
+	memmove(image->buffer, image->input, available);
+	image->input = image->buffer;
+	while (available < need) {
+		uint32_t size = image->read(image->context, image->buffer + available, ST7789_IMAGE_INPUT_SIZE - available);
+		if (size == 0) {
+			break;
+		}
+		available += size;
+	}
+	image->inputEnd = image->buffer + available;
+	return available;
+}
+
+
+static bool st7789_ImageStart(st7789_Image *image) {
+	image->previous = 0x0000;
+	image->run = 0;
+	memset(image->index, 0, sizeof(image->index));
+	if (st7789_ImageRefill(image, ST7789_IMAGE_HEADER_SIZE) < ST7789_IMAGE_HEADER_SIZE) {
+		image->remaining = 0;
+		return false;
+	}
+	const uint8_t *header = image->input;
+	image->input += ST7789_IMAGE_HEADER_SIZE;
+	image->width = (uint16_t)(header[4] | (header[5] << 8));
+	image->height = (uint16_t)(header[6] | (header[7] << 8));
+	image->remaining = (uint32_t)image->width * image->height;
+	return memcmp(header, "q565", 4) == 0;
+}
+
+
+bool st7789_ImageOpen(st7789_Image *image, const uint8_t *data, uint32_t size) {
+	image->input = data;
+	image->inputEnd = data + size;
+	image->read = NULL;
+	image->context = NULL;
+	return st7789_ImageStart(image);
+}
+
+
+bool st7789_ImageOpenStream(st7789_Image *image, st7789_ImageRead read, void *context) {
+	image->input = image->buffer;
+	image->inputEnd = image->buffer;
+	image->read = read;
+	image->context = context;
+	return st7789_ImageStart(image);
+}
+
+
+// Decodes up to count pixels, returns less only at end of image or stream
+uint32_t st7789_ImageDecode(st7789_Image *image, uint16_t *pixels, uint32_t count) {
+	uint16_t *out = pixels;
+	uint16_t *end;
+	uint16_t pixel = image->previous;
+	if (count > image->remaining) {
+		count = image->remaining;
+	}
+	end = pixels + count;
+	while (out < end) {
+		if (image->run > 0) {
+			uint32_t length = (uint32_t)(end - out);
+			if (length > image->run) {
+				length = image->run;
+			}
+			image->run -= (uint8_t)length;
+			while (length--) {
+				*out++ = pixel;
+			}
+			continue;
+		}
+		uint32_t available = st7789_ImageRefill(image, ST7789_IMAGE_MAX_OP);
+		if (available == 0) {
+			break;
+		}
+		const uint8_t *input = image->input;
+		uint8_t tag = *input++;
+		if (tag == ST7789_IMAGE_OP_PIXEL) {
+			if (available < 3) {
+				break;
+			}
+			pixel = (uint16_t)(input[0] | (input[1] << 8));
+			input += 2;
+		}
+		else if ((tag & ST7789_IMAGE_OP_MASK) == ST7789_IMAGE_OP_INDEX) {
+			pixel = image->index[tag];
+		}
+		else if ((tag & ST7789_IMAGE_OP_MASK) == ST7789_IMAGE_OP_DIFF) {
+			uint16_t r = ((pixel >> 11) + ((tag >> 4) & 0x03) - 2) & 0x1f;
+			uint16_t g = (((pixel >> 5) & 0x3f) + ((tag >> 2) & 0x03) - 2) & 0x3f;
+			uint16_t b = ((pixel & 0x1f) + (tag & 0x03) - 2) & 0x1f;
+			pixel = (uint16_t)((r << 11) | (g << 5) | b);
+		}
+		else if ((tag & ST7789_IMAGE_OP_MASK) == ST7789_IMAGE_OP_LUMA) {
+			if (available < 2) {
+				break;
+			}
+			int16_t dg = (int16_t)(tag & 0x3f) - 32;
+			uint8_t second = *input++;
+			uint16_t r = ((pixel >> 11) + dg + (second >> 4) - 8) & 0x1f;
+			uint16_t g = (((pixel >> 5) & 0x3f) + dg) & 0x3f;
+			uint16_t b = ((pixel & 0x1f) + dg + (second & 0x0f) - 8) & 0x1f;
+			pixel = (uint16_t)((r << 11) | (g << 5) | b);
+		}
+		else {
+			// Run, current pixel is written by run loop
+			image->input = input;
+			image->run = (uint8_t)((tag & 0x3f) + 1);
+			continue;
+		}
+		image->input = input;
+		image->index[st7789_ImageHash(pixel)] = pixel;
+		*out++ = pixel;
+	}
+	image->previous = pixel;
+	count = (uint32_t)(out - pixels);
+	image->remaining -= count;
+	return count;
+}
+
+
+// Whole image into one window, halves of band alternate between decoding and
+// DMA transfer. Returns false if image does not fit to screen or is truncated.
+bool st7789_ImageDraw(st7789_Device *device, st7789_Image *image, uint16_t x, uint16_t y, uint16_t *band, uint32_t bandPixels) {
+	uint32_t half = (bandPixels / 2) & ~1u;
+	uint8_t bufferIndex = 0;
+	if (image->width == 0 || image->height == 0 || half == 0 || x + image->width > device->width || y + image->height > device->height) {
+		return false;
+	}
+	st7789_SetWindow(device, x, y, x + image->width - 1, y + image->height - 1);
+	while (image->remaining > 0) {
+		uint16_t *pixels = band + bufferIndex * half;
+		ST7789_STATS_TICKS(decodeStart);
+		uint32_t count = st7789_ImageDecode(image, pixels, half);
+		ST7789_STATS_ADD(device, ST7789_STATS_RENDER, decodeStart);
+		if (count == 0) {
+			break;
+		}
+		st7789_WritePixels(device, pixels, count);
+		bufferIndex ^= 1;
+	}
+	st7789_WaitForDMA(device);
+	if (image->remaining > 0) {
+		st7789_InvalidateWindow(device);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef ST7789_IMAGE_H
+#define ST7789_IMAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Compressed RGB565 image (QOI style ops on 565 components):
+//
+//   header     "q565", width and height as 16 bit little endian
+//   00iiiiii   pixel from index of recently seen pixels, hash i
+//   01rrggbb   difference to previous pixel, each component -2..1 (biased 2)
+//   10gggggg   green difference -32..31 (biased 32), next byte holds
+//   rrrrbbbb   red and blue difference minus green difference -8..7 (biased 8)
+//   11nnnnnn   previous pixel repeated n + 1 times, n < 62
+//   11111110   literal pixel, 16 bit little endian
+//
+// Differences wrap around component width, hash is (r * 3 + g * 5 + b * 7) % 64.
+#define ST7789_IMAGE_HEADER_SIZE     8
+#define ST7789_IMAGE_INDEX_SIZE      64
+// Read buffer of streamed images
+#define ST7789_IMAGE_INPUT_SIZE      256
+
+#define ST7789_IMAGE_OP_INDEX        0x00
+#define ST7789_IMAGE_OP_DIFF         0x40
+#define ST7789_IMAGE_OP_LUMA         0x80
+#define ST7789_IMAGE_OP_RUN          0xc0
+#define ST7789_IMAGE_OP_PIXEL        0xfe
+#define ST7789_IMAGE_OP_MASK         0xc0
+
+
+// Returns number of bytes stored to buffer, 0 at end of stream
+typedef uint32_t (*st7789_ImageRead)(void *context, uint8_t *buffer, uint32_t size);
+
+typedef struct st7789_Image {
+	const uint8_t *input;
+	const uint8_t *inputEnd;
+	st7789_ImageRead read;
+	void *context;
+	uint16_t width;
+	uint16_t height;
+	uint32_t remaining;     // Pixels not decoded yet
+	uint16_t previous;
+	uint8_t run;
+	uint16_t index[ST7789_IMAGE_INDEX_SIZE];
+	uint8_t buffer[ST7789_IMAGE_INPUT_SIZE];
+} st7789_Image;
+
+// Image in memory (flash) or read in pieces by callback
+bool st7789_ImageOpen(st7789_Image *image, const uint8_t *data, uint32_t size);
+bool st7789_ImageOpenStream(st7789_Image *image, st7789_ImageRead read, void *context);
+uint32_t st7789_ImageDecode(st7789_Image *image, uint16_t *pixels, uint32_t count);
+bool st7789_ImageDraw(st7789_Device *device, st7789_Image *image, uint16_t x, uint16_t y, uint16_t *band, uint32_t bandPixels);
+
+#endif
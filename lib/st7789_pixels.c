@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include "st7789_pixels.h"
+
+
+// Green in upper half word, red and blue in lower, 5 bit gaps for products
+#define ST7789_PIXEL_SPREAD_MASK     0x07e0f81fu
+
+
+static inline uint32_t st7789_PixelSpread(uint16_t pixel) {
+	return (pixel | ((uint32_t)pixel << 16)) & ST7789_PIXEL_SPREAD_MASK;
+}
+
+
+static inline uint16_t st7789_PixelPack(uint32_t spread) {
+	spread &= ST7789_PIXEL_SPREAD_MASK;
+	return (uint16_t)(spread | (spread >> 16));
+}
+
+
+// dst + (src - dst) * alpha / 32 for all components in one multiply, borrow
+// of negative difference stays inside the gap above each component
+static inline uint16_t st7789_PixelMix(uint16_t dst, uint16_t src, uint32_t alpha) {
+	uint32_t d = st7789_PixelSpread(dst);
+	uint32_t s = st7789_PixelSpread(src);
+	return st7789_PixelPack(d + (((s - d) * alpha) >> 5));
+}
+
+
+// Stores of four words are emitted as STM
+void st7789_PixelFill(uint16_t *out, uint16_t color, uint32_t count) {
+	if (count > 0 && ((uintptr_t)out & 2)) {
+		*out++ = color;
+		count--;
+	}
+	uint32_t pair = color | ((uint32_t)color << 16);
+	uint32_t *words = (uint32_t *)out;
+	while (count >= 8) {
+		words[0] = pair;
+		words[1] = pair;
+		words[2] = pair;
+		words[3] = pair;
+		words += 4;
+		count -= 8;
+	}
+	while (count >= 2) {
+		*words++ = pair;
+		count -= 2;
+	}
+	if (count) {
+		*(uint16_t *)words = color;
+	}
+}
+
+
+// LDM/STM bursts of four words when both buffers have same word alignment
+void st7789_PixelCopy(uint16_t *out, const uint16_t *in, uint32_t count) {
+	if ((((uintptr_t)out ^ (uintptr_t)in) & 2) != 0) {
+		while (count--) {
+			*out++ = *in++;
+		}
+		return;
+	}
+	if (count > 0 && ((uintptr_t)out & 2)) {
+		*out++ = *in++;
+		count--;
+	}
+	uint32_t *dst = (uint32_t *)out;
+	const uint32_t *src = (const uint32_t *)in;
+	while (count >= 8) {
+		uint32_t a = src[0];
+		uint32_t b = src[1];
+		uint32_t c = src[2];
+		uint32_t d = src[3];
+		dst[0] = a;
+		dst[1] = b;
+		dst[2] = c;
+		dst[3] = d;
+		src += 4;
+		dst += 4;
+		count -= 8;
+	}
+	while (count >= 2) {
+		*dst++ = *src++;
+		count -= 2;
+	}
+	if (count) {
+		*(uint16_t *)dst = *(const uint16_t *)src;
+	}
+}
+
+
+// Constant alpha 0 .. ST7789_ALPHA_MAX
+void st7789_PixelBlend(uint16_t *out, const uint16_t *in, uint8_t alpha, uint32_t count) {
+	if (alpha == 0) {
+		return;
+	}
+	if (alpha >= ST7789_ALPHA_MAX) {
+		st7789_PixelCopy(out, in, count);
+		return;
+	}
+	while (count--) {
+		*out = st7789_PixelMix(*out, *in++, alpha);
+		out++;
+	}
+}
+
+
+// Alpha 0 .. 255 per pixel, rounded to 0 .. ST7789_ALPHA_MAX
+void st7789_PixelBlendAlpha(uint16_t *out, const uint16_t *in, const uint8_t *alpha, uint32_t count) {
+	while (count--) {
+		uint32_t a = ((uint32_t)*alpha++ + 4) >> 3;
+		if (a == ST7789_ALPHA_MAX) {
+			*out = *in;
+		}
+		else if (a != 0) {
+			*out = st7789_PixelMix(*out, *in, a);
+		}
+		out++;
+		in++;
+	}
+}
+
+
+// Components are truncated, four pixels are read as three words
+void st7789_PixelFromRGB888(uint16_t *out, const uint8_t *rgb, uint32_t count) {
+	while (count >= 4) {
+		uint32_t w0;
+		uint32_t w1;
+		uint32_t w2;
+		memcpy(&w0, rgb, 4);
+		memcpy(&w1, rgb + 4, 4);
+		memcpy(&w2, rgb + 8, 4);
+		// Bytes r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+		out[0] = (uint16_t)(((w0 & 0xf8) << 8) | ((w0 >> 5) & 0x07e0) | ((w0 >> 19) & 0x1f));
+		out[1] = (uint16_t)(((w0 >> 16) & 0xf800) | ((w1 << 3) & 0x07e0) | ((w1 >> 11) & 0x1f));
+		out[2] = (uint16_t)((w1 & 0xf80000) >> 8 | ((w1 >> 21) & 0x07e0) | ((w2 >> 3) & 0x1f));
+		out[3] = (uint16_t)((w2 & 0xf800) | ((w2 >> 13) & 0x07e0) | (w2 >> 27));
+		rgb += 12;
+		out += 4;
+		count -= 4;
+	}
+	while (count--) {
+		*out++ = (uint16_t)(((rgb[0] & 0xf8) << 8) | ((rgb[1] & 0xfc) << 3) | (rgb[2] >> 3));
+		rgb += 3;
+	}
+}
+
+
+// Byte swap of big endian RAMCTRL mode, pairs of pixels become REV16
+void st7789_PixelSwap(uint16_t *out, const uint16_t *in, uint32_t count) {
+	if ((((uintptr_t)out | (uintptr_t)in) & 2) == 0) {
+		uint32_t *dst = (uint32_t *)out;
+		const uint32_t *src = (const uint32_t *)in;
+		while (count >= 2) {
+			uint32_t word = *src++;
+			*dst++ = ((word & 0xff00ff00u) >> 8) | ((word & 0x00ff00ffu) << 8);
+			count -= 2;
+		}
+		out = (uint16_t *)dst;
+		in = (const uint16_t *)src;
+	}
+	while (count--) {
+		uint16_t pixel = *in++;
+		*out++ = (uint16_t)((pixel << 8) | (pixel >> 8));
+	}
+}
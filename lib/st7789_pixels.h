@@ -0,0 +1,21 @@
+#ifndef ST7789_PIXELS_H
+#define ST7789_PIXELS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Alpha of blending functions, 0 keeps destination, 32 copies source
+#define ST7789_ALPHA_MAX             32
+
+// Line buffer kernels, two RGB565 pixels are processed as one 32 bit word
+// where buffer alignment allows it
+void st7789_PixelFill(uint16_t *out, uint16_t color, uint32_t count);
+void st7789_PixelCopy(uint16_t *out, const uint16_t *in, uint32_t count);
+void st7789_PixelBlend(uint16_t *out, const uint16_t *in, uint8_t alpha, uint32_t count);
+void st7789_PixelBlendAlpha(uint16_t *out, const uint16_t *in, const uint8_t *alpha, uint32_t count);
+void st7789_PixelFromRGB888(uint16_t *out, const uint8_t *rgb, uint32_t count);
+void st7789_PixelSwap(uint16_t *out, const uint16_t *in, uint32_t count);
+
+#endif
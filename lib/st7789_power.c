@@ -0,0 +1,200 @@
+#include <stddef.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_power.h"
+#include "st7789_queue.h"
+
+
+// Time spent in current mode is added to its counters
+static void st7789_PowerAccount(st7789_Device *device) {
+	st7789_Power *power = device->power;
+	uint32_t now = st7789_Ticks();
+	uint32_t ticks = now - power->accountStart;
+	power->accountStart = now;
+	power->stats.ticks[power->mode] += ticks;
+	power->stats.energy[power->mode] += (uint64_t)st7789_PowerEstimate(device, power->mode) * ticks / ST7789_TICKS_PER_MS;
+}
+
+
+// Sends only differences between panel state and state of mode, sleep
+// keeps the rest of state for wake
+static void st7789_PowerApply(st7789_Device *device, st7789_PowerMode mode) {
+	st7789_Power *power = device->power;
+	if (mode == ST7789_POWER_SLEEP) {
+		if (!power->sleeping) {
+			st7789_WriteCommand(device, ST7789_CMD_SLPIN, NULL, 0);
+			power->sleeping = true;
+		}
+		return;
+	}
+	if (power->sleeping) {
+		st7789_WriteCommand(device, ST7789_CMD_SLPOUT, NULL, 0);
+		st7789_WaitNanosecs(ST7789_POWER_WAKE_NS);
+		power->sleeping = false;
+	}
+	uint8_t rtn = (mode == ST7789_POWER_FULL) ? ST7789_POWER_RTN_60HZ : power->config.slowRtn;
+	bool idle = mode == ST7789_POWER_IDLE;
+	bool partial = idle && power->partialHeight > 0;
+	if (rtn != power->rtn) {
+		st7789_WriteCommand(device, ST7789_CMD_FRCTR2, &rtn, 1);
+		power->rtn = rtn;
+	}
+	if (idle != power->idle) {
+		st7789_WriteCommand(device, idle ? ST7789_CMD_IDMON : ST7789_CMD_IDMOFF, NULL, 0);
+		power->idle = idle;
+	}
+	if (partial != power->partial) {
+		st7789_WriteCommand(device, partial ? ST7789_CMD_PTLON : ST7789_CMD_NORON, NULL, 0);
+		power->partial = partial;
+	}
+}
+
+
+void st7789_PowerInit(st7789_Device *device, st7789_Power *power, const st7789_PowerConfig *config) {
+	device->power = power;
+	power->config = *config;
+	power->mode = ST7789_POWER_FULL;
+	power->quietFrames = 0;
+	power->drawn = false;
+	power->partialTop = 0;
+	power->partialHeight = 0;
+	power->rtn = ST7789_POWER_RTN_60HZ;
+	power->idle = false;
+	power->partial = false;
+	power->sleeping = false;
+	for (uint8_t mode = 0; mode < ST7789_POWER_MODES; ++mode) {
+		power->stats.frames[mode] = 0;
+		power->stats.ticks[mode] = 0;
+		power->stats.energy[mode] = 0;
+	}
+	power->stats.wakeups = 0;
+	power->accountStart = st7789_Ticks();
+
+	// Separate partial and idle rate, both run at slow rate / 2^divider
+	uint8_t frctrl1[3] = {(uint8_t)(0x10 | (config->idleDivider & 0x03)), config->slowRtn, config->slowRtn};
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_FRCTRL1, frctrl1, sizeof(frctrl1));
+}
+
+
+// Partial area is set in frame memory rows, MY turns it upside down
+void st7789_PowerSetPartial(st7789_Device *device, uint16_t top, uint16_t height) {
+	st7789_Power *power = device->power;
+	if (device->madctl & ST7789_MADCTL_MV) {
+		height = 0;
+	}
+	power->partialTop = top;
+	power->partialHeight = height;
+	if (device->queue != NULL) {
+		st7789_QueueFlush(device);
+	}
+	st7789_WaitForDMA(device);
+	if (height > 0) {
+		uint16_t start = device->yOffset + top;
+		if (device->madctl & ST7789_MADCTL_MY) {
+			start = ST7789_GRAM_HEIGHT - device->yOffset - top - height;
+		}
+		uint16_t end = start + height - 1;
+		uint8_t ptlar[4] = {
+			(uint8_t)(start >> 8),
+			(uint8_t)(start & 0xff),
+			(uint8_t)(end >> 8),
+			(uint8_t)(end & 0xff),
+		};
+		st7789_WriteCommand(device, ST7789_CMD_PTLAR, ptlar, sizeof(ptlar));
+	}
+	if (!power->sleeping) {
+		st7789_PowerApply(device, power->mode);
+	}
+}
+
+
+// Deepest enabled mode reached after frames without drawing
+static st7789_PowerMode st7789_PowerTarget(const st7789_Power *power) {
+	const st7789_PowerConfig *config = &power->config;
+	if (config->sleepFrames > 0 && power->quietFrames >= config->sleepFrames) {
+		return ST7789_POWER_SLEEP;
+	}
+	if (config->idleFrames > 0 && power->quietFrames >= config->idleFrames) {
+		return ST7789_POWER_IDLE;
+	}
+	if (config->slowFrames > 0 && power->quietFrames >= config->slowFrames) {
+		return ST7789_POWER_SLOW;
+	}
+	return ST7789_POWER_FULL;
+}
+
+
+void st7789_PowerFrame(st7789_Device *device) {
+	st7789_Power *power = device->power;
+	power->stats.frames[power->mode]++;
+	// Frame with drawing is not quiet
+	if (power->drawn) {
+		power->drawn = false;
+	}
+	else if (power->quietFrames < UINT32_MAX) {
+		power->quietFrames++;
+	}
+	st7789_PowerMode target = st7789_PowerTarget(power);
+	if (target > power->mode) {
+		st7789_PowerSetMode(device, target);
+	}
+	else {
+		st7789_PowerAccount(device);
+	}
+}
+
+
+// Queue can still run from interrupt, it is drained before mode commands
+void st7789_PowerActivity(st7789_Device *device) {
+	st7789_Power *power = device->power;
+	power->quietFrames = 0;
+	power->drawn = true;
+	if (power->mode == ST7789_POWER_FULL) {
+		return;
+	}
+	power->stats.wakeups++;
+	st7789_PowerSetMode(device, ST7789_POWER_FULL);
+}
+
+
+void st7789_PowerSetMode(st7789_Device *device, st7789_PowerMode mode) {
+	st7789_Power *power = device->power;
+	st7789_PowerAccount(device);
+	if (device->queue != NULL) {
+		st7789_QueueFlush(device);
+	}
+	st7789_WaitForDMA(device);
+	st7789_PowerApply(device, mode);
+	power->mode = mode;
+}
+
+
+st7789_PowerMode st7789_PowerGetMode(const st7789_Device *device) {
+	return device->power->mode;
+}
+
+
+uint32_t st7789_PowerEstimate(const st7789_Device *device, st7789_PowerMode mode) {
+	const st7789_Power *power = device->power;
+	if (mode == ST7789_POWER_SLEEP) {
+		return ST7789_POWER_SLEEP_UW;
+	}
+	// Frame rate relative to 60 Hz is ratio of line periods
+	uint32_t rtn = (mode == ST7789_POWER_FULL) ? ST7789_POWER_RTN_60HZ : power->config.slowRtn;
+	uint32_t scan = ST7789_POWER_SCAN_UW * (250u + 16u * ST7789_POWER_RTN_60HZ) / (250u + 16u * rtn);
+	if (mode == ST7789_POWER_IDLE) {
+		scan = (scan >> power->config.idleDivider) * ST7789_POWER_IDLE_PERCENT / 100;
+		if (power->partialHeight > 0) {
+			scan = scan * power->partialHeight / device->height;
+		}
+	}
+	return ST7789_POWER_STATIC_UW + scan;
+}
+
+
+const st7789_PowerStats *st7789_PowerGetStats(st7789_Device *device) {
+	st7789_PowerAccount(device);
+	return &device->power->stats;
+}
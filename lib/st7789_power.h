@@ -0,0 +1,87 @@
+#ifndef ST7789_POWER_H
+#define ST7789_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Governor lowers panel power while nothing is drawn: frame rate first, then
+// 8 colour idle mode limited to partial area, then sleep. Drawing (window,
+// queued window, scroll) brings full mode back before its first command.
+
+// RTN of FRCTR2 / FRCTRL1, frame rate with porch of init sequence is
+// 10 MHz / ((320 + 12 + 12) * (250 + 16 * RTN))
+#define ST7789_POWER_RTN_60HZ        0x0f
+#define ST7789_POWER_RTN_39HZ        0x1f
+
+// Panel power model without backlight, rough values of 240x240 module at
+// 3.3 V, scan part scales with frame rate, scanned rows and colours
+#define ST7789_POWER_STATIC_UW       3000  // Charge pumps and VCOM
+#define ST7789_POWER_SCAN_UW         10000 // Whole glass at 60 Hz, 262K colours
+#define ST7789_POWER_IDLE_PERCENT    30    // Scan power left in 8 colour mode
+#define ST7789_POWER_SLEEP_UW        30
+
+// Time to wait after SLPOUT before next command
+#define ST7789_POWER_WAKE_NS         5000000
+
+
+typedef enum st7789_PowerMode {
+	ST7789_POWER_FULL,  // Normal mode, 60 Hz
+	ST7789_POWER_SLOW,  // Frame rate of slowRtn
+	ST7789_POWER_IDLE,  // IDMON, PTLON when partial area is set, FRCTRL1 rate
+	ST7789_POWER_SLEEP, // SLPIN, frame memory is kept
+	ST7789_POWER_MODES,
+} st7789_PowerMode;
+
+// Frames without drawing before mode is entered, 0 skips mode
+typedef struct st7789_PowerConfig {
+	uint16_t slowFrames;
+	uint16_t idleFrames;
+	uint16_t sleepFrames;
+	uint8_t slowRtn;     // FRCTR2 RTN of slow mode
+	uint8_t idleDivider; // FRCTRL1 DIV, idle rate is slow rate / 2^idleDivider
+} st7789_PowerConfig;
+
+typedef struct st7789_PowerStats {
+	uint32_t frames[ST7789_POWER_MODES]; // st7789_PowerFrame calls
+	uint64_t ticks[ST7789_POWER_MODES];
+	uint64_t energy[ST7789_POWER_MODES]; // Estimated nJ
+	uint32_t wakeups;                    // Returns to full mode caused by drawing
+} st7789_PowerStats;
+
+typedef struct st7789_Power {
+	st7789_PowerConfig config;
+	st7789_PowerMode mode;
+	uint32_t quietFrames;   // Frames since last drawing
+	bool drawn;             // Drawing since last st7789_PowerFrame
+	uint16_t partialTop;    // Display rows scanned in idle mode, 0 height
+	uint16_t partialHeight; // for whole glass
+	// State set on panel
+	uint8_t rtn;
+	bool idle;
+	bool partial;
+	bool sleeping;
+	uint32_t accountStart;  // st7789_Ticks of last accounting
+	st7789_PowerStats stats;
+} st7789_Power;
+
+
+// Call after panel init, sends FRCTRL1 of idle mode
+void st7789_PowerInit(st7789_Device *device, st7789_Power *power, const st7789_PowerConfig *config);
+// Rows of glass kept alive in idle mode, not available with MADCTL MV
+void st7789_PowerSetPartial(st7789_Device *device, uint16_t top, uint16_t height);
+// Once per refresh frame from main loop (not from interrupt), enters deeper
+// modes. Called at least every 30 s to keep accounting in range.
+void st7789_PowerFrame(st7789_Device *device);
+// Called by drawing functions, wake from sleep takes ST7789_POWER_WAKE_NS
+void st7789_PowerActivity(st7789_Device *device);
+void st7789_PowerSetMode(st7789_Device *device, st7789_PowerMode mode);
+st7789_PowerMode st7789_PowerGetMode(const st7789_Device *device);
+// Estimated panel power of mode in uW
+uint32_t st7789_PowerEstimate(const st7789_Device *device, st7789_PowerMode mode);
+// Residency and energy up to now
+const st7789_PowerStats *st7789_PowerGetStats(st7789_Device *device);
+
+#endif
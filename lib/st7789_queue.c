@@ -0,0 +1,274 @@
+#include <stddef.h>
+#include <string.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_queue.h"
+#include "st7789_power.h"
+#include "st7789_stats.h"
+
+
+static void st7789_QueueStartDMA(st7789_Device *device, const void *data, uint16_t length, uint32_t flags) {
+	device->dma->CCR = 0;
+	device->dma->CMAR = (uint32_t)(uintptr_t)data;
+	device->dma->CPAR = (uint32_t)(uintptr_t)&device->spi->DR;
+	device->dma->CNDTR = length;
+	device->spi->CR2 |= SPI_CR2_TXDMAEN;
+	device->dma->CCR = flags | DMA_CCR1_DIR | DMA_CCR1_TCIE | DMA_CCR1_EN;
+	ST7789_STATS_DMA_START(device, (flags & DMA_CCR1_MSIZE_0) ? (uint32_t)length * 2 : length);
+}
+
+
+static void st7789_QueueSetWordMode(st7789_Device *device, bool enable) {
+	st7789_Queue *queue = device->queue;
+	if (queue->wordMode != enable) {
+		st7789_Set16BitMode(device, enable);
+		queue->wordMode = enable;
+	}
+}
+
+
+static void st7789_QueueSendCommand(st7789_Device *device, const st7789_QueueItem *item) {
+	st7789_Queue *queue = device->queue;
+	st7789_QueueSetWordMode(device, item->type == ST7789_QUEUE_FILL);
+	switch (item->type) {
+		case ST7789_QUEUE_COMMAND:
+			st7789_WaitForSpi(device);
+			st7789_WriteCommand(device, item->command, item->params, item->paramsLength);
+			break;
+		case ST7789_QUEUE_PATTERN:
+			for (size_t i = 0; i < ST7789_QUEUE_PATTERN_SIZE; ++i) {
+				queue->pattern[i] = item->params[i % 3];
+			}
+			break;
+		case ST7789_QUEUE_WINDOW:
+			st7789_WaitForSpi(device);
+			st7789_WriteCommand(device, ST7789_CMD_CASET, item->params, 4);
+			st7789_WriteCommand(device, ST7789_CMD_RASET, item->params + 4, 4);
+			st7789_WriteCommand(device, ST7789_CMD_RAMWR, NULL, 0);
+			break;
+		default:
+			break;
+	}
+}
+
+
+// Called with DMA interrupt masked, returns after starting DMA or when empty
+static void st7789_QueueProcess(st7789_Device *device) {
+	st7789_Queue *queue = device->queue;
+	queue->running = true;
+	while (queue->head != queue->tail) {
+		st7789_QueueItem *item = &queue->items[queue->head];
+		if (!queue->started) {
+			queue->started = true;
+			st7789_QueueSendCommand(device, item);
+		}
+		if (queue->offset < item->length) {
+			uint32_t chunk = item->length - queue->offset;
+			if (chunk > ST7789_QUEUE_MAX_TRANSFER) {
+				chunk = ST7789_QUEUE_MAX_TRANSFER;
+			}
+			if (item->type == ST7789_QUEUE_FILL) {
+				st7789_QueueStartDMA(device, &item->fill, (uint16_t)chunk, DMA_CCR1_MSIZE_0 | DMA_CCR1_PSIZE_0);
+			}
+			else if (item->type == ST7789_QUEUE_PATTERN && item->paramsLength == 1) {
+				st7789_QueueStartDMA(device, item->params, (uint16_t)chunk, 0);
+			}
+			else if (item->type == ST7789_QUEUE_PATTERN) {
+				if (chunk > ST7789_QUEUE_PATTERN_SIZE) {
+					chunk = ST7789_QUEUE_PATTERN_SIZE;
+				}
+				st7789_QueueStartDMA(device, queue->pattern, (uint16_t)chunk, DMA_CCR1_MINC);
+			}
+			else {
+				st7789_QueueStartDMA(device, item->data + queue->offset, (uint16_t)chunk, DMA_CCR1_MINC);
+			}
+			queue->offset += chunk;
+			return;
+		}
+		st7789_QueueCallback callback = item->callback;
+		void *context = item->context;
+		queue->started = false;
+		queue->offset = 0;
+		queue->head = (queue->head + 1) & (ST7789_QUEUE_SIZE - 1);
+		if (callback != NULL) {
+			callback(context);
+		}
+	}
+	ST7789_STATS_DMA_DONE(device);
+	st7789_QueueSetWordMode(device, false);
+	queue->running = false;
+}
+
+
+static st7789_QueueItem *st7789_QueueReserve(st7789_Device *device, uint8_t type) {
+	st7789_Queue *queue = device->queue;
+	// One slot is always empty to distinguish full and empty queue
+	st7789_QueueWait(device, ST7789_QUEUE_SIZE - 2);
+	st7789_QueueItem *item = &queue->items[queue->tail];
+	item->type = type;
+	item->command = ST7789_CMD_NOP;
+	item->paramsLength = 0;
+	item->data = NULL;
+	item->length = 0;
+	item->callback = NULL;
+	item->context = NULL;
+	return item;
+}
+
+
+static void st7789_QueueCommit(st7789_Device *device) {
+	st7789_Queue *queue = device->queue;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	queue->tail = (queue->tail + 1) & (ST7789_QUEUE_SIZE - 1);
+	if (!queue->running) {
+		// Transfer started without queue leaves TC flag, it would raise
+		// interrupt as soon as queue enables TCIE
+		device->dmaController->IFCR = device->dmaFlagClear;
+		st7789_QueueProcess(device);
+	}
+	__set_PRIMASK(primask);
+}
+
+
+void st7789_QueueInit(st7789_Device *device, st7789_Queue *queue) {
+	device->queue = queue;
+	queue->head = 0;
+	queue->tail = 0;
+	queue->running = false;
+	queue->started = false;
+	queue->wordMode = false;
+	queue->offset = 0;
+	device->dmaController->IFCR = device->dmaFlagClear;
+	NVIC_EnableIRQ(device->dmaIRQn);
+}
+
+
+void st7789_QueueCommand(st7789_Device *device, uint8_t command, const void *data, size_t length) {
+	st7789_QueueItem *item = st7789_QueueReserve(device, ST7789_QUEUE_COMMAND);
+	item->command = command;
+	if (length <= ST7789_QUEUE_INLINE_PARAMS) {
+		if (length > 0) {
+			memcpy(item->params, data, length);
+		}
+		item->paramsLength = (uint8_t)length;
+	}
+	else {
+		item->data = (const uint8_t *)data;
+		item->length = length;
+	}
+	st7789_QueueCommit(device);
+}
+
+
+// Rows and offsets are translated as in st7789_SetWindow
+void st7789_QueueWindow(st7789_Device *device, uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd) {
+	if (device->power != NULL) {
+		st7789_PowerActivity(device);
+	}
+	uint16_t row = st7789_TranslateRow(device, yStart) + device->yOffset;
+	yEnd = row + (yEnd - yStart);
+	yStart = row;
+	xStart += device->xOffset;
+	xEnd += device->xOffset;
+	st7789_QueueItem *item = st7789_QueueReserve(device, ST7789_QUEUE_WINDOW);
+	item->params[0] = (uint8_t)(xStart >> 8);
+	item->params[1] = (uint8_t)(xStart & 0xff);
+	item->params[2] = (uint8_t)(xEnd >> 8);
+	item->params[3] = (uint8_t)(xEnd & 0xff);
+	item->params[4] = (uint8_t)(yStart >> 8);
+	item->params[5] = (uint8_t)(yStart & 0xff);
+	item->params[6] = (uint8_t)(yEnd >> 8);
+	item->params[7] = (uint8_t)(yEnd & 0xff);
+	st7789_QueueCommit(device);
+	st7789_InvalidateWindow(device);
+}
+
+
+// Buffer must stay untouched until callback (or fence behind it) is called
+void st7789_QueuePixels(st7789_Device *device, const void *data, uint32_t length, st7789_QueueCallback callback, void *context) {
+	st7789_QueueItem *item = st7789_QueueReserve(device, ST7789_QUEUE_PIXELS);
+	item->data = (const uint8_t *)data;
+	item->length = length;
+	item->callback = callback;
+	item->context = context;
+	st7789_QueueCommit(device);
+}
+
+
+// Uses pixel format set by st7789_SetPixelFormat
+void st7789_QueueFill(st7789_Device *device, uint16_t color, uint32_t count, st7789_QueueCallback callback, void *context) {
+	st7789_QueueItem *item;
+	if (st7789_GetPixelFormat(device) == ST7789_PIXEL_FORMAT_RGB444) {
+		uint16_t packed = st7789_ColorToRGB444(color);
+		item = st7789_QueueReserve(device, ST7789_QUEUE_PATTERN);
+		item->params[0] = (uint8_t)(packed >> 4);
+		item->params[1] = (uint8_t)((packed << 4) | (packed >> 8));
+		item->params[2] = (uint8_t)packed;
+		// Same bytes are sent without memory increment
+		item->paramsLength = (item->params[0] == item->params[1] && item->params[1] == item->params[2]) ? 1 : 3;
+		item->length = st7789_PixelBytes(device, count);
+	}
+	else {
+		item = st7789_QueueReserve(device, ST7789_QUEUE_FILL);
+		// Byte order as in st7789_FillDMA
+		item->fill = (uint16_t)((color << 8) | (color >> 8));
+		item->length = count;
+	}
+	item->callback = callback;
+	item->context = context;
+	st7789_QueueCommit(device);
+}
+
+
+void st7789_QueueFence(st7789_Device *device, st7789_QueueCallback callback, void *context) {
+	st7789_QueueItem *item = st7789_QueueReserve(device, ST7789_QUEUE_FENCE);
+	item->callback = callback;
+	item->context = context;
+	st7789_QueueCommit(device);
+}
+
+
+uint8_t st7789_QueuePending(st7789_Device *device) {
+	const st7789_Queue *queue = device->queue;
+	return (queue->tail - queue->head) & (ST7789_QUEUE_SIZE - 1);
+}
+
+
+// Sleep until at most `pending` descriptors are queued or in flight, must not
+// be called from the queue callbacks. Caller's interrupt mask is kept, masked
+// DMA interrupt is polled instead.
+void st7789_QueueWait(st7789_Device *device, uint8_t pending) {
+	ST7789_STATS_TICKS(start);
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	while (st7789_QueuePending(device) > pending) {
+		if (primask) {
+			st7789_DMAInterruptHandler(device);
+		}
+		else {
+			__WFI();
+			__enable_irq();
+			__disable_irq();
+		}
+	}
+	__set_PRIMASK(primask);
+	ST7789_STATS_ADD(device, ST7789_STATS_WAIT, start);
+}
+
+
+void st7789_QueueFlush(st7789_Device *device) {
+	st7789_QueueWait(device, 0);
+	st7789_WaitForSpi(device);
+}
+
+
+void st7789_DMAInterruptHandler(st7789_Device *device) {
+	if (!(device->dmaController->ISR & device->dmaFlagTC)) {
+		return;
+	}
+	device->dmaController->IFCR = device->dmaFlagClear;
+	device->dma->CCR = 0;
+	st7789_QueueProcess(device);
+}
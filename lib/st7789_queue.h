@@ -0,0 +1,71 @@
+#ifndef ST7789_QUEUE_H
+#define ST7789_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "st7789.h"
+
+
+// Queue length, must be power of 2
+#define ST7789_QUEUE_SIZE            16
+// Repeated RGB444 pattern sent by one DMA transfer, multiple of 3 (same
+// length as st7789_FillDMA uses, one interrupt per 240 pixels)
+#define ST7789_QUEUE_PATTERN_SIZE    ST7789_PACK_BUFFER_SIZE
+// Command parameters up to this size are copied into the descriptor
+#define ST7789_QUEUE_INLINE_PARAMS   8
+// Largest DMA transfer, CNDTR is 16 bit (kept even to split on pixel boundary)
+#define ST7789_QUEUE_MAX_TRANSFER    0xfffe
+
+
+typedef void (*st7789_QueueCallback)(void *context);
+
+typedef enum st7789_QueueType {
+	ST7789_QUEUE_COMMAND, // Command with optional parameters
+	ST7789_QUEUE_WINDOW,  // CASET, RASET and RAMWR
+	ST7789_QUEUE_PIXELS,  // Payload of memory write
+	ST7789_QUEUE_FILL,    // Memory write of single color (length in pixels)
+	ST7789_QUEUE_PATTERN, // Memory write of 3 byte RGB444 pattern (length in bytes)
+	ST7789_QUEUE_FENCE,   // Callback after all previous descriptors
+} st7789_QueueType;
+
+typedef struct st7789_QueueItem {
+	uint16_t fill;
+	uint8_t type;
+	uint8_t command;
+	uint8_t paramsLength;
+	uint8_t params[ST7789_QUEUE_INLINE_PARAMS];
+	const uint8_t *data;
+	uint32_t length;
+	st7789_QueueCallback callback;
+	void *context;
+} st7789_QueueItem;
+
+// Descriptor ring of one device
+typedef struct st7789_Queue {
+	st7789_QueueItem items[ST7789_QUEUE_SIZE];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	volatile bool running; // Engine active, continues from DMA interrupt
+	bool started;          // Command phase of head item is sent
+	bool wordMode;         // SPI in 16 bit mode for fill
+	uint32_t offset;       // Payload bytes of head item handed to DMA
+	uint8_t pattern[ST7789_QUEUE_PATTERN_SIZE];
+} st7789_Queue;
+
+// Synchronous st7789_* calls must not be mixed with queued transfers before
+// st7789_QueueFlush. st7789_DMAInterruptHandler has to be called with the
+// device from its dmaIRQn vector.
+void st7789_QueueInit(st7789_Device *device, st7789_Queue *queue);
+void st7789_QueueCommand(st7789_Device *device, uint8_t command, const void *data, size_t length);
+void st7789_QueueWindow(st7789_Device *device, uint16_t xStart, uint16_t yStart, uint16_t xEnd, uint16_t yEnd);
+void st7789_QueuePixels(st7789_Device *device, const void *data, uint32_t length, st7789_QueueCallback callback, void *context);
+void st7789_QueueFill(st7789_Device *device, uint16_t color, uint32_t count, st7789_QueueCallback callback, void *context);
+void st7789_QueueFence(st7789_Device *device, st7789_QueueCallback callback, void *context);
+uint8_t st7789_QueuePending(st7789_Device *device);
+void st7789_QueueWait(st7789_Device *device, uint8_t pending);
+void st7789_QueueFlush(st7789_Device *device);
+void st7789_DMAInterruptHandler(st7789_Device *device);
+
+#endif
@@ -0,0 +1,113 @@
+#include <stddef.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_power.h"
+#include "st7789_queue.h"
+#include "st7789_readback.h"
+
+
+static void st7789_ReadAddress(st7789_Device *device, uint8_t command, uint16_t start, uint16_t end) {
+	uint8_t range[4] = {
+		(uint8_t)(start >> 8),
+		(uint8_t)(start & 0xff),
+		(uint8_t)(end >> 8),
+		(uint8_t)(end & 0xff),
+	};
+	st7789_WriteCommand(device, command, range, sizeof(range));
+}
+
+
+// Receive only mode clocks as long as SPI is enabled. Reference manual
+// sequence: after RXNE of second to last byte wait one SPI clock and
+// disable SPI, last byte is still received. length is at least 2.
+static void st7789_ReceiveDMA(st7789_Device *device, uint8_t *data, uint16_t length) {
+	SPI_TypeDef *spi = device->spi;
+	uint32_t cr1 = spi->CR1;
+	spi->CR1 = cr1 & ~(SPI_CR1_SPE);
+	spi->CR1 = (cr1 & ~(SPI_CR1_SPE | SPI_CR1_BIDIOE | SPI_CR1_BR)) | ST7789_READ_BAUD;
+	device->rxDma->CCR = DMA_CCR1_MINC;
+	device->rxDma->CMAR = (uint32_t)(uintptr_t)data;
+	device->rxDma->CPAR = (uint32_t)(uintptr_t)&spi->DR;
+	device->rxDma->CNDTR = length;
+	device->rxDma->CCR |= DMA_CCR1_EN;
+	spi->CR2 |= SPI_CR2_RXDMAEN;
+	spi->CR1 |= SPI_CR1_SPE;
+	while (device->rxDma->CNDTR > 1);
+	// One read clock in st7789_Ticks, PCLK of SPI2 is slower than HCLK
+	uint32_t clockTicks = (uint32_t)ST7789_READ_BAUD_DIVIDER * device->busPrescaler;
+	uint32_t start = st7789_Ticks();
+	while (st7789_Ticks() - start < clockTicks);
+	spi->CR1 &= ~(SPI_CR1_SPE);
+	while (device->rxDma->CNDTR);
+	device->rxDma->CCR = 0;
+	spi->CR2 &= ~(SPI_CR2_RXDMAEN);
+	spi->CR1 = cr1;
+}
+
+
+// Pixel i is taken from bytes 1 + 3i .. 3 + 3i before bytes 2i, 2i + 1 are
+// overwritten
+static void st7789_ConvertRGB666(uint16_t *buffer, uint32_t count) {
+	const uint8_t *bytes = (const uint8_t *)buffer + 1;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint8_t r = bytes[0];
+		uint8_t g = bytes[1];
+		uint8_t b = bytes[2];
+		buffer[i] = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+		bytes += 3;
+	}
+}
+
+
+// Every read command starts with dummy byte, rows are read in groups which
+// fit to 16 bit CNDTR. Group lands at its place in result and is converted
+// there, raw bytes of group never reach converted pixels before it.
+void st7789_ReadWindow(st7789_Device *device, const st7789_Rect *window, uint16_t *buffer) {
+	uint16_t groupRows = (uint16_t)((0xffff - 1) / ((uint32_t)window->width * 3));
+	// Sleeping panel does not answer RAMRD
+	if (device->power != NULL) {
+		st7789_PowerActivity(device);
+	}
+	if (device->queue != NULL) {
+		st7789_QueueFlush(device);
+	}
+	st7789_WaitForDMA(device);
+	st7789_InvalidateWindow(device);
+	uint16_t column = window->x + device->xOffset;
+	st7789_ReadAddress(device, ST7789_CMD_CASET, column, column + window->width - 1);
+	for (uint16_t y = window->y; y < window->y + window->height; y += groupRows) {
+		uint16_t remaining = window->y + window->height - y;
+		uint16_t rows = (remaining < groupRows) ? remaining : groupRows;
+		uint16_t row = st7789_TranslateRow(device, y) + device->yOffset;
+		uint32_t count = (uint32_t)window->width * rows;
+		st7789_ReadAddress(device, ST7789_CMD_RASET, row, row + rows - 1);
+		st7789_StartCommand(device);
+		st7789_WriteSpi(device, ST7789_CMD_RAMRD);
+		st7789_StartData(device);
+		st7789_ReceiveDMA(device, (uint8_t *)buffer, (uint16_t)(1 + count * 3));
+		st7789_ConvertRGB666(buffer, count);
+		buffer += count;
+	}
+}
+
+
+uint16_t st7789_ReadPixel(st7789_Device *device, uint16_t x, uint16_t y) {
+	uint16_t buffer[ST7789_READ_BUFFER_WORDS(1)];
+	st7789_Rect window = {x, y, 1, 1};
+	st7789_ReadWindow(device, &window, buffer);
+	return buffer[0];
+}
+
+
+void st7789_ModifyWindow(st7789_Device *device, const st7789_Rect *window, uint16_t bandHeight, uint16_t *buffer, st7789_ModifyCallback modify, void *context) {
+	for (uint16_t y = window->y; y < window->y + window->height; y += bandHeight) {
+		uint16_t rows = window->y + window->height - y;
+		st7789_Rect band = {window->x, y, window->width, (rows < bandHeight) ? rows : bandHeight};
+		st7789_ReadWindow(device, &band, buffer);
+		modify(context, buffer, &band);
+		st7789_SetWindow(device, band.x, band.y, band.x + band.width - 1, band.y + band.height - 1);
+		st7789_WritePixels(device, buffer, (uint32_t)band.width * band.height);
+	}
+	st7789_WaitForDMA(device);
+}
@@ -0,0 +1,36 @@
+#ifndef ST7789_READBACK_H
+#define ST7789_READBACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Frame memory readback over bidirectional SDA line. RAMRD answers in serial
+// interface with dummy byte and 3 bytes per pixel (RGB666 in bits 7..2)
+// regardless of COLMOD, pixels are converted to RGB565 in place.
+
+// SPI clock of reads, fPCLK / 16. Read cycle of panel is at least 150 ns.
+#define ST7789_READ_BAUD             (SPI_CR1_BR_1 | SPI_CR1_BR_0)
+#define ST7789_READ_BAUD_DIVIDER     16 // fPCLK / read clock of ST7789_READ_BAUD
+// uint16_t words of st7789_ReadWindow buffer for count pixels
+#define ST7789_READ_BUFFER_WORDS(count) (((uint32_t)(count) * 3 + 2) / 2)
+
+
+// Changes band in place, pixels hold band->width * band->height RGB565
+// values read from panel
+typedef void (*st7789_ModifyCallback)(void *context, uint16_t *pixels, const st7789_Rect *band);
+
+// Waits for DMA and queue, reads window->width * window->height pixels to
+// start of buffer of ST7789_READ_BUFFER_WORDS. Rows are translated like in
+// st7789_SetWindow (window must not cross wrap of scroll area). Needs rxDma
+// of st7789_Config, window cache is invalidated.
+void st7789_ReadWindow(st7789_Device *device, const st7789_Rect *window, uint16_t *buffer);
+uint16_t st7789_ReadPixel(st7789_Device *device, uint16_t x, uint16_t y);
+// Read, modify, write back band by band (translucent overlays without frame
+// buffer), buffer holds ST7789_READ_BUFFER_WORDS of window->width *
+// bandHeight
+void st7789_ModifyWindow(st7789_Device *device, const st7789_Rect *window, uint16_t bandHeight, uint16_t *buffer, st7789_ModifyCallback modify, void *context);
+
+#endif
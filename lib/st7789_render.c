@@ -0,0 +1,72 @@
+#include <stddef.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_queue.h"
+#include "st7789_render.h"
+#include "st7789_stats.h"
+
+
+// Queue callback of band, runs in DMA interrupt, context is completion time
+static void st7789_RenderBandDone(void *context) {
+	*(volatile uint32_t *)context = st7789_Ticks();
+}
+
+
+// Renders band n into buffer n % depth while up to depth - 1 previous bands
+// wait in queue or are being sent. RGB444 bands are packed in place.
+void st7789_RenderWindow(st7789_Device *device, const st7789_Rect *window, uint16_t bandHeight, uint16_t *buffers, uint8_t depth, st7789_RenderCallback render, void *context, st7789_RenderStats *stats) {
+	st7789_RenderStats local;
+	volatile uint32_t doneTicks = 0;
+	uint32_t start = st7789_Ticks();
+	uint16_t bottom = window->y + window->height;
+	uint32_t band = 0;
+	if (stats == NULL) {
+		stats = &local;
+	}
+	// RGB444 pixel pairs can't cross bands, odd width needs even band height
+	if ((window->width & 1) && st7789_GetPixelFormat(device) == ST7789_PIXEL_FORMAT_RGB444) {
+		bandHeight &= ~1;
+	}
+	uint32_t bandPixels = (uint32_t)window->width * bandHeight;
+	stats->bands = 0;
+	stats->dmaStallTicks = 0;
+	stats->computeStallTicks = 0;
+	if (window->width == 0 || window->height == 0 || bandHeight == 0) {
+		stats->ticks = 0;
+		return;
+	}
+	if (depth == 0) {
+		depth = 1;
+	}
+	if (depth > ST7789_RENDER_MAX_DEPTH) {
+		depth = ST7789_RENDER_MAX_DEPTH;
+	}
+
+	st7789_QueueWindow(device, window->x, window->y, window->x + window->width - 1, bottom - 1);
+	for (uint16_t top = window->y; top < bottom; top += bandHeight, ++band) {
+		st7789_Rect rows = {window->x, top, window->width, (uint16_t)((bottom - top < bandHeight) ? bottom - top : bandHeight)};
+		uint16_t *pixels = buffers + (band % depth) * bandPixels;
+		uint32_t count = (uint32_t)rows.width * rows.height;
+		// Buffer is free when band - depth is sent
+		if (band >= depth) {
+			uint32_t waitStart = st7789_Ticks();
+			st7789_QueueWait(device, depth - 1);
+			stats->dmaStallTicks += st7789_Ticks() - waitStart;
+		}
+		ST7789_STATS_TICKS(renderStart);
+		render(context, pixels, &rows);
+		ST7789_STATS_ADD(device, ST7789_STATS_RENDER, renderStart);
+		if (st7789_GetPixelFormat(device) == ST7789_PIXEL_FORMAT_RGB444) {
+			st7789_PackRGB444((uint8_t *)pixels, pixels, count);
+		}
+		// Nothing left to send, SPI is idle since last band was done
+		if (band > 0 && st7789_QueuePending(device) == 0) {
+			stats->computeStallTicks += st7789_Ticks() - doneTicks;
+		}
+		st7789_QueuePixels(device, pixels, st7789_PixelBytes(device, count), st7789_RenderBandDone, (void *)&doneTicks);
+	}
+	st7789_QueueFlush(device);
+	stats->bands = band;
+	stats->ticks = st7789_Ticks() - start;
+}
@@ -0,0 +1,32 @@
+#ifndef ST7789_RENDER_H
+#define ST7789_RENDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+#include "st7789_queue.h"
+
+
+// Deepest pipeline, every band takes one queue descriptor
+#define ST7789_RENDER_MAX_DEPTH      (ST7789_QUEUE_SIZE - 2)
+
+
+// Fills band->width * band->height RGB565 pixels of rows band->y ..
+// band->y + band->height - 1
+typedef void (*st7789_RenderCallback)(void *context, uint16_t *pixels, const st7789_Rect *band);
+
+// Times in st7789_Ticks units (CPU cycles)
+typedef struct st7789_RenderStats {
+	uint32_t bands;
+	uint32_t ticks;             // Whole window including drain
+	uint32_t dmaStallTicks;     // Renderer waited for free buffer
+	uint32_t computeStallTicks; // SPI idle, next band was not rendered yet
+} st7789_RenderStats;
+
+// Needs st7789_QueueInit, buffers hold depth bands of window->width *
+// bandHeight pixels. Stats may be NULL. In RGB444 mode with odd window
+// width band height is rounded down to even, nothing is drawn if it is 1.
+void st7789_RenderWindow(st7789_Device *device, const st7789_Rect *window, uint16_t bandHeight, uint16_t *buffers, uint8_t depth, st7789_RenderCallback render, void *context, st7789_RenderStats *stats);
+
+#endif
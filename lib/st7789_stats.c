@@ -0,0 +1,143 @@
+#include <stddef.h>
+#include <string.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_stats.h"
+
+#ifdef ST7789_STATS
+
+// Queued transfers update counters from DMA interrupt, read-modify-write
+// and reset run with interrupts masked
+
+void st7789_StatsInit(st7789_Device *device, st7789_Stats *stats) {
+	device->stats = stats;
+	stats->dmaActive = false;
+	st7789_StatsReset(device);
+}
+
+
+void st7789_StatsReset(st7789_Device *device) {
+	st7789_Stats *stats = device->stats;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	bool dmaActive = stats->dmaActive;
+	uint32_t dmaStart = stats->dmaStart;
+	memset(stats, 0, sizeof(*stats));
+	for (size_t i = 0; i < ST7789_STATS_STAGES; ++i) {
+		stats->stages[i].minTicks = UINT32_MAX;
+	}
+	stats->frameMin = UINT32_MAX;
+	stats->dmaActive = dmaActive;
+	stats->dmaStart = dmaStart;
+	stats->frameStart = st7789_Ticks();
+	__set_PRIMASK(primask);
+}
+
+
+void st7789_StatsFrameBegin(st7789_Device *device) {
+	st7789_Stats *stats = device->stats;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for (size_t i = 0; i < ST7789_STATS_STAGES; ++i) {
+		stats->stages[i].ticks = 0;
+		stats->stages[i].events = 0;
+	}
+	stats->dmaBytes = 0;
+	stats->frameStart = st7789_Ticks();
+	__set_PRIMASK(primask);
+}
+
+
+// Folds current frame into min / max / histogram, counters of current frame
+// stay readable until next st7789_StatsFrameBegin
+void st7789_StatsFrameEnd(st7789_Device *device) {
+	st7789_Stats *stats = device->stats;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint32_t ticks = st7789_Ticks() - stats->frameStart;
+	for (size_t i = 0; i < ST7789_STATS_STAGES; ++i) {
+		st7789_StatsCounter *counter = &stats->stages[i];
+		counter->lastTicks = counter->ticks;
+		counter->totalTicks += counter->ticks;
+		if (counter->ticks < counter->minTicks) {
+			counter->minTicks = counter->ticks;
+		}
+		if (counter->ticks > counter->maxTicks) {
+			counter->maxTicks = counter->ticks;
+		}
+	}
+	uint32_t bin = ticks / ST7789_STATS_HISTOGRAM_TICKS;
+	if (bin >= ST7789_STATS_HISTOGRAM_BINS) {
+		bin = ST7789_STATS_HISTOGRAM_BINS - 1;
+	}
+	stats->histogram[bin]++;
+	stats->frameTicks = ticks;
+	if (ticks < stats->frameMin) {
+		stats->frameMin = ticks;
+	}
+	if (ticks > stats->frameMax) {
+		stats->frameMax = ticks;
+	}
+	stats->frames++;
+	__set_PRIMASK(primask);
+}
+
+
+const st7789_Stats *st7789_StatsGet(const st7789_Device *device) {
+	return device->stats;
+}
+
+
+const char *st7789_StatsStageName(st7789_StatsStage stage) {
+	static const char *names[ST7789_STATS_STAGES] = {"command", "window", "dma", "wait", "render"};
+	return (stage < ST7789_STATS_STAGES) ? names[stage] : "";
+}
+
+
+void st7789_StatsAdd(st7789_Device *device, st7789_StatsStage stage, uint32_t ticks) {
+	if (device->stats == NULL) {
+		return;
+	}
+	st7789_StatsCounter *counter = &device->stats->stages[stage];
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	counter->ticks += ticks;
+	counter->events++;
+	__set_PRIMASK(primask);
+}
+
+
+void st7789_StatsDMAStart(st7789_Device *device, uint32_t bytes) {
+	st7789_Stats *stats = device->stats;
+	if (stats == NULL) {
+		return;
+	}
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stats->dmaBytes += bytes;
+	if (!stats->dmaActive) {
+		stats->dmaActive = true;
+		stats->dmaStart = st7789_Ticks();
+	}
+	__set_PRIMASK(primask);
+}
+
+
+// Transfers started back to back (queue, chunks) are one interval
+void st7789_StatsDMADone(st7789_Device *device) {
+	st7789_Stats *stats = device->stats;
+	if (stats == NULL) {
+		return;
+	}
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (stats->dmaActive) {
+		stats->dmaActive = false;
+		st7789_StatsAdd(device, ST7789_STATS_DMA, st7789_Ticks() - stats->dmaStart);
+	}
+	__set_PRIMASK(primask);
+}
+
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef ST7789_STATS_H
+#define ST7789_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Driver instrumentation is compiled only with ST7789_STATS defined, record
+// macros below are empty otherwise and the API is not declared
+
+#define ST7789_STATS_HISTOGRAM_BINS  16
+#define ST7789_STATS_HISTOGRAM_TICKS (2 * ST7789_TICKS_PER_MS) // Frame time per bin, last bin holds longer frames
+
+
+typedef enum st7789_StatsStage {
+	ST7789_STATS_COMMAND, // Command and parameter bytes
+	ST7789_STATS_WINDOW,  // st7789_SetWindow including its commands
+	ST7789_STATS_DMA,     // DMA start until completion is seen (TC interrupt or wait)
+	ST7789_STATS_WAIT,    // CPU waiting for DMA or queue
+	ST7789_STATS_RENDER,  // Pixel generation (render callbacks, display list bands, image decoding)
+	ST7789_STATS_STAGES,
+} st7789_StatsStage;
+
+// Times in st7789_Ticks units
+typedef struct st7789_StatsCounter {
+	uint32_t ticks;       // Current frame
+	uint32_t events;      // Current frame
+	uint32_t lastTicks;   // Last finished frame
+	uint32_t minTicks;    // Per frame over finished frames
+	uint32_t maxTicks;
+	uint64_t totalTicks;
+} st7789_StatsCounter;
+
+typedef struct st7789_Stats {
+	st7789_StatsCounter stages[ST7789_STATS_STAGES];
+	uint32_t frames;
+	uint32_t frameStart;
+	uint32_t frameTicks;  // Last finished frame
+	uint32_t frameMin;
+	uint32_t frameMax;
+	uint32_t histogram[ST7789_STATS_HISTOGRAM_BINS];
+	uint32_t dmaBytes;    // Current frame
+	uint32_t dmaStart;
+	bool dmaActive;
+} st7789_Stats;
+
+#ifdef ST7789_STATS
+
+#define ST7789_STATS_TICKS(name) uint32_t name = st7789_Ticks()
+#define ST7789_STATS_ADD(device, stage, start) st7789_StatsAdd((device), (stage), st7789_Ticks() - (start))
+#define ST7789_STATS_DMA_START(device, bytes) st7789_StatsDMAStart((device), (bytes))
+#define ST7789_STATS_DMA_DONE(device) st7789_StatsDMADone(device)
+
+// Frames are delimited by application, stages recorded outside of frame
+// go to next one
+void st7789_StatsInit(st7789_Device *device, st7789_Stats *stats);
+void st7789_StatsReset(st7789_Device *device);
+void st7789_StatsFrameBegin(st7789_Device *device);
+void st7789_StatsFrameEnd(st7789_Device *device);
+const st7789_Stats *st7789_StatsGet(const st7789_Device *device);
+const char *st7789_StatsStageName(st7789_StatsStage stage);
+void st7789_StatsAdd(st7789_Device *device, st7789_StatsStage stage, uint32_t ticks);
+void st7789_StatsDMAStart(st7789_Device *device, uint32_t bytes);
+void st7789_StatsDMADone(st7789_Device *device);
+
+#else
+
+#define ST7789_STATS_TICKS(name)
+#define ST7789_STATS_ADD(device, stage, start)
+#define ST7789_STATS_DMA_START(device, bytes)
+#define ST7789_STATS_DMA_DONE(device)
+
+#endif
+
+#endif
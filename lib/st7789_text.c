@@ -0,0 +1,194 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "st7789.h"
+#include "st7789_text.h"
+
+
+#define ST7789_TEXT_EMPTY -1
+
+
+static void st7789_TextInvalidate(st7789_Text *text) {
+	for (uint16_t slot = 0; slot < ST7789_TEXT_CACHE_SLOTS; ++slot) {
+		text->cacheChar[slot] = ST7789_TEXT_EMPTY;
+		text->cacheStamp[slot] = 0;
+	}
+	text->stamp = 0;
+	text->lineStamp = 0;
+}
+
+
+// Glyph row of font, NULL for characters outside of font (drawn as space)
+static const uint8_t *st7789_TextBits(const st7789_Font *font, uint8_t character) {
+	if (character < font->firstChar || character > font->lastChar) {
+		return NULL;
+	}
+	uint16_t rowBytes = (font->width + 7) / 8;
+	return font->data + (character - font->firstChar) * rowBytes * font->height;
+}
+
+
+// One glyph row into 8 pixels per font byte, two words per nibble
+static void st7789_TextExpandRow(const st7789_Text *text, uint32_t *out, const uint8_t *bits, uint16_t rowBytes) {
+	for (uint16_t i = 0; i < rowBytes; ++i) {
+		uint8_t byte = (bits == NULL) ? 0 : bits[i];
+		const uint32_t *low = text->lut[byte & 0x0f];
+		const uint32_t *high = text->lut[byte >> 4];
+		out[0] = low[0];
+		out[1] = low[1];
+		out[2] = high[0];
+		out[3] = high[1];
+		out += 4;
+	}
+}
+
+
+static void st7789_TextCopy(uint16_t *out, const uint32_t *in, uint16_t width) {
+	if (((uintptr_t)out & 3) == 0) {
+		uint32_t *words = (uint32_t *)out;
+		for (uint16_t i = 0; i < width / 2; ++i) {
+			words[i] = in[i];
+		}
+		if (width & 1) {
+			out[width - 1] = ((const uint16_t *)in)[width - 1];
+		}
+		return;
+	}
+	const uint16_t *pixels = (const uint16_t *)in;
+	for (uint16_t i = 0; i < width; ++i) {
+		out[i] = pixels[i];
+	}
+}
+
+
+// Expanded glyph from cache, least recently used slot is replaced on miss.
+// Returns NULL if glyph is too large for cache or cache is full of glyphs
+// used by current line.
+static const uint32_t *st7789_TextGlyph(st7789_Text *text, uint8_t character) {
+	const st7789_Font *font = text->font;
+	uint16_t rowBytes = (font->width + 7) / 8;
+	if (rowBytes * 8 * font->height > ST7789_TEXT_GLYPH_PIXELS) {
+		return NULL;
+	}
+	uint16_t victim = 0;
+	for (uint16_t slot = 0; slot < ST7789_TEXT_CACHE_SLOTS; ++slot) {
+		if (text->cacheChar[slot] == character) {
+			text->cacheStamp[slot] = ++text->stamp;
+			text->stats.hits++;
+			return text->cache[slot];
+		}
+		if ((uint16_t)(text->stamp - text->cacheStamp[slot]) > (uint16_t)(text->stamp - text->cacheStamp[victim])) {
+			victim = slot;
+		}
+	}
+	text->stats.misses++;
+	// Glyphs of current line are not evicted, line with more distinct
+	// characters than slots would replace every slot before its reuse
+	if ((uint16_t)(text->stamp - text->cacheStamp[victim]) < (uint16_t)(text->stamp - text->lineStamp)) {
+		return NULL;
+	}
+	const uint8_t *bits = st7789_TextBits(font, character);
+	uint32_t *out = text->cache[victim];
+	for (uint16_t row = 0; row < font->height; ++row) {
+		st7789_TextExpandRow(text, out + row * rowBytes * 4, bits ? bits + row * rowBytes : NULL, rowBytes);
+	}
+	text->cacheChar[victim] = character;
+	text->cacheStamp[victim] = ++text->stamp;
+	return out;
+}
+
+
+void st7789_TextInit(st7789_Text *text, const st7789_Font *font, uint16_t *band, uint16_t bandPixels) {
+	text->band = band;
+	text->bandPixels = bandPixels;
+	text->stats.hits = 0;
+	text->stats.misses = 0;
+	text->font = font;
+	st7789_TextSetColors(text, 0xffff, 0x0000);
+}
+
+
+void st7789_TextSetFont(st7789_Text *text, const st7789_Font *font) {
+	text->font = font;
+	st7789_TextInvalidate(text);
+}
+
+
+// Lookup table of pre-blended pixel pairs, invalidates glyph cache
+void st7789_TextSetColors(st7789_Text *text, uint16_t foreground, uint16_t background) {
+	text->foreground = foreground;
+	text->background = background;
+	for (uint16_t nibble = 0; nibble < 16; ++nibble) {
+		uint16_t pixels[4];
+		for (uint16_t bit = 0; bit < 4; ++bit) {
+			pixels[bit] = ((nibble >> bit) & 1) ? foreground : background;
+		}
+		text->lut[nibble][0] = pixels[0] | ((uint32_t)pixels[1] << 16);
+		text->lut[nibble][1] = pixels[2] | ((uint32_t)pixels[3] << 16);
+	}
+	st7789_TextInvalidate(text);
+}
+
+
+// Draws length characters in one window, clipped to whole glyphs on right
+// edge. Returns width of drawn text.
+uint16_t st7789_TextDrawLine(st7789_Device *device, st7789_Text *text, uint16_t x, uint16_t y, const char *string, uint16_t length) {
+	const st7789_Font *font = text->font;
+	uint16_t width = font->width;
+	uint16_t rowBytes = (width + 7) / 8;
+	if (x >= device->width || y >= device->height || width > ST7789_TEXT_MAX_WIDTH) {
+		return 0;
+	}
+	uint16_t maxLength = (device->width - x) / width;
+	if (length > maxLength) {
+		length = maxLength;
+	}
+	uint16_t lineWidth = length * width;
+	uint16_t height = (y + font->height > device->height) ? device->height - y : font->height;
+	uint16_t stripRows = (text->bandPixels / 2) / lineWidth;
+	if (length == 0 || stripRows == 0) {
+		return 0;
+	}
+	// Even strip rows keep RGB444 pixel pairs inside one transfer, line of
+	// odd width can't be split to single rows
+	if (stripRows > 1) {
+		stripRows &= ~1;
+	}
+	else if ((lineWidth & 1) && height > 1 && st7789_GetPixelFormat(device) == ST7789_PIXEL_FORMAT_RGB444) {
+		return 0;
+	}
+	uint16_t half = (text->bandPixels / 2) & ~1;
+	uint8_t bufferIndex = 0;
+	uint32_t scratch[ST7789_TEXT_MAX_WIDTH / 2];
+
+	text->lineStamp = text->stamp;
+	st7789_SetWindow(device, x, y, x + lineWidth - 1, y + height - 1);
+	for (uint16_t stripTop = 0; stripTop < height; stripTop += stripRows) {
+		uint16_t rows = (height - stripTop < stripRows) ? height - stripTop : stripRows;
+		uint16_t *strip = text->band + bufferIndex * half;
+		for (uint16_t i = 0; i < length; ++i) {
+			const uint32_t *glyph = st7789_TextGlyph(text, (uint8_t)string[i]);
+			const uint8_t *bits = (glyph == NULL) ? st7789_TextBits(font, (uint8_t)string[i]) : NULL;
+			uint16_t *out = strip + i * width;
+			for (uint16_t row = 0; row < rows; ++row, out += lineWidth) {
+				uint16_t glyphRow = stripTop + row;
+				if (glyph != NULL) {
+					st7789_TextCopy(out, glyph + glyphRow * rowBytes * 4, width);
+				}
+				else {
+					st7789_TextExpandRow(text, scratch, bits ? bits + glyphRow * rowBytes : NULL, rowBytes);
+					st7789_TextCopy(out, scratch, width);
+				}
+			}
+		}
+		st7789_WritePixels(device, strip, (uint32_t)lineWidth * rows);
+		bufferIndex ^= 1;
+	}
+	st7789_WaitForDMA(device);
+	return lineWidth;
+}
+
+
+uint16_t st7789_TextDraw(st7789_Device *device, st7789_Text *text, uint16_t x, uint16_t y, const char *string) {
+	return st7789_TextDrawLine(device, text, x, y, string, (uint16_t)strlen(string));
+}
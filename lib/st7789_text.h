@@ -0,0 +1,50 @@
+#ifndef ST7789_TEXT_H
+#define ST7789_TEXT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Expanded glyphs kept for current colour pair
+#define ST7789_TEXT_CACHE_SLOTS      8
+// Largest cached glyph, rows are padded to multiple of 8 pixels (8x16 font)
+#define ST7789_TEXT_GLYPH_PIXELS     128
+// Widest supported glyph
+#define ST7789_TEXT_MAX_WIDTH        32
+
+// st7789_Font from uGUI UG_FONT (FONT_TYPE_1BPP, fixed width)
+#define ST7789_UGUI_FONT(font) {(font).p, (uint8_t)(font).char_width, (uint8_t)(font).char_height, (uint8_t)(font).start_char, (uint8_t)(font).end_char}
+
+
+typedef struct st7789_TextStats {
+	uint32_t hits;
+	uint32_t misses;
+} st7789_TextStats;
+
+typedef struct st7789_Text {
+	const st7789_Font *font;
+	uint16_t *band;        // 32 bit aligned, split into two halves for DMA ping-pong
+	uint16_t bandPixels;
+	uint16_t foreground;
+	uint16_t background;
+	uint16_t stamp;        // Cache use counter
+	uint16_t lineStamp;    // Counter at start of current line
+	uint32_t lut[16][2];   // Nibble to 4 pixels, least significant bit first
+	int16_t cacheChar[ST7789_TEXT_CACHE_SLOTS];
+	uint16_t cacheStamp[ST7789_TEXT_CACHE_SLOTS];
+	uint32_t cache[ST7789_TEXT_CACHE_SLOTS][ST7789_TEXT_GLYPH_PIXELS / 2];
+	st7789_TextStats stats;
+} st7789_Text;
+
+// Band should hold at least two rows of widest line, line is sent in strips
+// of as many rows as fit into half of band. RGB444 lines of odd width are
+// not drawn unless two rows fit into half of band.
+void st7789_TextInit(st7789_Text *text, const st7789_Font *font, uint16_t *band, uint16_t bandPixels);
+void st7789_TextSetFont(st7789_Text *text, const st7789_Font *font);
+void st7789_TextSetColors(st7789_Text *text, uint16_t foreground, uint16_t background);
+uint16_t st7789_TextDrawLine(st7789_Device *device, st7789_Text *text, uint16_t x, uint16_t y, const char *string, uint16_t length);
+uint16_t st7789_TextDraw(st7789_Device *device, st7789_Text *text, uint16_t x, uint16_t y, const char *string);
+
+#endif
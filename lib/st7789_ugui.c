@@ -0,0 +1,199 @@
+#include <stddef.h>
+
+#include "st7789.h"
+#include "st7789_ugui.h"
+
+
+typedef enum st7789_UguiMode {
+	ST7789_UGUI_IDLE,
+	ST7789_UGUI_PUSH, // Pixels of window opened by st7789_UguiFillArea
+	ST7789_UGUI_RUN,  // Adjacent st7789_UguiSetPixel calls on one row
+} st7789_UguiMode;
+
+
+static st7789_Device *st7789_uguiDevice;
+static uint16_t st7789_uguiBuffers[2][ST7789_UGUI_CHUNK_PIXELS];
+static uint8_t st7789_uguiBufferIndex;
+static uint16_t st7789_uguiCount;
+static uint8_t st7789_uguiMode;
+static uint32_t st7789_uguiRemaining;
+static int16_t st7789_uguiRunX;
+static int16_t st7789_uguiRunY;
+// Next pushed pixel and columns of area requested by uGUI
+static int16_t st7789_uguiPushX;
+static int16_t st7789_uguiPushY;
+static int16_t st7789_uguiAreaLeft;
+static int16_t st7789_uguiAreaRight;
+
+
+// Driver callbacks have no context, they draw to selected device
+void st7789_UguiSelect(st7789_Device *device) {
+	if (st7789_uguiDevice != NULL) {
+		st7789_UguiFlush();
+	}
+	st7789_uguiDevice = device;
+}
+
+
+// Starts transfer of collected pixels, other buffer is filled meanwhile
+static void st7789_UguiSend(void) {
+	if (st7789_uguiCount == 0) {
+		return;
+	}
+	st7789_WritePixels(st7789_uguiDevice, st7789_uguiBuffers[st7789_uguiBufferIndex], st7789_uguiCount);
+	st7789_uguiBufferIndex ^= 1;
+	st7789_uguiCount = 0;
+}
+
+
+static bool st7789_UguiVisible(int16_t x, int16_t y) {
+	return x >= 0 && y >= 0 && x < st7789_uguiDevice->width && y < st7789_uguiDevice->height;
+}
+
+
+// Span of line, endpoints in any order
+static void st7789_UguiSpan(uint16_t color, int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+	int16_t x = (x1 < x2) ? x1 : x2;
+	int16_t y = (y1 < y2) ? y1 : y2;
+	st7789_FillArea(st7789_uguiDevice, color, (uint16_t)x, (uint16_t)y, (uint16_t)((x1 < x2 ? x2 - x1 : x1 - x2) + 1), (uint16_t)((y1 < y2 ? y2 - y1 : y1 - y2) + 1));
+}
+
+
+void st7789_UguiSetPixel(int16_t x, int16_t y, uint16_t color) {
+	if (!st7789_UguiVisible(x, y)) {
+		return;
+	}
+	bool extends = st7789_uguiMode == ST7789_UGUI_RUN && y == st7789_uguiRunY && x == st7789_uguiRunX + st7789_uguiCount;
+	if (!extends) {
+		st7789_UguiFlush();
+		st7789_uguiMode = ST7789_UGUI_RUN;
+		st7789_uguiRunX = x;
+		st7789_uguiRunY = y;
+	}
+	st7789_uguiBuffers[st7789_uguiBufferIndex][st7789_uguiCount++] = color;
+}
+
+
+// Window is finished without explicit flush once all its pixels are pushed,
+// pixels outside of screen are dropped
+void st7789_UguiPushPixel(uint16_t color) {
+	if (st7789_uguiMode != ST7789_UGUI_PUSH) {
+		return;
+	}
+	if (st7789_UguiVisible(st7789_uguiPushX, st7789_uguiPushY)) {
+		st7789_uguiBuffers[st7789_uguiBufferIndex][st7789_uguiCount++] = color;
+	}
+	if (st7789_uguiPushX == st7789_uguiAreaRight) {
+		st7789_uguiPushX = st7789_uguiAreaLeft;
+		st7789_uguiPushY++;
+	}
+	else {
+		st7789_uguiPushX++;
+	}
+	st7789_uguiRemaining--;
+	if (st7789_uguiCount == ST7789_UGUI_CHUNK_PIXELS || st7789_uguiRemaining == 0) {
+		st7789_UguiSend();
+	}
+	if (st7789_uguiRemaining == 0) {
+		st7789_uguiMode = ST7789_UGUI_IDLE;
+	}
+}
+
+
+// Window covers visible part of area, area left incomplete is abandoned by
+// next drawing call or st7789_UguiFlush
+st7789_UguiPush st7789_UguiFillArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+	st7789_UguiFlush();
+	int16_t left = (x1 < 0) ? 0 : x1;
+	int16_t top = (y1 < 0) ? 0 : y1;
+	int16_t right = (x2 >= st7789_uguiDevice->width) ? st7789_uguiDevice->width - 1 : x2;
+	int16_t bottom = (y2 >= st7789_uguiDevice->height) ? st7789_uguiDevice->height - 1 : y2;
+	if (left <= right && top <= bottom) {
+		st7789_SetWindow(st7789_uguiDevice, (uint16_t)left, (uint16_t)top, (uint16_t)right, (uint16_t)bottom);
+	}
+	st7789_uguiMode = ST7789_UGUI_PUSH;
+	st7789_uguiRemaining = (uint32_t)(x2 - x1 + 1) * (uint32_t)(y2 - y1 + 1);
+	st7789_uguiPushX = x1;
+	st7789_uguiPushY = y1;
+	st7789_uguiAreaLeft = x1;
+	st7789_uguiAreaRight = x2;
+	return st7789_UguiPushPixel;
+}
+
+
+// Inclusive corners in any order, clipped to screen
+int8_t st7789_UguiFillFrame(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+	int16_t left = (x1 < x2) ? x1 : x2;
+	int16_t top = (y1 < y2) ? y1 : y2;
+	int16_t right = (x1 < x2) ? x2 : x1;
+	int16_t bottom = (y1 < y2) ? y2 : y1;
+	left = (left < 0) ? 0 : left;
+	top = (top < 0) ? 0 : top;
+	right = (right >= st7789_uguiDevice->width) ? st7789_uguiDevice->width - 1 : right;
+	bottom = (bottom >= st7789_uguiDevice->height) ? st7789_uguiDevice->height - 1 : bottom;
+	st7789_UguiFlush();
+	if (left <= right && top <= bottom) {
+		st7789_FillArea(st7789_uguiDevice, color, (uint16_t)left, (uint16_t)top, (uint16_t)(right - left + 1), (uint16_t)(bottom - top + 1));
+	}
+	return ST7789_UGUI_OK;
+}
+
+
+// Bresenham line sent as runs along major axis, one window per run. Lines
+// leaving the screen fail and uGUI draws them by clipped st7789_UguiSetPixel.
+int8_t st7789_UguiDrawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+	if (!st7789_UguiVisible(x1, y1) || !st7789_UguiVisible(x2, y2)) {
+		return ST7789_UGUI_FAIL;
+	}
+	st7789_UguiFlush();
+	int16_t dx = (x2 > x1) ? x2 - x1 : x1 - x2;
+	int16_t dy = (y2 > y1) ? y2 - y1 : y1 - y2;
+	int16_t sx = (x2 > x1) ? 1 : -1;
+	int16_t sy = (y2 > y1) ? 1 : -1;
+	bool horizontal = dx >= dy;
+	int32_t error = dx - dy;
+	int16_t x = x1;
+	int16_t y = y1;
+	int16_t runX = x1;
+	int16_t runY = y1;
+	while (x != x2 || y != y2) {
+		int16_t lastX = x;
+		int16_t lastY = y;
+		int32_t error2 = 2 * error;
+		bool stepX = false;
+		bool stepY = false;
+		if (error2 > -dy) {
+			error -= dy;
+			x += sx;
+			stepX = true;
+		}
+		if (error2 < dx) {
+			error += dx;
+			y += sy;
+			stepY = true;
+		}
+		if (horizontal ? stepY : stepX) {
+			st7789_UguiSpan(color, runX, runY, lastX, lastY);
+			runX = x;
+			runY = y;
+		}
+	}
+	st7789_UguiSpan(color, runX, runY, x2, y2);
+	return ST7789_UGUI_OK;
+}
+
+
+// Sends buffered pixels and waits until bus is free
+void st7789_UguiFlush(void) {
+	if (st7789_uguiMode == ST7789_UGUI_RUN && st7789_uguiCount > 0) {
+		st7789_WaitForDMA(st7789_uguiDevice);
+		st7789_SetWindow(st7789_uguiDevice, (uint16_t)st7789_uguiRunX, (uint16_t)st7789_uguiRunY, (uint16_t)(st7789_uguiRunX + st7789_uguiCount - 1), (uint16_t)st7789_uguiRunY);
+	}
+	st7789_UguiSend();
+	st7789_WaitForDMA(st7789_uguiDevice);
+	if (st7789_uguiMode == ST7789_UGUI_PUSH) {
+		// Cached window is only partly written, same area has to start over
+		st7789_InvalidateWindow(st7789_uguiDevice);
+	}
+	st7789_uguiMode = ST7789_UGUI_IDLE;
+}
@@ -0,0 +1,34 @@
+#ifndef ST7789_UGUI_H
+#define ST7789_UGUI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Pixels collected before DMA transfer (double buffered), at least one row
+#define ST7789_UGUI_CHUNK_PIXELS     ST7789_MAX_SIZE
+
+// UG_RESULT values, ugui.h is not included to keep lib buildable without it
+#define ST7789_UGUI_OK               0
+#define ST7789_UGUI_FAIL             -1
+
+
+typedef void (*st7789_UguiPush)(uint16_t color);
+
+// Driver functions with uGUI signatures (UG_S16 coordinates, RGB565
+// UG_COLOR): st7789_UguiSetPixel for UG_Init, others for DRIVER_FILL_FRAME,
+// DRIVER_FILL_AREA and DRIVER_DRAW_LINE. Pixels may stay buffered,
+// st7789_UguiFlush has to be called before other st7789_* calls. Device
+// is selected by st7789_UguiSelect before first drawing (and together
+// with UG_SelectGUI when driving more panels).
+void st7789_UguiSelect(st7789_Device *device);
+void st7789_UguiSetPixel(int16_t x, int16_t y, uint16_t color);
+void st7789_UguiPushPixel(uint16_t color);
+st7789_UguiPush st7789_UguiFillArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2);
+int8_t st7789_UguiFillFrame(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+int8_t st7789_UguiDrawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+void st7789_UguiFlush(void);
+
+#endif
@@ -0,0 +1,155 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stm32f10x.h>
+
+#include "st7789.h"
+#include "st7789_vsync.h"
+
+
+void st7789_VsyncInit(st7789_Device *device, st7789_Vsync *vsync, uint32_t extiLine, IRQn_Type extiIRQn) {
+	device->vsync = vsync;
+	vsync->extiLine = extiLine;
+	vsync->extiIRQn = extiIRQn;
+	vsync->edgeTicks = 0;
+	vsync->frameTicks = ST7789_VSYNC_FRAME_TICKS;
+	vsync->frameStart = 0;
+	vsync->frameEdge = 0;
+	vsync->teLine = ST7789_VSYNC_TE_LINE;
+	vsync->latencyPending = false;
+	vsync->hook = NULL;
+	vsync->hookContext = NULL;
+	vsync->stats.edges = 0;
+	st7789_VsyncResetStats(device);
+
+	EXTI->PR = vsync->extiLine;
+	EXTI->RTSR |= vsync->extiLine;
+	EXTI->IMR |= vsync->extiLine;
+	NVIC_EnableIRQ(vsync->extiIRQn);
+}
+
+
+// Called from interrupt at every TE edge
+void st7789_VsyncSetHook(st7789_Device *device, st7789_VsyncCallback hook, void *context) {
+	st7789_Vsync *vsync = device->vsync;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	vsync->hook = hook;
+	vsync->hookContext = context;
+	__set_PRIMASK(primask);
+}
+
+
+// TE pulse is generated when refresh reaches line
+void st7789_VsyncSetScanline(st7789_Device *device, uint16_t line) {
+	st7789_Vsync *vsync = device->vsync;
+	uint8_t params[2] = {(uint8_t)(line >> 8), (uint8_t)(line & 0xff)};
+	st7789_WaitForDMA(device);
+	st7789_WriteCommand(device, ST7789_CMD_TESCAN, params, sizeof(params));
+	vsync->teLine = line;
+}
+
+
+// Line currently refreshed as reported by panel
+uint16_t st7789_VsyncReadScanline(st7789_Device *device) {
+	uint8_t line[2];
+	st7789_WaitForDMA(device);
+	st7789_ReadCommand(device, ST7789_CMD_RDTESCAN, line, sizeof(line));
+	return (uint16_t)((line[0] << 8) | line[1]);
+}
+
+
+// Line currently refreshed estimated from last TE edge, no SPI traffic
+uint16_t st7789_VsyncScanline(const st7789_Device *device) {
+	const st7789_Vsync *vsync = device->vsync;
+	uint32_t lineTicks = vsync->frameTicks / ST7789_VSYNC_LINES;
+	uint32_t lines = (st7789_Ticks() - vsync->edgeTicks) / lineTicks;
+	return (uint16_t)((vsync->teLine + lines) % ST7789_VSYNC_LINES);
+}
+
+
+// Sleeps until next TE edge, refresh cycles which passed since previous
+// frame without new frame are counted as missed
+void st7789_VsyncBeginFrame(st7789_Device *device) {
+	st7789_Vsync *vsync = device->vsync;
+	uint32_t edges = vsync->stats.edges;
+	if (vsync->stats.frames > 0) {
+		vsync->stats.missedFrames += edges - vsync->frameEdge;
+	}
+	__disable_irq();
+	while (vsync->stats.edges == edges) {
+		__WFI();
+		__enable_irq();
+		__disable_irq();
+	}
+	vsync->frameStart = vsync->edgeTicks;
+	vsync->frameEdge = vsync->stats.edges;
+	__enable_irq();
+	vsync->stats.frames++;
+	vsync->latencyPending = true;
+}
+
+
+// Waits until refresh of current frame has passed row, writing the row
+// afterwards cannot collide with the scan. First call of frame records
+// TE to first write latency.
+void st7789_VsyncWaitLine(st7789_Device *device, uint16_t row) {
+	st7789_Vsync *vsync = device->vsync;
+	uint32_t lineTicks = vsync->frameTicks / ST7789_VSYNC_LINES;
+	uint32_t position = (row >= vsync->teLine) ? row : row + ST7789_VSYNC_LINES;
+	uint32_t deadline = vsync->frameStart + (position - vsync->teLine + 1) * lineTicks;
+	uint32_t now;
+	while ((int32_t)((now = st7789_Ticks()) - deadline) < 0);
+	if (vsync->latencyPending) {
+		uint32_t latency = now - vsync->frameStart;
+		vsync->latencyPending = false;
+		vsync->stats.latencyLast = latency;
+		if (latency < vsync->stats.latencyMin) {
+			vsync->stats.latencyMin = latency;
+		}
+		if (latency > vsync->stats.latencyMax) {
+			vsync->stats.latencyMax = latency;
+		}
+	}
+}
+
+
+const st7789_VsyncStats *st7789_VsyncGetStats(const st7789_Device *device) {
+	const st7789_Vsync *vsync = device->vsync;
+	return &vsync->stats;
+}
+
+
+void st7789_VsyncResetStats(st7789_Device *device) {
+	st7789_Vsync *vsync = device->vsync;
+	vsync->stats.frames = 0;
+	vsync->stats.missedFrames = 0;
+	vsync->stats.latencyLast = 0;
+	vsync->stats.latencyMin = UINT32_MAX;
+	vsync->stats.latencyMax = 0;
+}
+
+
+void st7789_VsyncSignal(st7789_Device *device) {
+	st7789_Vsync *vsync = device->vsync;
+	uint32_t ticks = st7789_Ticks();
+	uint32_t period = ticks - vsync->edgeTicks;
+	// Refresh rate follows panel oscillator, skip periods with lost edges
+	if (vsync->stats.edges > 0 && period > vsync->frameTicks - vsync->frameTicks / 4 && period < vsync->frameTicks + vsync->frameTicks / 4) {
+		vsync->frameTicks = period;
+	}
+	vsync->edgeTicks = ticks;
+	vsync->stats.edges++;
+	if (vsync->hook != NULL) {
+		vsync->hook(vsync->hookContext);
+	}
+}
+
+
+void st7789_TEInterruptHandler(st7789_Device *device) {
+	st7789_Vsync *vsync = device->vsync;
+	if (!(EXTI->PR & vsync->extiLine)) {
+		return;
+	}
+	EXTI->PR = vsync->extiLine;
+	st7789_VsyncSignal(device);
+}
@@ -0,0 +1,58 @@
+#ifndef ST7789_VSYNC_H
+#define ST7789_VSYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "st7789.h"
+
+
+// Refresh timing for PORCTRL 0x0c/0x0c and FRCTR2 0x0f: 320 lines of frame
+// memory plus porch at 60 Hz
+#define ST7789_VSYNC_LINES           344
+#define ST7789_VSYNC_TE_LINE         320 // TE at start of vertical blanking
+#define ST7789_VSYNC_FRAME_TICKS     (ST7789_PRESCALER * ST7789_OSC_MHZ * 1000000 / 60)
+
+
+typedef void (*st7789_VsyncCallback)(void *context);
+
+typedef struct st7789_VsyncStats {
+	uint32_t edges;        // TE edges received since init
+	uint32_t frames;       // Frames started by st7789_VsyncBeginFrame
+	uint32_t missedFrames; // Refresh cycles which did not start a new frame
+	uint32_t latencyLast;  // TE edge to first write of frame in CPU cycles
+	uint32_t latencyMin;
+	uint32_t latencyMax;
+} st7789_VsyncStats;
+
+// TE state of one device
+typedef struct st7789_Vsync {
+	uint32_t extiLine;            // EXTI line mask of TE pin, port is selected by application
+	IRQn_Type extiIRQn;
+	volatile uint32_t edgeTicks;  // Time of last TE edge
+	uint32_t frameTicks;          // Measured TE period
+	uint32_t frameStart;          // TE edge which started current frame
+	uint32_t frameEdge;           // Edge count at start of current frame
+	uint16_t teLine;
+	bool latencyPending;
+	st7789_VsyncCallback hook;
+	void *hookContext;
+	st7789_VsyncStats stats;
+} st7789_Vsync;
+
+// st7789_TEInterruptHandler has to be called with the device from extiIRQn
+// vector, other TE sources (timer capture, host simulation) call
+// st7789_VsyncSignal
+void st7789_VsyncInit(st7789_Device *device, st7789_Vsync *vsync, uint32_t extiLine, IRQn_Type extiIRQn);
+void st7789_VsyncSetHook(st7789_Device *device, st7789_VsyncCallback hook, void *context);
+void st7789_VsyncSetScanline(st7789_Device *device, uint16_t line);
+uint16_t st7789_VsyncReadScanline(st7789_Device *device);
+uint16_t st7789_VsyncScanline(const st7789_Device *device);
+void st7789_VsyncBeginFrame(st7789_Device *device);
+void st7789_VsyncWaitLine(st7789_Device *device, uint16_t row);
+const st7789_VsyncStats *st7789_VsyncGetStats(const st7789_Device *device);
+void st7789_VsyncResetStats(st7789_Device *device);
+void st7789_VsyncSignal(st7789_Device *device);
+void st7789_TEInterruptHandler(st7789_Device *device);
+
+#endif